@@ -0,0 +1,419 @@
+// Client and load driver for the bank server (see server.h).
+//
+// One request:
+//   bank_client <socket> <command...>
+// where the command uses the words of the batch language (commands.h):
+// create, deposit, withdraw, transfer, enqueue, process, interest,
+// balance, close, save (close / save take no file names here: the server
+// uses its own), and "id <key> <deposit|withdraw|transfer|enqueue ...>"
+// to send the request with an idempotency key. Prints the result line,
+// e.g. "ok 116.15".
+//
+// Load:
+//   bank_client <socket> load [connections] [requestsPerConn] [pipeline]
+//                             [accounts] [threads]
+// Creates accounts 1..accounts (existing ones are kept), then opens
+// `connections` clients spread over `threads` threads. Each thread
+// sends `pipeline` requests on every one of its connections before
+// reading any response, until each connection has sent requestsPerConn
+// requests (mix: 40% deposit, 30% withdraw, 20% balance, 10% transfer).
+// Output: one CSV line
+// (connections,requests,seconds,requestsPerSec,p50us,p99us,p999us,failed),
+// latency measured from sending a request to reading its response.
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "commands.h"
+#include "wire_protocol.h"
+
+namespace {
+
+using namespace bank;
+using Clock = std::chrono::steady_clock;
+
+/// Opens a blocking connection to the server.
+/// @return the fd, or -1 (after printing why).
+int connectTo(const std::string& path) {
+    sockaddr_un addr{};
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Error: invalid socket path '" << path << "'.\n";
+        return -1;
+    }
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        std::cerr << "Error: could not connect to '" << path << "': "
+                  << std::strerror(errno) << '\n';
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+bool sendAll(int fd, const std::vector<char>& data) {
+    std::size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        sent += static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+/// Incoming bytes of one connection, kept across reads.
+struct ResponseReader {
+    int               fd{-1};
+    std::vector<char> buffer;
+
+    /// Reads until one whole response is decoded into `out`.
+    /// @return false if the connection closed or sent garbage.
+    bool next(WireResponse& out) {
+        while (true) {
+            std::size_t consumed = 0;
+            WireDecode result = decodeResponse(buffer.data(), buffer.size(), out, consumed);
+            if (result == WireDecode::Complete) {
+                buffer.erase(buffer.begin(), buffer.begin() + static_cast<std::ptrdiff_t>(consumed));
+                return true;
+            }
+            if (result == WireDecode::Malformed) {
+                return false;
+            }
+            char chunk[64 * 1024];
+            ssize_t n = ::read(fd, chunk, sizeof(chunk));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            buffer.insert(buffer.end(), chunk, chunk + n);
+        }
+    }
+};
+
+/// Text of a response status.
+std::string statusText(const WireResponse& response) {
+    if (response.status == kWireBadRequest) {
+        return "bad_request";
+    }
+    if (response.status == kWireFailed) {
+        return response.op == WireOp::Save ? "save_failed" : "failed";
+    }
+    return operationStatusName(static_cast<OperationStatus>(response.status));
+}
+
+/// Builds a request from command words (see the usage above).
+/// @return false if the words are not a valid command.
+bool parseCommand(const std::vector<std::string>& words, WireRequest& out) {
+    if (words.empty()) {
+        return false;
+    }
+    if (words[0] == "id" && words.size() >= 3) {
+        const std::vector<std::string> rest(words.begin() + 2, words.end());
+        out.key = words[1];
+        const std::string& keyed = rest[0];
+        return (keyed == "deposit" || keyed == "withdraw" || keyed == "transfer" ||
+                keyed == "enqueue") &&
+               parseCommand(rest, out);
+    }
+    const std::string& verb = words[0];
+    const std::size_t  args = words.size() - 1;
+    auto number = [&](std::size_t i) { return std::atoi(words[i].c_str()); };
+    auto amount = [&](std::size_t i) { return std::atof(words[i].c_str()); };
+
+    if (verb == "create" && args >= 3) {
+        out.op      = WireOp::Create;
+        out.account = number(1);
+        out.amount  = amount(2);
+        for (std::size_t i = 3; i < words.size(); ++i) {
+            out.name += (i > 3 ? " " : "") + words[i];
+        }
+    } else if ((verb == "deposit" || verb == "withdraw") && args == 2) {
+        out.op      = verb == "deposit" ? WireOp::Deposit : WireOp::Withdraw;
+        out.account = number(1);
+        out.amount  = amount(2);
+    } else if (verb == "transfer" && args == 3) {
+        out.op        = WireOp::Transfer;
+        out.account   = number(1);
+        out.toAccount = number(2);
+        out.amount    = amount(3);
+    } else if (verb == "enqueue" && args == 3 &&
+               (words[2] == "deposit" || words[2] == "withdraw")) {
+        out.op      = WireOp::Enqueue;
+        out.account = number(1);
+        out.type    = words[2] == "deposit" ? TransactionType::Deposit
+                                            : TransactionType::Withdraw;
+        out.amount  = amount(3);
+    } else if (verb == "process" && args == 0) {
+        out.op = WireOp::ProcessQueue;
+    } else if (verb == "interest" && args == 1) {
+        out.op     = WireOp::Interest;
+        out.amount = amount(1);
+    } else if ((verb == "balance" || verb == "close") && args == 1) {
+        out.op      = verb == "balance" ? WireOp::Balance : WireOp::Close;
+        out.account = number(1);
+    } else if (verb == "save" && args == 0) {
+        out.op = WireOp::Save;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+int runCommand(const std::string& path, const std::vector<std::string>& words) {
+    WireRequest request;
+    if (!parseCommand(words, request)) {
+        std::cout << "error bad_command\n";
+        return 2;
+    }
+    int fd = connectTo(path);
+    if (fd < 0) {
+        return 1;
+    }
+
+    std::vector<char> frame;
+    request.id = 1;
+    encodeRequest(request, frame);
+    ResponseReader reader{fd, {}};
+    WireResponse response;
+    if (!sendAll(fd, frame) || !reader.next(response)) {
+        std::cerr << "Error: connection lost.\n";
+        ::close(fd);
+        return 1;
+    }
+    ::close(fd);
+
+    if (response.status != static_cast<std::uint8_t>(OperationStatus::Ok)) {
+        std::cout << "error " << statusText(response) << '\n';
+        return 0;
+    }
+    std::cout << "ok";
+    if (response.op == WireOp::Balance) {
+        std::cout << ' ' << std::setprecision(15) << response.balance;
+    } else if (response.op == WireOp::ProcessQueue) {
+        std::cout << " applied=" << response.applied << " skipped=" << response.skipped;
+    }
+    std::cout << '\n';
+    return 0;
+}
+
+/// Creates accounts 1..count over one connection, 1024 requests at a time.
+bool createAccounts(const std::string& path, int count) {
+    int fd = connectTo(path);
+    if (fd < 0) {
+        return false;
+    }
+    ResponseReader reader{fd, {}};
+    bool ok = true;
+    for (int first = 1; ok && first <= count; first += 1024) {
+        int last = std::min(count, first + 1023);
+        std::vector<char> frames;
+        for (int account = first; account <= last; ++account) {
+            WireRequest request;
+            request.id      = static_cast<std::uint32_t>(account);
+            request.op      = WireOp::Create;
+            request.account = account;
+            request.amount  = 1000.0;
+            request.name    = "Load Client";
+            encodeRequest(request, frames);
+        }
+        ok = sendAll(fd, frames);
+        WireResponse response;
+        for (int account = first; ok && account <= last; ++account) {
+            ok = reader.next(response);
+        }
+    }
+    ::close(fd);
+    return ok;
+}
+
+/// Results of one load thread.
+struct LoadResult {
+    std::vector<double> latenciesUs;
+    long long           failed{0};
+    bool                ok{true};
+};
+
+/// Drives `fds` in waves of `pipeline` requests per connection.
+void loadThread(const std::vector<int>& fds, int requestsPerConn, int pipeline,
+                int accounts, unsigned seed, LoadResult& result) {
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> pickAccount(1, accounts);
+    std::uniform_int_distribution<int> pickOp(0, 99);
+
+    std::vector<ResponseReader> readers;
+    for (int fd : fds) {
+        readers.push_back(ResponseReader{fd, {}});
+    }
+    result.latenciesUs.reserve(fds.size() * static_cast<std::size_t>(requestsPerConn));
+    std::vector<std::vector<Clock::time_point>> sentAt(fds.size());
+
+    std::vector<char> frames;
+    for (int done = 0; done < requestsPerConn && result.ok; done += pipeline) {
+        const int wave = std::min(pipeline, requestsPerConn - done);
+
+        for (std::size_t c = 0; c < fds.size() && result.ok; ++c) {
+            frames.clear();
+            for (int k = 0; k < wave; ++k) {
+                WireRequest request;
+                request.id      = static_cast<std::uint32_t>(k);
+                request.account = pickAccount(rng);
+                request.amount  = 1.0 + pickOp(rng);
+                int roll = pickOp(rng);
+                if (roll < 40) {
+                    request.op = WireOp::Deposit;
+                } else if (roll < 70) {
+                    request.op = WireOp::Withdraw;
+                } else if (roll < 90) {
+                    request.op = WireOp::Balance;
+                } else {
+                    request.op        = WireOp::Transfer;
+                    request.toAccount = pickAccount(rng);
+                }
+                encodeRequest(request, frames);
+            }
+            sentAt[c].assign(static_cast<std::size_t>(wave), Clock::now());
+            result.ok = sendAll(fds[c], frames);
+        }
+
+        for (std::size_t c = 0; c < fds.size() && result.ok; ++c) {
+            WireResponse response;
+            for (int k = 0; k < wave && result.ok; ++k) {
+                result.ok = readers[c].next(response) && response.id < sentAt[c].size();
+                if (!result.ok) {
+                    break;
+                }
+                std::chrono::duration<double, std::micro> latency =
+                    Clock::now() - sentAt[c][response.id];
+                result.latenciesUs.push_back(latency.count());
+                if (response.status != static_cast<std::uint8_t>(OperationStatus::Ok)) {
+                    ++result.failed;
+                }
+            }
+        }
+    }
+}
+
+double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    std::size_t index = static_cast<std::size_t>(p * static_cast<double>(sorted.size() - 1));
+    return sorted[index];
+}
+
+int runLoad(const std::string& path, int argc, char** argv) {
+    int connections     = argc > 3 ? std::atoi(argv[3]) : 1000;
+    int requestsPerConn = argc > 4 ? std::atoi(argv[4]) : 1000;
+    int pipeline        = argc > 5 ? std::atoi(argv[5]) : 16;
+    int accounts        = argc > 6 ? std::atoi(argv[6]) : 10000;
+    int threads         = argc > 7 ? std::atoi(argv[7]) : 4;
+    if (connections < 1 || requestsPerConn < 1 || pipeline < 1 || accounts < 1 || threads < 1) {
+        std::cerr << "Error: load arguments must be positive.\n";
+        return 2;
+    }
+    threads = std::min(threads, connections);
+
+    // Thousands of connections need thousands of fds.
+    rlimit limit{};
+    if (::getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        ::setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    if (!createAccounts(path, accounts)) {
+        std::cerr << "Error: could not create the accounts.\n";
+        return 1;
+    }
+
+    std::vector<std::vector<int>> fds(static_cast<std::size_t>(threads));
+    for (int c = 0; c < connections; ++c) {
+        int fd = connectTo(path);
+        if (fd < 0) {
+            for (const std::vector<int>& group : fds) {
+                for (int open : group) {
+                    ::close(open);
+                }
+            }
+            return 1;
+        }
+        fds[static_cast<std::size_t>(c % threads)].push_back(fd);
+    }
+
+    std::vector<LoadResult> results(static_cast<std::size_t>(threads));
+    std::vector<std::thread> workers;
+    Clock::time_point start = Clock::now();
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back(loadThread, std::cref(fds[static_cast<std::size_t>(t)]),
+                             requestsPerConn, pipeline, accounts,
+                             static_cast<unsigned>(t + 1), std::ref(results[static_cast<std::size_t>(t)]));
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    std::chrono::duration<double> seconds = Clock::now() - start;
+
+    std::vector<double> latencies;
+    long long failed = 0;
+    bool ok = true;
+    for (std::size_t t = 0; t < results.size(); ++t) {
+        latencies.insert(latencies.end(), results[t].latenciesUs.begin(),
+                         results[t].latenciesUs.end());
+        failed += results[t].failed;
+        ok = ok && results[t].ok;
+        for (int fd : fds[t]) {
+            ::close(fd);
+        }
+    }
+    if (!ok) {
+        std::cerr << "Warning: some connections were lost.\n";
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    std::cout << "connections,requests,seconds,requestsPerSec,p50us,p99us,p999us,failed\n";
+    std::cout << connections << ',' << latencies.size() << ',' << seconds.count() << ','
+              << static_cast<double>(latencies.size()) / seconds.count() << ','
+              << percentile(latencies, 0.50) << ',' << percentile(latencies, 0.99) << ','
+              << percentile(latencies, 0.999) << ',' << failed << '\n';
+    return ok ? 0 : 1;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "Usage: bank_client <socket> <command...>\n"
+                  << "       bank_client <socket> load [connections] [requestsPerConn]"
+                     " [pipeline] [accounts] [threads]\n";
+        return 2;
+    }
+    const std::string path = argv[1];
+    if (std::strcmp(argv[2], "load") == 0) {
+        return runLoad(path, argc, argv);
+    }
+    return runCommand(path, std::vector<std::string>(argv + 2, argv + argc));
+}
@@ -0,0 +1,195 @@
+// Multi-threaded throughput benchmark for the service layer.
+//
+// For 1, 2, 4, ... threads it measures deposits / withdrawals / transfers
+// per second in two modes:
+//  - disjoint : every thread works on its own slice of accounts
+//               (no lock contention, shows per-account parallelism)
+//  - shared   : every thread picks accounts from the whole bank
+// While the workers run, one extra thread keeps creating new accounts,
+// which must not slow the readers down, and another keeps producing
+// full-bank snapshot reports, which must not slow the writers down.
+// A third mode, sharded, runs the same mix on a ShardedBank with one
+// shard per thread; clients send the operations in batches of 64.
+//
+// Usage: bank_concurrency_bench [accounts] [opsPerThread] [maxThreads]
+// Output: one CSV line per run (mode,threads,ops,seconds,opsPerSec,reports).
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "bank_service.h"
+#include "sharded_bank.h"
+
+namespace {
+
+using namespace bank;
+
+/// Creates accounts 1..count in random order (sequential keys would turn
+/// the unbalanced BST into a list).
+void populate(Bank& bank, int count) {
+    std::vector<int> numbers(static_cast<std::size_t>(count));
+    std::iota(numbers.begin(), numbers.end(), 1);
+    std::shuffle(numbers.begin(), numbers.end(), std::mt19937(42));
+    for (int number : numbers) {
+        createAccount(bank, number, "Bench Holder", 1000.0);
+    }
+}
+
+/// Runs `opsPerThread` random operations on each of `threads` workers.
+/// `reports` receives the number of snapshot reports finished meanwhile.
+/// @return elapsed seconds.
+double runWorkers(Bank& bank, int accounts, int opsPerThread,
+                  int threads, bool disjoint, long long& reports) {
+    std::atomic<bool> stop{false};
+
+    // Background creator: new account numbers above the populated range.
+    std::thread creator([&] {
+        int next = accounts + 1;
+        while (!stop.load(std::memory_order_relaxed)) {
+            createAccount(bank, next++, "New Holder", 0.0);
+        }
+    });
+
+    // Background reporter: balances of every account from one snapshot.
+    reports = 0;
+    std::thread reporter([&] {
+        while (!stop.load(std::memory_order_relaxed)) {
+            balancesAsOf(bank, "9999");
+            ++reports;
+        }
+    });
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            std::mt19937 rng(static_cast<unsigned>(1234 + t));
+            int slice = accounts / threads;
+            int lo = disjoint ? t * slice + 1 : 1;
+            int hi = disjoint ? lo + slice - 1 : accounts;
+            std::uniform_int_distribution<int> pickAccount(lo, hi);
+            std::uniform_int_distribution<int> pickKind(0, 9);
+
+            for (int i = 0; i < opsPerThread; ++i) {
+                int kind = pickKind(rng);
+                int account = pickAccount(rng);
+                if (kind < 6) {
+                    BatchOperation op{account, TransactionType::Deposit, 10.0};
+                    applyBatch(bank, &op, 1);
+                } else if (kind < 9) {
+                    BatchOperation op{account, TransactionType::Withdraw, 5.0};
+                    applyBatch(bank, &op, 1);
+                } else {
+                    transferFunds(bank, account, pickAccount(rng), 1.0);
+                }
+            }
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    stop.store(true);
+    creator.join();
+    reporter.join();
+
+    return std::chrono::duration<double>(end - start).count();
+}
+
+/// Sharded mode: `threads` shards and `threads` client threads.
+/// @return elapsed seconds.
+double runSharded(int accounts, int opsPerThread, int threads) {
+    ShardedBank sharded;
+    initShardedBank(sharded, threads);
+
+    std::vector<int> numbers(static_cast<std::size_t>(accounts));
+    std::iota(numbers.begin(), numbers.end(), 1);
+    std::shuffle(numbers.begin(), numbers.end(), std::mt19937(42));
+    for (int number : numbers) {
+        shardedCreateAccount(sharded, number, "Bench Holder", 1000.0);
+    }
+
+    constexpr int kBatchSize = 64;
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> clients;
+    for (int t = 0; t < threads; ++t) {
+        clients.emplace_back([&, t] {
+            std::mt19937 rng(static_cast<unsigned>(1234 + t));
+            std::uniform_int_distribution<int> pickAccount(1, accounts);
+            std::uniform_int_distribution<int> pickKind(0, 9);
+            std::vector<BatchOperation> batch;
+
+            for (int i = 0; i < opsPerThread; ++i) {
+                int kind = pickKind(rng);
+                int account = pickAccount(rng);
+                if (kind < 6) {
+                    batch.push_back({account, TransactionType::Deposit, 10.0});
+                } else if (kind < 9) {
+                    batch.push_back({account, TransactionType::Withdraw, 5.0});
+                } else {
+                    shardedTransfer(sharded, account, pickAccount(rng), 1.0);
+                }
+                if (batch.size() == kBatchSize || i + 1 == opsPerThread) {
+                    shardedApplyBatch(sharded, batch.data(), batch.size());
+                    batch.clear();
+                }
+            }
+        });
+    }
+    for (std::thread& client : clients) {
+        client.join();
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    destroyShardedBank(sharded);
+    return std::chrono::duration<double>(end - start).count();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int accounts     = argc > 1 ? std::atoi(argv[1]) : 100000;
+    int opsPerThread = argc > 2 ? std::atoi(argv[2]) : 200000;
+    int maxThreads   = argc > 3 ? std::atoi(argv[3])
+                                : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+
+    std::cout << "mode,threads,ops,seconds,opsPerSec,reports\n";
+    for (bool disjoint : {true, false}) {
+        for (int threads = 1; threads <= maxThreads; threads *= 2) {
+            Bank bank;
+            initBank(bank);
+            populate(bank, accounts);
+
+            long long reports = 0;
+            double seconds = runWorkers(bank, accounts, opsPerThread, threads,
+                                        disjoint, reports);
+            long long ops = static_cast<long long>(opsPerThread) * threads;
+
+            std::cout << (disjoint ? "disjoint" : "shared") << ','
+                      << threads << ','
+                      << ops << ','
+                      << seconds << ','
+                      << static_cast<long long>(ops / seconds) << ','
+                      << reports << '\n';
+
+            destroyBank(bank);
+        }
+    }
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        double seconds = runSharded(accounts, opsPerThread, threads);
+        long long ops = static_cast<long long>(opsPerThread) * threads;
+        std::cout << "sharded," << threads << ',' << ops << ',' << seconds << ','
+                  << static_cast<long long>(ops / seconds) << ",0\n";
+    }
+    return 0;
+}
@@ -0,0 +1,429 @@
+// Microbenchmarks of the individual data structures and service paths,
+// meant for catching performance regressions between commits.
+//
+//  - bst_insert_seq / bst_insert_random : insertAccount of keys 1..n
+//  - bst_search_seq / bst_search_random : searchAccount of every key, in
+//                                         random order, in a tree built
+//                                         from sequential / random keys
+//  - radix_insert_* / radix_search_*    : the same with RadixAccountIndex
+//  - list_add_transaction               : addTransaction on a plain list
+//                                         already holding n entries
+//  - history_append                     : appendHistory (hot list + cold
+//                                         spills) on a history of n entries
+//  - history_append_in_memory           : the same with InMemoryHistory
+//  - queue_enqueue / queue_dequeue      : the pending FIFO alone
+//  - queue_enqueue_deque / ..._dequeue  : the same with DequePendingQueue
+//  - process_pending_queue              : applyPendingQueue (the silent
+//                                         core of processPendingQueue) on
+//                                         n queued operations
+//  - apply_interest_all                 : one posting on a bank of n accounts
+//  - interest_catch_up                  : first deposit to every account
+//                                         after 12 postings, per account
+//  - csv_save / csv_load                : saveBankToFiles / loadBankFromFiles
+//                                         of n accounts with 10 entries each
+//  - bank_mixed                         : a deposit, a withdrawal and a
+//                                         transfer per account on a bank of
+//                                         n accounts created in key order;
+//                                         also run on each BankWithOther*
+//                                         type (suffix _other_index, ...)
+//
+// Each benchmark runs `repetitions` times on fresh data; the fastest run
+// is reported. Structures with alternative policies (bank_policies.h) are
+// measured once per policy, under the reference name plus a suffix.
+//
+// Usage: bank_bench [filter] [repetitions]
+//   filter: only benchmarks whose name contains it ("" or "all" = every one)
+// Output: CSV (benchmark,size,ops,seconds,nsPerOp), one line per run,
+// stable names and sizes so outputs of two commits can be diffed.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "account_bst.h"
+#include "bank_policies.h"
+#include "bank_service.h"
+#include "history_store.h"
+#include "name_pool.h"
+#include "pending_queue.h"
+#include "persistence.h"
+#include "transaction_list.h"
+
+namespace {
+
+using namespace bank;
+using Clock = std::chrono::steady_clock;
+
+/// Command-line settings.
+struct Options {
+    std::string filter;
+    int         repetitions{3};
+};
+
+/// Discards std::cout while alive (loading and saving print progress).
+struct QuietCout {
+    QuietCout() : saved(std::cout.rdbuf(nullptr)) {}
+    ~QuietCout() {
+        std::cout.rdbuf(saved);
+        std::cout.clear();
+    }
+
+    QuietCout(const QuietCout&) = delete;
+    QuietCout& operator=(const QuietCout&) = delete;
+
+    std::streambuf* saved;
+};
+
+/// Runs one benchmark `options.repetitions` times and prints the best.
+///
+/// `run` prepares fresh data, then times only the measured part by
+/// calling the stopwatch it is given around it, and returns the number
+/// of operations performed.
+void bench(const Options& options, const std::string& name, long long size,
+           const std::function<long long(const std::function<void(const std::function<void()>&)>&)>& run) {
+    if (!options.filter.empty() && name.find(options.filter) == std::string::npos) {
+        return;
+    }
+
+    double best = -1.0;
+    long long ops = 0;
+    for (int r = 0; r < options.repetitions; ++r) {
+        double seconds = 0.0;
+        auto stopwatch = [&](const std::function<void()>& measured) {
+            Clock::time_point start = Clock::now();
+            measured();
+            seconds += std::chrono::duration<double>(Clock::now() - start).count();
+        };
+        ops = run(stopwatch);
+        if (best < 0.0 || seconds < best) {
+            best = seconds;
+        }
+    }
+
+    std::cout << name << ',' << size << ',' << ops << ',' << best << ','
+              << (ops > 0 ? best * 1e9 / static_cast<double>(ops) : 0.0) << std::endl;
+}
+
+using Stopwatch = std::function<void(const std::function<void()>&)>;
+
+std::vector<int> keys(int n, bool shuffled) {
+    std::vector<int> numbers(static_cast<std::size_t>(n));
+    std::iota(numbers.begin(), numbers.end(), 1);
+    if (shuffled) {
+        std::shuffle(numbers.begin(), numbers.end(), std::mt19937(42));
+    }
+    return numbers;
+}
+
+/// A tree of the given keys, built outside of any bank.
+template <typename Index>
+void buildTree(typename Index::Root& root, NamePool& pool, const std::vector<int>& numbers) {
+    PooledName name = internName(pool, "Bench Holder");
+    for (int number : numbers) {
+        bool inserted = false;
+        Index::insert(root, number, name, 100.0, inserted, 0, 1.0);
+    }
+}
+
+/// A bank with accounts 1..n (created in random order).
+template <typename BankT>
+void buildBank(BankT& bank, int n, int entriesPerAccount) {
+    initBank(bank);
+    for (int number : keys(n, true)) {
+        createAccount(bank, number, "Bench Holder", 1000.0);
+    }
+    std::vector<BatchOperation> ops;
+    for (int e = 0; e < entriesPerAccount; ++e) {
+        ops.clear();
+        for (int number = 1; number <= n; ++number) {
+            ops.push_back({number, e % 3 == 2 ? TransactionType::Withdraw
+                                              : TransactionType::Deposit, 10.0});
+        }
+        applyBatch(bank, ops);
+    }
+}
+
+template <typename Index>
+void indexBenchmarks(const Options& options, const std::string& prefix) {
+    for (bool random : {false, true}) {
+        // Sequential keys degrade the unbalanced tree to a list: O(n^2).
+        const std::vector<int> sizes = random ? std::vector<int>{10000, 100000, 1000000}
+                                              : std::vector<int>{1000, 4000, 16000};
+        for (int n : sizes) {
+            std::vector<int> numbers = keys(n, random);
+            bench(options, prefix + (random ? "_insert_random" : "_insert_seq"), n,
+                  [&](const Stopwatch& time) {
+                      auto root = std::make_unique<typename Index::Root>();
+                      Index::init(*root);
+                      NamePool pool;
+                      time([&] { buildTree<Index>(*root, pool, numbers); });
+                      Index::clear(*root);
+                      freeNamePool(pool);
+                      return static_cast<long long>(n);
+                  });
+
+            std::vector<int> lookups = keys(n, true);
+            bench(options, prefix + (random ? "_search_random" : "_search_seq"), n,
+                  [&](const Stopwatch& time) {
+                      auto root = std::make_unique<typename Index::Root>();
+                      Index::init(*root);
+                      NamePool pool;
+                      buildTree<Index>(*root, pool, numbers);
+                      long long found = 0;
+                      time([&] {
+                          for (int number : lookups) {
+                              found += Index::find(*root, number) != nullptr;
+                          }
+                      });
+                      Index::clear(*root);
+                      freeNamePool(pool);
+                      return found;
+                  });
+        }
+    }
+}
+
+void treeBenchmarks(const Options& options) {
+    indexBenchmarks<BstAccountIndex>(options, "bst");
+    indexBenchmarks<RadixAccountIndex>(options, "radix");
+}
+
+template <typename History>
+void historyAppendBenchmarks(const Options& options, const std::string& name) {
+    const std::string datetime = "2025-01-01 12:00:00";
+
+    for (int n : {10000, 100000, 1000000}) {
+        bench(options, name, n, [&](const Stopwatch& time) {
+            typename History::Store store;
+            History::openStore(store);
+            AccountHistory history;
+            auto append = [&](int count) {
+                for (int i = 0; i < count; ++i) {
+                    History::append(store, history, TransactionType::Deposit, 1.0, i, datetime);
+                }
+            };
+            append(n);
+            constexpr int kAppends = 100000;
+            time([&] { append(kAppends); });
+            for (HistoryGarbage& garbage : takeHistoryGarbage(history)) {
+                freeHistoryGarbage(garbage);
+            }
+            freeHistory(history);
+            History::closeStore(store);
+            return static_cast<long long>(kAppends);
+        });
+    }
+}
+
+void historyBenchmarks(const Options& options) {
+    const std::string datetime = "2025-01-01 12:00:00";
+
+    // Appending walks the whole list: O(n) per entry.
+    for (int n : {1000, 10000, 100000}) {
+        bench(options, "list_add_transaction", n, [&](const Stopwatch& time) {
+            // Built by hand: n addTransaction calls would take O(n^2).
+            Transaction* head = nullptr;
+            Transaction* tail = nullptr;
+            for (int i = 0; i < n; ++i) {
+                Transaction* node = new Transaction(TransactionType::Deposit, 1.0, datetime,
+                                                    i, nullptr);
+                (tail ? tail->next : head) = node;
+                tail = node;
+            }
+            constexpr int kAppends = 1000;
+            time([&] {
+                for (int i = 0; i < kAppends; ++i) {
+                    addTransaction(head, TransactionType::Deposit, 1.0, datetime, n + i);
+                }
+            });
+            freeTransactions(head);
+            return static_cast<long long>(kAppends);
+        });
+    }
+
+    historyAppendBenchmarks<TieredHistory>(options, "history_append");
+    historyAppendBenchmarks<InMemoryHistory>(options, "history_append_in_memory");
+}
+
+template <typename Queue>
+void queuePolicyBenchmarks(const Options& options, const std::string& suffix) {
+    for (int n : {10000, 100000, 1000000}) {
+        bench(options, "queue_enqueue" + suffix, n, [&](const Stopwatch& time) {
+            typename Queue::Queue queue;
+            Queue::init(queue);
+            time([&] {
+                for (int i = 0; i < n; ++i) {
+                    Queue::push(queue, i, TransactionType::Deposit, 1.0);
+                }
+            });
+            Queue::clear(queue);
+            return static_cast<long long>(n);
+        });
+
+        bench(options, "queue_dequeue" + suffix, n, [&](const Stopwatch& time) {
+            typename Queue::Queue queue;
+            Queue::init(queue);
+            for (int i = 0; i < n; ++i) {
+                Queue::push(queue, i, TransactionType::Deposit, 1.0);
+            }
+            time([&] {
+                PendingTransaction item(0, TransactionType::Deposit, 0.0);
+                while (Queue::pop(queue, item)) {
+                }
+            });
+            Queue::clear(queue);
+            return static_cast<long long>(n);
+        });
+    }
+}
+
+void queueBenchmarks(const Options& options) {
+    queuePolicyBenchmarks<LinkedPendingQueue>(options, "");
+    queuePolicyBenchmarks<DequePendingQueue>(options, "_deque");
+
+    constexpr int kAccounts = 10000;
+    for (int n : {10000, 100000, 1000000}) {
+        bench(options, "process_pending_queue", n, [&](const Stopwatch& time) {
+            Bank bank;
+            buildBank(bank, kAccounts, 0);
+            for (int i = 0; i < n; ++i) {
+                queuePendingTransaction(bank, 1 + i % kAccounts,
+                                        i % 3 == 2 ? TransactionType::Withdraw
+                                                   : TransactionType::Deposit, 1.0);
+            }
+            QueueRunSummary run;
+            time([&] { run = applyPendingQueue(bank); });
+            destroyBank(bank);
+            return static_cast<long long>(run.applied + run.skipped);
+        });
+    }
+}
+
+void interestBenchmarks(const Options& options) {
+    for (int n : {10000, 100000, 1000000}) {
+        bench(options, "apply_interest_all", n, [&](const Stopwatch& time) {
+            Bank bank;
+            buildBank(bank, n, 0);
+            {
+                QuietCout quiet;
+                time([&] { applyInterestAll(bank, 0.01); });
+            }
+            destroyBank(bank);
+            return 1LL;
+        });
+
+        bench(options, "interest_catch_up", n, [&](const Stopwatch& time) {
+            Bank bank;
+            buildBank(bank, n, 0);
+            for (int month = 0; month < 12; ++month) {
+                postInterest(bank, 0.001);
+            }
+            std::vector<BatchOperation> ops;
+            for (int number = 1; number <= n; ++number) {
+                ops.push_back({number, TransactionType::Deposit, 1.0});
+            }
+            time([&] { applyBatch(bank, ops); });
+            destroyBank(bank);
+            return static_cast<long long>(n);
+        });
+    }
+}
+
+void csvBenchmarks(const Options& options) {
+    const std::string accountsFile     = "bank_bench_accounts.csv";
+    const std::string transactionsFile = "bank_bench_transactions.csv";
+
+    // Sizes as bst_insert_seq: loading is the sequential-key worst case.
+    for (int n : {1000, 4000, 16000}) {
+        bench(options, "csv_save", n, [&](const Stopwatch& time) {
+            Bank bank;
+            buildBank(bank, n, 10);
+            time([&] { saveBankToFiles(bank, accountsFile, transactionsFile); });
+            destroyBank(bank);
+            return static_cast<long long>(n);
+        });
+
+        // Saved files list the accounts in key order.
+        bench(options, "csv_load", n, [&](const Stopwatch& time) {
+            {
+                Bank bank;
+                buildBank(bank, n, 10);
+                saveBankToFiles(bank, accountsFile, transactionsFile);
+                destroyBank(bank);
+            }
+            Bank bank;
+            initBank(bank);
+            {
+                QuietCout quiet;
+                time([&] { loadBankFromFiles(bank, accountsFile, transactionsFile); });
+            }
+            destroyBank(bank);
+            return static_cast<long long>(n);
+        });
+    }
+
+    std::remove(accountsFile.c_str());
+    std::remove(transactionsFile.c_str());
+}
+
+template <typename BankT>
+void bankTypeBenchmarks(const Options& options, const std::string& suffix) {
+    // Sizes as bst_insert_seq: accounts created in key order.
+    for (int n : {1000, 4000, 16000}) {
+        bench(options, "bank_mixed" + suffix, n, [&](const Stopwatch& time) {
+            auto bank = std::make_unique<BankT>();
+            initBank(*bank);
+            for (int number = 1; number <= n; ++number) {
+                addAccount(*bank, number, "Bench Holder", 1000.0);
+            }
+            long long ops = 0;
+            time([&] {
+                for (int number = 1; number <= n; ++number) {
+                    const BatchOperation pair[] = {{number, TransactionType::Deposit, 10.0},
+                                                   {number, TransactionType::Withdraw, 5.0}};
+                    applyBatch(*bank, pair, 2);
+                    transferFunds(*bank, number, number % n + 1, 1.0);
+                    ops += 3;
+                }
+            });
+            destroyBank(*bank);
+            return ops;
+        });
+    }
+}
+
+void bankBenchmarks(const Options& options) {
+    bankTypeBenchmarks<Bank>(options, "");
+    bankTypeBenchmarks<BankWithOtherIndex>(options, "_other_index");
+    bankTypeBenchmarks<BankWithOtherHistory>(options, "_other_history");
+    bankTypeBenchmarks<BankWithOtherQueue>(options, "_other_queue");
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (argc > 1 && std::string(argv[1]) != "all") {
+        options.filter = argv[1];
+    }
+    if (argc > 2) {
+        options.repetitions = std::max(1, std::atoi(argv[2]));
+    }
+
+    std::cout << "benchmark,size,ops,seconds,nsPerOp\n";
+    treeBenchmarks(options);
+    historyBenchmarks(options);
+    queueBenchmarks(options);
+    interestBenchmarks(options);
+    csvBenchmarks(options);
+    bankBenchmarks(options);
+    return 0;
+}
@@ -0,0 +1,462 @@
+// Synthetic workload generator and trace replay for capacity planning.
+//
+// Datasets:
+//   bank_workload dataset <accounts> [txPerAccount] [accountsFile transactionsFile] [zipf] [seed]
+// Writes accounts.csv / transactions.csv in the format of persistence.h,
+// streaming, so any size fits in memory (8 bytes per account). Accounts
+// are written in random order (sorted keys would turn the unbalanced
+// account tree into a list on loading). Histories cover the year 2025:
+// deposits and withdrawals (a withdrawal the balance cannot cover becomes
+// a deposit) with monthly Interest entries. How many transactions an
+// account has follows a Zipf distribution (exponent `zipf`, default
+// 0.99), so a few accounts have long histories and most have short ones.
+//
+// Traces:
+//   bank_workload trace <accounts> <operations> [file|-] [zipf] [seed]
+// Writes an operation trace in the batch language of commands.h, for
+// accounts 1..accounts (e.g. of a generated dataset). Accounts are picked
+// Zipf-skewed; the mix is 40% deposit, 30% withdraw, 15% enqueue,
+// 10% balance, 5% transfer, with a "process" line every
+// kProcessEvery operations and an "interest" line every kInterestEvery.
+// Any batch command file (e.g. one recorded from a real session) is a
+// trace as well.
+//
+// Replay:
+//   bank_workload replay <traceFile> [accountsFile transactionsFile]
+// Loads the dataset (if given), then runs the trace one command at a
+// time through the service layer (executeCommand), timing each.
+// Output: CSV, one line per command verb and a total line
+// (verb,count,failed,seconds,opsPerSec,p50us,p99us,p999us,maxus);
+// `seconds` is the time spent in that verb (wall time for the total).
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bank_service.h"
+#include "commands.h"
+#include "persistence.h"
+
+namespace {
+
+using namespace bank;
+
+/// Trace: a "process" line after this many operations...
+constexpr long long kProcessEvery = 1000;
+
+/// ...and an "interest" line after this many.
+constexpr long long kInterestEvery = 100000;
+
+/// Rate of the trace's interest lines and of the datasets' monthly entries.
+constexpr double kInterestRate = 0.001;
+
+/// Draws ranks 1..n with P(k) ~ 1 / k^s in O(1) time and memory
+/// (rejection-inversion, Hörmann & Derflinger 1996).
+class ZipfSampler {
+public:
+    ZipfSampler(long long n, double s)
+        : n_(n), s_(s),
+          hIntegralX1_(hIntegral(1.5) - 1.0),
+          hIntegralN_(hIntegral(static_cast<double>(n) + 0.5)),
+          threshold_(2.0 - hIntegralInverse(hIntegral(2.5) - h(2.0))) {}
+
+    template <typename Rng>
+    long long operator()(Rng& rng) {
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        while (true) {
+            double u = hIntegralN_ + unit(rng) * (hIntegralX1_ - hIntegralN_);
+            double x = hIntegralInverse(u);
+            long long k = std::clamp(static_cast<long long>(x + 0.5), 1LL, n_);
+            if (static_cast<double>(k) - x <= threshold_ ||
+                u >= hIntegral(static_cast<double>(k) + 0.5) - h(static_cast<double>(k))) {
+                return k;
+            }
+        }
+    }
+
+private:
+    double h(double x) const { return std::exp(-s_ * std::log(x)); }
+
+    double hIntegral(double x) const {
+        double logX = std::log(x);
+        return helper2((1.0 - s_) * logX) * logX;
+    }
+
+    double hIntegralInverse(double x) const {
+        double t = std::max(-1.0, x * (1.0 - s_));
+        return std::exp(helper1(t) * x);
+    }
+
+    /// log1p(x) / x, accurate near 0.
+    static double helper1(double x) {
+        return std::abs(x) > 1e-8 ? std::log1p(x) / x
+                                  : 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+    }
+
+    /// expm1(x) / x, accurate near 0.
+    static double helper2(double x) {
+        return std::abs(x) > 1e-8 ? std::expm1(x) / x
+                                  : 1.0 + x * 0.5 * (1.0 + x * (1.0 / 3.0) * (1.0 + 0.25 * x));
+    }
+
+    long long n_;
+    double    s_;
+    double    hIntegralX1_;
+    double    hIntegralN_;
+    double    threshold_;
+};
+
+/// Spreads Zipf ranks over account numbers 1..n, so the hot accounts are
+/// not all neighbours: rank r -> 1 + (r - 1) * stride mod n, with a
+/// stride coprime to n (a permutation).
+class RankToAccount {
+public:
+    explicit RankToAccount(long long n) : n_(n), stride_(n == 1 ? 1 : 2654435761LL % n) {
+        while (stride_ == 0 || std::gcd(stride_, n_) != 1) {
+            stride_ = (stride_ + 1) % n_;
+        }
+    }
+
+    int operator()(long long rank) const {
+        return static_cast<int>(1 + ((rank - 1) * stride_) % n_);
+    }
+
+private:
+    long long n_;
+    long long stride_;
+};
+
+/// "YYYY-MM-DD HH:MM:SS" of `seconds` after 2025-01-01 00:00:00.
+std::string datetimeAt(long long seconds) {
+    static const int kMonthDays[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    long long day = seconds / 86400;
+    long long rest = seconds % 86400;
+    int month = 0;
+    while (month < 11 && day >= kMonthDays[month]) {
+        day -= kMonthDays[month++];
+    }
+    char text[32];
+    std::snprintf(text, sizeof(text), "2025-%02d-%02d %02d:%02d:%02d",
+                  month + 1, static_cast<int>(day + 1), static_cast<int>(rest / 3600),
+                  static_cast<int>(rest / 60 % 60), static_cast<int>(rest % 60));
+    return text;
+}
+
+/// Seconds from 2025-01-01 to the first day of `month` (0-based, 12 = 2026).
+long long monthStart(int month) {
+    static const int kMonthDays[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    long long days = 0;
+    for (int m = 0; m < month; ++m) {
+        days += kMonthDays[m];
+    }
+    return days * 86400;
+}
+
+/// Cents as "d.cc".
+void writeCents(std::ostream& out, long long cents) {
+    out << cents / 100 << '.' << std::setw(2) << std::setfill('0') << cents % 100
+        << std::setfill(' ');
+}
+
+int runDataset(int argc, char** argv) {
+    const long long accounts     = argc > 2 ? std::atoll(argv[2]) : 1000000;
+    const long long txPerAccount = argc > 3 ? std::atoll(argv[3]) : 20;
+    const std::string accountsFile     = argc > 5 ? argv[4] : "accounts.csv";
+    const std::string transactionsFile = argc > 5 ? argv[5] : "transactions.csv";
+    const double zipf = argc > 6 ? std::atof(argv[6]) : 0.99;
+    const unsigned seed = argc > 7 ? static_cast<unsigned>(std::atoi(argv[7])) : 42;
+    if (accounts < 1 || accounts > 2000000000LL || txPerAccount < 0 || zipf <= 0.0) {
+        std::cerr << "Error: invalid dataset arguments.\n";
+        return 2;
+    }
+
+    std::ofstream accOut(accountsFile);
+    std::ofstream txOut(transactionsFile);
+    if (!accOut.is_open() || !txOut.is_open()) {
+        std::cerr << "Error: could not open output files.\n";
+        return 1;
+    }
+    accOut << "accountNumber,holderName,balance,openingBalance\n";
+    txOut << "accountNumber,type,amount,datetime,balanceAfter,counterparty,transferId\n";
+
+    std::mt19937_64 rng(seed);
+
+    // Transactions per account: accounts * txPerAccount Zipf draws.
+    std::vector<std::uint32_t> counts(static_cast<std::size_t>(accounts), 0);
+    {
+        ZipfSampler pick(accounts, zipf);
+        RankToAccount toAccount(accounts);
+        for (long long i = 0; i < accounts * txPerAccount; ++i) {
+            ++counts[static_cast<std::size_t>(toAccount(pick(rng)) - 1)];
+        }
+    }
+
+    // Random account order, see the top of the file.
+    std::vector<int> order(static_cast<std::size_t>(accounts));
+    std::iota(order.begin(), order.end(), 1);
+    std::shuffle(order.begin(), order.end(), rng);
+
+    static const char* const kFirstNames[] = {"Alice", "Bob", "Carol", "Dave", "Erin",
+                                              "Frank", "Grace", "Heidi", "Ivan", "Judy"};
+    static const char* const kLastNames[] = {"Smith", "Jones", "Brown", "Taylor", "Wilson",
+                                             "Davies", "Evans", "Thomas", "Johnson", "Roberts"};
+    std::uniform_int_distribution<int> pickName(0, 9);
+    std::uniform_int_distribution<long long> pickOpening(10000, 1000000);   // cents
+    std::uniform_int_distribution<long long> pickAmount(100, 50000);
+    std::uniform_int_distribution<long long> pickSecond(0, monthStart(12) - 1);
+    std::uniform_int_distribution<int> pickKind(0, 9);
+
+    std::vector<long long> times;
+    long long rows = 0;
+    for (int account : order) {
+        const long long opening = pickOpening(rng);
+        long long balance = opening;
+
+        times.resize(counts[static_cast<std::size_t>(account - 1)]);
+        for (long long& t : times) {
+            t = pickSecond(rng);
+        }
+        std::sort(times.begin(), times.end());
+
+        // Each month boundary crossed before a transaction posts interest.
+        int month = 1;
+        auto postInterestUntil = [&](long long time) {
+            for (; month < 12 && monthStart(month) <= time; ++month) {
+                long long interest = std::llround(static_cast<double>(balance) * kInterestRate);
+                if (interest <= 0) {
+                    continue;
+                }
+                balance += interest;
+                txOut << account << ",Interest,";
+                writeCents(txOut, interest);
+                txOut << ',' << datetimeAt(monthStart(month)) << ',';
+                writeCents(txOut, balance);
+                txOut << ",0,0\n";
+                ++rows;
+            }
+        };
+
+        for (long long time : times) {
+            postInterestUntil(time);
+            long long amount = pickAmount(rng);
+            bool withdraw = pickKind(rng) < 4 && amount <= balance;
+            balance += withdraw ? -amount : amount;
+            txOut << account << (withdraw ? ",Withdraw," : ",Deposit,");
+            writeCents(txOut, amount);
+            txOut << ',' << datetimeAt(time) << ',';
+            writeCents(txOut, balance);
+            txOut << ",0,0\n";
+            ++rows;
+        }
+        postInterestUntil(monthStart(12) - 1);
+
+        accOut << account << ',' << kFirstNames[pickName(rng)] << ' '
+               << kLastNames[pickName(rng)] << ',';
+        writeCents(accOut, balance);
+        accOut << ',';
+        writeCents(accOut, opening);
+        accOut << '\n';
+    }
+
+    if (!accOut.good() || !txOut.good()) {
+        std::cerr << "Error: writing the dataset failed.\n";
+        return 1;
+    }
+    std::cerr << "Wrote " << accounts << " accounts to " << accountsFile << " and "
+              << rows << " transactions to " << transactionsFile << ".\n";
+    return 0;
+}
+
+int runTrace(int argc, char** argv) {
+    if (argc < 4) {
+        std::cerr << "Error: trace needs <accounts> <operations>.\n";
+        return 2;
+    }
+    const long long accounts   = std::atoll(argv[2]);
+    const long long operations = std::atoll(argv[3]);
+    const std::string file = argc > 4 ? argv[4] : "-";
+    const double zipf = argc > 5 ? std::atof(argv[5]) : 0.99;
+    const unsigned seed = argc > 6 ? static_cast<unsigned>(std::atoi(argv[6])) : 42;
+    if (accounts < 1 || accounts > 2000000000LL || operations < 0 || zipf <= 0.0) {
+        std::cerr << "Error: invalid trace arguments.\n";
+        return 2;
+    }
+
+    std::ofstream fileOut;
+    std::ostream* out = &std::cout;
+    if (file != "-") {
+        fileOut.open(file);
+        if (!fileOut.is_open()) {
+            std::cerr << "Error: could not open trace file '" << file << "'.\n";
+            return 1;
+        }
+        out = &fileOut;
+    }
+
+    std::mt19937_64 rng(seed);
+    ZipfSampler pick(accounts, zipf);
+    RankToAccount toAccount(accounts);
+    std::uniform_int_distribution<int> pickKind(0, 99);
+    std::uniform_int_distribution<long long> pickAmount(100, 20000);   // cents
+
+    *out << "# bank_workload trace: " << accounts << " accounts, " << operations
+         << " operations, zipf " << zipf << ", seed " << seed << '\n';
+    for (long long i = 1; i <= operations; ++i) {
+        int kind = pickKind(rng);
+        int account = toAccount(pick(rng));
+        if (kind < 40) {
+            *out << "deposit " << account << ' ';
+        } else if (kind < 70) {
+            *out << "withdraw " << account << ' ';
+        } else if (kind < 85) {
+            *out << "enqueue " << account << (kind < 78 ? " deposit " : " withdraw ");
+        } else if (kind < 95) {
+            *out << "balance " << account << '\n';
+        } else {
+            *out << "transfer " << account << ' ' << toAccount(pick(rng)) << ' ';
+        }
+        if (kind < 85 || kind >= 95) {
+            writeCents(*out, pickAmount(rng));
+            *out << '\n';
+        }
+
+        if (i % kProcessEvery == 0) {
+            *out << "process\n";
+        }
+        if (i % kInterestEvery == 0) {
+            *out << "interest " << kInterestRate << '\n';
+        }
+    }
+
+    out->flush();
+    if (!out->good()) {
+        std::cerr << "Error: writing the trace failed.\n";
+        return 1;
+    }
+    return 0;
+}
+
+/// Latencies of one command verb.
+struct VerbStats {
+    std::vector<double> latenciesUs;
+    long long           failed{0};
+    double              seconds{0.0};
+};
+
+double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    return sorted[static_cast<std::size_t>(p * static_cast<double>(sorted.size() - 1))];
+}
+
+void printStats(const std::string& verb, VerbStats& stats) {
+    std::vector<double>& sorted = stats.latenciesUs;
+    std::sort(sorted.begin(), sorted.end());
+    double opsPerSec = stats.seconds > 0.0 ? static_cast<double>(sorted.size()) / stats.seconds
+                                           : 0.0;
+    std::cout << verb << ',' << sorted.size() << ',' << stats.failed << ','
+              << stats.seconds << ',' << opsPerSec << ','
+              << percentile(sorted, 0.50) << ',' << percentile(sorted, 0.99) << ','
+              << percentile(sorted, 0.999) << ',' << (sorted.empty() ? 0.0 : sorted.back())
+              << '\n';
+}
+
+/// Sends std::cout to std::cerr while alive (the loader's messages must
+/// not mix with the CSV output).
+struct CoutToCerr {
+    CoutToCerr() : saved(std::cout.rdbuf(std::cerr.rdbuf())) {}
+    ~CoutToCerr() { std::cout.rdbuf(saved); }
+
+    CoutToCerr(const CoutToCerr&) = delete;
+    CoutToCerr& operator=(const CoutToCerr&) = delete;
+
+    std::streambuf* saved;
+};
+
+int runReplay(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "Error: replay needs <traceFile>.\n";
+        return 2;
+    }
+    std::ifstream in(argv[2]);
+    if (!in.is_open()) {
+        std::cerr << "Error: could not open trace file '" << argv[2] << "'.\n";
+        return 1;
+    }
+
+    Bank bank;
+    initBank(bank);
+    if (argc > 4) {
+        CoutToCerr quiet;
+        auto start = std::chrono::steady_clock::now();
+        loadBankFromFiles(bank, argv[3], argv[4]);
+        std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+        std::cerr << "Loaded the dataset in " << seconds.count() << " s.\n";
+    }
+
+    std::map<std::string, VerbStats> byVerb;
+    VerbStats total;
+    std::string line;
+    auto start = std::chrono::steady_clock::now();
+    while (std::getline(in, line)) {
+        auto before = std::chrono::steady_clock::now();
+        std::string result = executeCommand(bank, line);
+        auto after = std::chrono::steady_clock::now();
+        if (result.empty()) {
+            continue;   // blank or comment
+        }
+
+        std::string verb = line.substr(0, line.find(' '));
+        VerbStats& stats = byVerb[verb];
+        std::chrono::duration<double> elapsed = after - before;
+        stats.latenciesUs.push_back(elapsed.count() * 1e6);
+        stats.seconds += elapsed.count();
+        total.latenciesUs.push_back(elapsed.count() * 1e6);
+        if (result.compare(0, 5, "error") == 0) {
+            ++stats.failed;
+            ++total.failed;
+        }
+    }
+    total.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "verb,count,failed,seconds,opsPerSec,p50us,p99us,p999us,maxus\n";
+    for (auto& entry : byVerb) {
+        printStats(entry.first, entry.second);
+    }
+    printStats("total", total);
+
+    destroyBank(bank);
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc >= 2 && std::strcmp(argv[1], "dataset") == 0) {
+        return runDataset(argc, argv);
+    }
+    if (argc >= 2 && std::strcmp(argv[1], "trace") == 0) {
+        return runTrace(argc, argv);
+    }
+    if (argc >= 2 && std::strcmp(argv[1], "replay") == 0) {
+        return runReplay(argc, argv);
+    }
+    std::cerr << "Usage: bank_workload dataset <accounts> [txPerAccount]"
+                 " [accountsFile transactionsFile] [zipf] [seed]\n"
+              << "       bank_workload trace <accounts> <operations> [file|-] [zipf] [seed]\n"
+              << "       bank_workload replay <traceFile> [accountsFile transactionsFile]\n";
+    return 2;
+}
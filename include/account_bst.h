@@ -1,32 +1,53 @@
 #ifndef ACCOUNT_BST_H
 #define ACCOUNT_BST_H
 
+#include <atomic>
+#include <cstddef>
+#include <mutex>
 #include <string>
-#include "transaction_list.h"
+#include <vector>
+#include "history_store.h"
+#include "name_pool.h"
 
 namespace bank {
 
+struct AccountVersion;   // snapshot.h
+struct VelocityState;    // velocity.h
+
 /// Represents one bank account.
 ///
 /// Fields:
 ///  - accountNumber : unique integer ID (key in the BST)
-///  - holderName    : owner's name
+///  - holderName    : owner's name (stored once in the bank's NamePool)
 ///  - balance       : current money balance
-///  - historyHead   : pointer to the head of the transaction list
+///  - openingBalance: balance the account was opened with (the starting
+///                    point for replaying or checkpointing the history)
+///  - history       : transaction history (recent entries in memory,
+///                    older ones spilled to disk, see history_store.h)
+///  - interestApplied: number of the bank's interest postings already
+///                    materialized on this account (see applyInterestAll)
+///  - interestFactor: product of (1 + rate) over those postings; the bank
+///                    aggregates divide balances by it (see BankAggregates)
+///  - velocity      : rolling withdrawal totals for the bank's velocity
+///                    limits, created on the first checked withdrawal
 struct Account {
-    int         accountNumber{};
-    std::string holderName;
-    double      balance{};
-    Transaction* historyHead{nullptr};
+    int            accountNumber{};
+    PooledName     holderName;
+    double         balance{};
+    double         openingBalance{};
+    AccountHistory history;
+    std::size_t    interestApplied{0};
+    double         interestFactor{1.0};
+    VelocityState* velocity{nullptr};
 
     /// Convenience constructor to initialize all fields.
     Account(int number = 0,
-            std::string name = {},
+            PooledName name = {},
             double bal = 0.0)
         : accountNumber(number),
-          holderName(std::move(name)),
+          holderName(name),
           balance(bal),
-          historyHead(nullptr) {}
+          openingBalance(bal) {}
 };
 
 /// Node in the Binary Search Tree of accounts.
@@ -35,51 +56,120 @@ struct Account {
 ///  - data : the Account
 ///  - left : pointer to left child (accounts with smaller accountNumber)
 ///  - right: pointer to right child (accounts with larger accountNumber)
+///  - lock : guards data.balance and data.history for writers.
+///           When two accounts are locked together (transfers), the one
+///           with the smaller accountNumber is always locked first.
+///  - version : newest published state of the account (see snapshot.h);
+///              readers use this instead of data and never take the lock
+///  - closing : set (under lock) when closing the account starts, before
+///              it is archived; writers then leave it alone. Cleared
+///              again if the archive fails
+///  - closed  : set (under lock) when the account is closed; the node is
+///              then ignored by searches too
+///
+/// The child pointers are atomic so that searches and traversals can run
+/// without any lock while another thread inserts: a new node is fully
+/// built before it is linked in with a release store. accountNumber,
+/// holderName and openingBalance never change once a node is linked
+/// (except holderName in compactBank, which has the bank to itself).
+///
+/// A closed node with at most one child is unlinked (its parent link is
+/// pointed at the child, so a search standing on it still goes on
+/// correctly) and freed once no reader can reach it. A closed node with
+/// two children stays in the tree as a routing "tombstone" until
+/// compaction can unlink it. Its number may be reused meanwhile: equal
+/// keys behind a tombstone live in its right subtree.
 struct AccountNode {
     Account     data;
-    AccountNode* left;
-    AccountNode* right;
+    std::atomic<AccountNode*> left;
+    std::atomic<AccountNode*> right;
+    std::atomic<AccountVersion*> version;
+    std::atomic<bool> closing;
+    std::atomic<bool> closed;
+    std::mutex  lock;
 
-    explicit AccountNode(const Account& acc)
-        : data(acc), left(nullptr), right(nullptr) {}
+    /// Builds the account in place (no Account temporary to copy).
+    AccountNode(int accountNumber, PooledName name, double balance)
+        : data(accountNumber, name, balance),
+          left(nullptr), right(nullptr), version(nullptr), closing(false), closed(false) {}
 };
 
 /// Inserts a new account into the BST rooted at `root`.
 ///
-/// @param root          Reference to pointer of tree root.
+/// Safe to run while other threads search or traverse the tree.
+/// Inserts themselves must be serialized by the caller.
+///
+/// @param root          Reference to the (atomic) tree root pointer.
 /// @param accountNumber New account's unique ID.
-/// @param name          Account holder name.
+/// @param name          Account holder name (interned by the caller).
 /// @param initialBalance Starting balance.
 /// @param inserted      Output flag:
 ///                      - true  if a new node was inserted
 ///                      - false if an account with this number already exists
+/// @param interestApplied Interest postings the new account is not owed
+///                      (set before the node becomes reachable).
+/// @param interestFactor Cumulative growth of those postings.
 ///
 /// @return Pointer to the node (existing or newly created).
-AccountNode* insertAccount(AccountNode*& root,
+AccountNode* insertAccount(std::atomic<AccountNode*>& root,
                            int accountNumber,
-                           const std::string& name,
+                           PooledName name,
                            double initialBalance,
-                           bool& inserted);
+                           bool& inserted,
+                           std::size_t interestApplied = 0,
+                           double interestFactor = 1.0);
 
-/// Searches the BST for an account by accountNumber.
+/// Searches the BST for an open account by accountNumber.
+///
+/// Concurrent callers must be pinned (see ReadSnapshot), since closed
+/// nodes are freed once no pinned thread can still be standing on them.
 ///
 /// @param root          Pointer to tree root.
 /// @param accountNumber ID we are looking for.
 /// @return              Pointer to the node if found, nullptr otherwise.
 AccountNode* searchAccount(AccountNode* root, int accountNumber);
 
-/// Prints a one-line summary of a single account.
-void printAccountSummary(const Account& account);
+/// Unlinks a closed node that has at most one child.
+///
+/// Safe while other threads search or traverse the tree; must be
+/// serialized with inserts and other unlinks. The node itself is not
+/// freed (see freeAccountNode).
+/// @return false if the node has two children (it stays a tombstone).
+bool unlinkAccountNode(std::atomic<AccountNode*>& root, AccountNode* node);
 
-/// Performs in-order traversal of the BST and prints each account.
+/// Calls visit(node) for every node of the subtree, tombstones included,
+/// in account-number order.
 ///
-/// This prints accounts sorted by accountNumber.
-void inorderPrintAccounts(const AccountNode* root);
+/// Safe while other threads insert or unlink (pinned, like searchAccount).
+/// A node's right child is read before the node is visited, so with the
+/// tree to itself the visitor may free the node.
+template <typename Visit>
+void forEachAccountNode(AccountNode* node, Visit& visit) {
+    if (!node) return;
+
+    forEachAccountNode(node->left.load(), visit);
+    AccountNode* right = node->right.load();
+    visit(node);
+    forEachAccountNode(right, visit);
+}
+
+/// Links the given nodes (sorted by account number) into a balanced tree
+/// and makes it the tree at `root`. Nodes not in `sorted` are dropped
+/// from the tree, not freed. Needs the tree to itself.
+void rebuildBalanced(std::atomic<AccountNode*>& root, const std::vector<AccountNode*>& sorted);
+
+/// Frees one node that is no longer linked into the tree, with its
+/// in-memory history and its versions.
+void freeAccountNode(AccountNode* node);
+
+/// Prints a one-line summary of a single account with the given balance.
+void printAccountSummary(const Account& account, double balance);
 
-/// Frees the entire BST and all associated transaction lists.
+/// Frees the entire BST, all associated transaction lists and versions.
 ///
 /// After this call, root is set to nullptr.
-void freeAccountTree(AccountNode*& root);
+/// Must not run concurrently with any other access to the tree.
+void freeAccountTree(std::atomic<AccountNode*>& root);
 
 } // namespace bank
 
@@ -0,0 +1,103 @@
+#ifndef ACCOUNT_RADIX_H
+#define ACCOUNT_RADIX_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+#include "account_bst.h"
+
+namespace bank {
+
+/// Account index addressed by the bits of the account number: a radix
+/// tree of three levels (11, 10 and 10 bits, covering every positive
+/// int), whose leaves hold one node slot per account number.
+///
+/// A lookup is three dependent loads whatever the number of accounts and
+/// whatever order they were created in (the BST degrades to a list for
+/// sequential numbers until compactBank rebalances it). Pages are
+/// allocated on first use, so sparse numbers cost one 8 KiB leaf (and at
+/// worst one 8 KiB middle page) per 1024-number range in use. Traversal
+/// walks the slots in order, so it is in account-number order too.
+///
+/// Same concurrency contract as the BST: lookups and traversals take no
+/// lock and are safe during inserts (pages and nodes are published with
+/// release stores), inserts and unlinks are serialized by the caller.
+/// A closed node is always unlinked (its slot is cleared), so the radix
+/// tree never keeps tombstones.
+
+/// Bits of the account number resolved by each level, top first.
+constexpr int kRadixTopBits  = 11;
+constexpr int kRadixMidBits  = 10;
+constexpr int kRadixLeafBits = 10;
+
+/// Bottom level: one slot per account number.
+struct RadixLeaf {
+    std::atomic<AccountNode*> slots[1 << kRadixLeafBits]{};
+};
+
+/// Middle level: the leaves of one top-level range.
+struct RadixMid {
+    std::atomic<RadixLeaf*> leaves[1 << kRadixMidBits]{};
+};
+
+/// The whole tree (what the Bank stores): the top level.
+struct RadixTree {
+    std::atomic<RadixMid*> mids[1 << kRadixTopBits]{};
+};
+
+/// The open account with this number, or nullptr. Lock-free.
+AccountNode* radixFind(const RadixTree& tree, int accountNumber);
+
+/// Inserts a new account, like insertAccount (same parameters and
+/// result). Numbers <= 0 cannot be stored: nullptr, inserted == false.
+AccountNode* radixInsert(RadixTree& tree,
+                         int accountNumber,
+                         PooledName name,
+                         double initialBalance,
+                         bool& inserted,
+                         std::size_t interestApplied = 0,
+                         double interestFactor = 1.0);
+
+/// Clears the slot of `node` (not freed, see freeAccountNode).
+/// @return true: a radix slot can always be cleared.
+bool radixUnlink(RadixTree& tree, AccountNode* node);
+
+/// Calls visit(node) for every node in account-number order. Safe while
+/// other threads insert or unlink (pinned, like radixFind); the slot is
+/// done with once visited, so with the tree to itself the visitor may
+/// free the node.
+template <typename Visit>
+void forEachRadixNode(const RadixTree& tree, Visit& visit) {
+    for (const std::atomic<RadixMid*>& midSlot : tree.mids) {
+        const RadixMid* mid = midSlot.load(std::memory_order_acquire);
+        if (!mid) continue;
+        for (const std::atomic<RadixLeaf*>& leafSlot : mid->leaves) {
+            const RadixLeaf* leaf = leafSlot.load(std::memory_order_acquire);
+            if (!leaf) continue;
+            for (const std::atomic<AccountNode*>& slot : leaf->slots) {
+                if (AccountNode* node = slot.load(std::memory_order_acquire)) {
+                    visit(node);
+                }
+            }
+        }
+    }
+}
+
+/// Makes `sorted` the only nodes in the tree (others are dropped, not
+/// freed); pages stay allocated. Needs the tree to itself.
+void radixRebuild(RadixTree& tree, const std::vector<AccountNode*>& sorted);
+
+/// True if no slot holds a node.
+bool radixEmpty(const RadixTree& tree);
+
+/// Bytes of the pages (the nodes themselves not included).
+std::size_t radixTreeBytes(const RadixTree& tree);
+
+/// Frees every node (with its history and versions) and every page.
+/// Must not run concurrently with any other access to the tree.
+void freeRadixTree(RadixTree& tree);
+
+} // namespace bank
+
+#endif // ACCOUNT_RADIX_H
@@ -0,0 +1,75 @@
+#ifndef BALANCE_INDEX_H
+#define BALANCE_INDEX_H
+
+#include <cstddef>
+#include <set>
+#include <shared_mutex>
+#include <vector>
+
+#include "account_bst.h"
+
+namespace bank {
+
+/// Secondary index of the accounts ordered by balance.
+///
+/// Keys are "normalized" balances (balance / interestFactor, see
+/// AggregateCounters): an interest posting multiplies every balance by
+/// the same factor, so it changes neither the keys nor their order, and
+/// pending interest never has to be materialized to keep the index right.
+/// A real balance b corresponds to the key b / (the bank's interest factor).
+///
+/// The entries are spread over kBalanceIndexStripes ordered sets by
+/// account number, each with its own lock, so writers on different
+/// accounts rarely meet; queries merge the stripes in O(log n + k).
+
+/// One indexed account.
+struct BalanceIndexEntry {
+    double       key{};
+    int          accountNumber{};
+    AccountNode* node{nullptr};
+};
+
+/// Orders entries by key, then by account number.
+struct BalanceIndexLess {
+    bool operator()(const BalanceIndexEntry& a, const BalanceIndexEntry& b) const {
+        if (a.key != b.key) return a.key < b.key;
+        return a.accountNumber < b.accountNumber;
+    }
+};
+
+/// Number of independently locked stripes.
+constexpr int kBalanceIndexStripes = 16;
+
+/// One stripe: an ordered set and the lock guarding it.
+struct BalanceIndexStripe {
+    mutable std::shared_mutex                      mutex;
+    std::set<BalanceIndexEntry, BalanceIndexLess>  entries;
+};
+
+/// The whole index, owned by the Bank.
+struct BalanceIndex {
+    BalanceIndexStripe stripes[kBalanceIndexStripes];
+};
+
+/// Adds a new account with key `key`.
+void balanceIndexInsert(BalanceIndex& index, AccountNode* node, double key);
+
+/// Removes a closed account that was indexed with key `key`.
+void balanceIndexErase(BalanceIndex& index, AccountNode* node, double key);
+
+/// Moves an account from `oldKey` to `newKey`. The caller holds the node
+/// lock, so the account's key cannot change underneath.
+void balanceIndexUpdate(BalanceIndex& index, AccountNode* node, double oldKey, double newKey);
+
+/// The `n` accounts with the largest keys, largest first.
+std::vector<AccountNode*> balanceIndexTop(const BalanceIndex& index, std::size_t n);
+
+/// The accounts with low <= key <= high, smallest key first.
+std::vector<AccountNode*> balanceIndexRange(const BalanceIndex& index, double low, double high);
+
+/// Removes every entry (the nodes are freed by the caller).
+void clearBalanceIndex(BalanceIndex& index);
+
+} // namespace bank
+
+#endif // BALANCE_INDEX_H
@@ -0,0 +1,261 @@
+#ifndef BANK_POLICIES_H
+#define BANK_POLICIES_H
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "account_bst.h"
+#include "account_radix.h"
+#include "history_store.h"
+#include "pending_queue.h"
+
+namespace bank {
+
+/// Compile-time choice of the structures behind a Bank.
+///
+/// A policy is a struct of types and static functions. BasicBank
+/// (bank_service.h) is a template on one policy of each kind and stores
+/// their types; the service layer only goes through the functions of the
+/// bank's own Index, History and Queue, so every call is resolved at
+/// compile time, inlined, with no virtual dispatch. The aliases below
+/// (set by CMake options) pick the default combination, Bank; the
+/// Other*Policy aliases name the alternative of each kind, and the
+/// service layer is built for the default and for each single swap (see
+/// BANK_FOR_EACH_BANK_TYPE), which is how bank_bench measures the
+/// alternatives side by side.
+///
+/// Account index policy:
+///  - Root                        : what the Bank stores
+///  - init / empty / clear
+///  - find(root, number)          : open account or nullptr; lock-free,
+///                                  safe during inserts (caller pinned)
+///  - insert(root, ...)           : see insertAccount; inserts serialized
+///  - unlink(root, node)          : see unlinkAccountNode
+///  - forEach(root, visit)        : every node (tombstones included) in
+///                                  account-number order
+///  - rebuild(root, sorted)       : relinks the given nodes only (exclusive)
+///  - bytes(root)                 : memory of the index beyond the nodes
+///
+/// History policy (the history of one account stays an AccountHistory,
+/// read through HistoryView by the queries of history_store.h):
+///  - Store                       : the Bank's shared history storage
+///  - openStore / closeStore
+///  - append(store, history, ...) : see appendHistory
+///
+/// Pending queue policy:
+///  - Queue                       : what the Bank stores
+///  - init / clear / size / bytes
+///  - push(queue, account, type, amount)
+///  - pop(queue, out)             : copies the oldest item out, false if empty
+
+/// Reference account index: the unbalanced BST of account_bst.h.
+struct BstAccountIndex {
+    using Root = std::atomic<AccountNode*>;
+
+    static void init(Root& root) { root.store(nullptr); }
+
+    static bool empty(const Root& root) { return root.load() == nullptr; }
+
+    static AccountNode* find(const Root& root, int accountNumber) {
+        return searchAccount(root.load(), accountNumber);
+    }
+
+    static AccountNode* insert(Root& root,
+                               int accountNumber,
+                               PooledName name,
+                               double initialBalance,
+                               bool& inserted,
+                               std::size_t interestApplied,
+                               double interestFactor) {
+        return insertAccount(root, accountNumber, name, initialBalance, inserted,
+                             interestApplied, interestFactor);
+    }
+
+    static bool unlink(Root& root, AccountNode* node) { return unlinkAccountNode(root, node); }
+
+    template <typename Visit>
+    static void forEach(const Root& root, Visit&& visit) {
+        forEachAccountNode(root.load(), visit);
+    }
+
+    static void rebuild(Root& root, const std::vector<AccountNode*>& sorted) {
+        rebuildBalanced(root, sorted);
+    }
+
+    static void clear(Root& root) { freeAccountTree(root); }
+
+    static std::size_t bytes(const Root&) { return 0; }   // links live in the nodes
+};
+
+/// Radix tree on the account number (account_radix.h): constant-depth
+/// lookups whatever the creation order, no tombstones.
+struct RadixAccountIndex {
+    using Root = RadixTree;
+
+    static void init(Root&) {}   // every page pointer starts out null
+
+    static bool empty(const Root& root) { return radixEmpty(root); }
+
+    static AccountNode* find(const Root& root, int accountNumber) {
+        return radixFind(root, accountNumber);
+    }
+
+    static AccountNode* insert(Root& root,
+                               int accountNumber,
+                               PooledName name,
+                               double initialBalance,
+                               bool& inserted,
+                               std::size_t interestApplied,
+                               double interestFactor) {
+        return radixInsert(root, accountNumber, name, initialBalance, inserted,
+                           interestApplied, interestFactor);
+    }
+
+    static bool unlink(Root& root, AccountNode* node) { return radixUnlink(root, node); }
+
+    template <typename Visit>
+    static void forEach(const Root& root, Visit&& visit) {
+        forEachRadixNode(root, visit);
+    }
+
+    static void rebuild(Root& root, const std::vector<AccountNode*>& sorted) {
+        radixRebuild(root, sorted);
+    }
+
+    static void clear(Root& root) { freeRadixTree(root); }
+
+    static std::size_t bytes(const Root& root) { return radixTreeBytes(root); }
+};
+
+/// Reference history: recent entries in memory, older ones spilled to
+/// the segment file (history_store.h).
+struct TieredHistory {
+    using Store = HistoryStore;
+
+    static bool openStore(Store& store) { return initHistoryStore(store); }
+
+    static void closeStore(Store& store) { closeHistoryStore(store); }
+
+    static void append(Store& store,
+                       AccountHistory& history,
+                       TransactionType type,
+                       double amount,
+                       double balanceAfter,
+                       const std::string& datetime,
+                       int counterparty = 0,
+                       long long transferId = 0) {
+        appendHistory(store, history, type, amount, balanceAfter, datetime,
+                      counterparty, transferId);
+    }
+};
+
+/// Every entry stays in memory (no segment file, so no spills and no
+/// disk reads), for hosts with RAM to spare.
+struct InMemoryHistory : TieredHistory {
+    static bool openStore(Store& store) {
+        store.segment    = nullptr;   // appendHistory only spills with a segment
+        store.segmentEnd = 0;
+        store.freeBlocks.clear();
+        return true;
+    }
+};
+
+/// Reference pending queue: the linked FIFO of pending_queue.h (one heap
+/// node per item).
+struct LinkedPendingQueue {
+    using Queue = PendingQueue;
+
+    static void init(Queue& queue) { initQueue(queue); }
+
+    static void clear(Queue& queue) { freeQueue(queue); }
+
+    static void push(Queue& queue, int accountNumber, TransactionType type, double amount) {
+        enqueue(queue, accountNumber, type, amount);
+    }
+
+    static bool pop(Queue& queue, PendingTransaction& out) {
+        PendingTransaction* node = nullptr;
+        if (!dequeue(queue, node)) {
+            return false;
+        }
+        out = *node;
+        out.next = nullptr;
+        delete node;
+        return true;
+    }
+
+    static std::size_t size(const Queue& queue) {
+        return static_cast<std::size_t>(queueSize(queue));
+    }
+
+    static std::size_t bytes(const Queue& queue) {
+        return size(queue) * sizeof(PendingTransaction);
+    }
+};
+
+/// Items stored by value in a std::deque: one allocation per block of
+/// items instead of per item.
+struct DequePendingQueue {
+    using Queue = std::deque<PendingTransaction>;
+
+    static void init(Queue& queue) { queue.clear(); }
+
+    static void clear(Queue& queue) { Queue().swap(queue); }
+
+    static void push(Queue& queue, int accountNumber, TransactionType type, double amount) {
+        queue.emplace_back(accountNumber, type, amount);
+    }
+
+    static bool pop(Queue& queue, PendingTransaction& out) {
+        if (queue.empty()) {
+            return false;
+        }
+        out = queue.front();
+        queue.pop_front();
+        return true;
+    }
+
+    static std::size_t size(const Queue& queue) { return queue.size(); }
+
+    /// Estimated: libstdc++ packs max(1, 512 / sizeof(item)) items per
+    /// block, keeps one block even when empty, and a map of block pointers.
+    static std::size_t bytes(const Queue& queue) {
+        constexpr std::size_t kItemBytes = sizeof(PendingTransaction);
+        constexpr std::size_t kPerBlock  = kItemBytes < 512 ? 512 / kItemBytes : 1;
+        const std::size_t blocks = queue.size() / kPerBlock + 1;
+        return blocks * (kPerBlock * kItemBytes + sizeof(PendingTransaction*));
+    }
+};
+
+/// Default structures of this build (the policies of Bank), and the
+/// alternative of each kind.
+#ifdef BANK_RADIX_ACCOUNT_INDEX
+using IndexPolicy      = RadixAccountIndex;
+using OtherIndexPolicy = BstAccountIndex;
+#else
+using IndexPolicy      = BstAccountIndex;
+using OtherIndexPolicy = RadixAccountIndex;
+#endif
+
+#ifdef BANK_IN_MEMORY_HISTORY
+using HistoryPolicy      = InMemoryHistory;
+using OtherHistoryPolicy = TieredHistory;
+#else
+using HistoryPolicy      = TieredHistory;
+using OtherHistoryPolicy = InMemoryHistory;
+#endif
+
+#ifdef BANK_DEQUE_PENDING_QUEUE
+using QueuePolicy      = DequePendingQueue;
+using OtherQueuePolicy = LinkedPendingQueue;
+#else
+using QueuePolicy      = LinkedPendingQueue;
+using OtherQueuePolicy = DequePendingQueue;
+#endif
+
+} // namespace bank
+
+#endif // BANK_POLICIES_H
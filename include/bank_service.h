@@ -1,77 +1,638 @@
 #ifndef BANK_SERVICE_H
 #define BANK_SERVICE_H
 
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <vector>
 
 #include "account_bst.h"
+#include "balance_index.h"
+#include "bank_policies.h"
+#include "epoch.h"
+#include "name_index.h"
+#include "history_store.h"
+#include "idempotency.h"
 #include "pending_queue.h"
 #include "transaction_list.h"
 #include "utils.h"
+#include "velocity.h"
 
 namespace bank {
 
+struct AccountVersion;   // snapshot.h
+struct ReadSnapshot;     // snapshot.h
+
+/// One applyInterestAll call, recorded once for the whole bank and
+/// materialized on each account later (see applyInterestAll).
+///
+/// Fields:
+///  - rate     : interest rate (0.01 == +1% of the balance)
+///  - datetime : when it was posted (timestamp of the Interest entries)
+///  - stamp    : commit stamp it became visible at (see snapshot.h)
+///  - factor   : product of (1 + rate) over this and all earlier postings
+struct InterestEpoch {
+    double        rate{};
+    std::string   datetime;
+    std::uint64_t stamp{};
+    double        factor{1.0};
+};
+
+/// Bank-wide totals, maintained incrementally by every change so that
+/// reading them is O(1) (see getAggregates / scanAggregates).
+///
+/// Fields:
+///  - accountCount    : number of accounts
+///  - totalBalance    : sum of all balances, pending interest included
+///  - nonPositiveCount: accounts whose balance is zero or negative
+///  - depositedToday  : sum of the deposits dated today
+struct BankAggregates {
+    long long accountCount{0};
+    double    totalBalance{0.0};
+    long long nonPositiveCount{0};
+    double    depositedToday{0.0};
+};
+
+/// Counters behind BankAggregates, updated under the lock of the account
+/// that changed (never a bank-wide lock, except dayMutex for deposits).
+///
+/// The total is kept "normalized": each balance is divided by the
+/// interestFactor of its account, so an interest posting changes no
+/// counter at all and the real total is normalizedTotal times the bank's
+/// current interest factor.
+///
+/// Fields:
+///  - accountCount    : see BankAggregates
+///  - normalizedTotal : sum of balance / interestFactor over all accounts
+///  - nonPositiveCount: see BankAggregates
+///  - dayMutex        : guards day and depositedToday
+///  - day             : date (YYYYMMDD) depositedToday belongs to
+///  - depositedToday  : sum of the deposits dated `day`
+struct AggregateCounters {
+    std::atomic<long long> accountCount{0};
+    std::atomic<double>    normalizedTotal{0.0};
+    std::atomic<long long> nonPositiveCount{0};
+    mutable std::mutex     dayMutex;
+    long long              day{0};
+    double                 depositedToday{0.0};
+};
+
 /// Aggregates all core data structures for the banking system.
-struct Bank {
-    AccountNode*   accountsRoot{nullptr};  // BST of accounts
-    PendingQueue   pendingQueue;           // queue of pending txns
+///
+/// Thread safety: every service function below may be called from many
+/// threads at once, except initBank, destroyBank and loadBankFromFiles.
+///  - account lookups and traversals take no lock (atomic tree links)
+///  - balance/history changes lock only the accounts involved, so
+///    operations on different accounts run fully in parallel, and end
+///    by publishing a new version of those accounts (see snapshot.h)
+///  - printing, queries and saving read one ReadSnapshot: a consistent
+///    view of all accounts that takes no lock and never blocks writers
+///  - creating an account serializes with other creations only
+///  - the pending queue has its own lock
+///  - interest postings are appended under interestMutex (exclusive);
+///    materializing them on an account reads them under it (shared)
+///  - the aggregates are atomics updated along with each account change,
+///    the balance index has locked stripes (taken under the account lock)
+///  - the name index has its own reader/writer lock
+///  - closing an account serializes with creations (insertMutex) and
+///    locks the account, but holds neither while it writes the archive;
+///    lookups and writers run pinned (ReadSnapshot) so a closed node is
+///    only freed once none of them can stand on it
+///  - compactBank needs the bank to itself, like loadBankFromFiles
+///  - the velocity rules are an immutable set swapped atomically; the
+///    windows of an account are updated under its lock
+///  - the idempotency cache has locked stripes of its own
+///
+/// The account index, the history storage and the pending queue are the
+/// structures of the policies the bank is instantiated with (see
+/// bank_policies.h), named Index, History and Queue; the service layer
+/// only uses them through those, and every function below is a template
+/// on the bank type. Bank is the combination of this build.
+template <typename IndexP, typename HistoryP, typename QueueP>
+struct BasicBank {
+    using Index   = IndexP;
+    using History = HistoryP;
+    using Queue   = QueueP;
+
+    typename Index::Root    accountsRoot{};   // account index (BST or radix tree)
+    typename Queue::Queue   pendingQueue;     // queue of pending txns
+    typename History::Store historyStore;     // shared storage of the histories
+    std::atomic<long long> nextTransferId{1}; // id linking both transfer halves
+    std::mutex     insertMutex;            // serializes account creation
+    std::mutex     queueMutex;             // guards pendingQueue
+    mutable EpochManager epochs;           // commit stamps + reclamation; mutable: readers pin too
+    std::vector<InterestEpoch> interestEpochs;         // every interest posting, oldest first
+    std::atomic<std::size_t>   interestEpochCount{0};  // interestEpochs.size(), readable without the lock
+    mutable std::shared_mutex  interestMutex;          // guards interestEpochs
+    std::atomic<double>        interestFactor{1.0};    // factor of the newest posting (1 if none)
+    AggregateCounters aggregates;          // running bank-wide totals
+    BalanceIndex   balanceIndex;           // accounts ordered by (normalized) balance
+    NameIndex      nameIndex;              // accounts by (case-folded) holder name
+    NamePool       namePool;               // holder names, each stored once
+    std::atomic<std::size_t> tombstoneCount{0}; // closed nodes still linked (see compactBank)
+    std::atomic<const VelocityRuleSet*> velocityRules{nullptr}; // withdrawal limits (nullptr: none)
+    std::atomic<std::uint64_t> velocityGeneration{0};           // number of the last rule set
+    IdempotencyCache idempotency;          // outcomes of recent keyed requests
+};
+
+/// The bank of this build: the default policies of bank_policies.h.
+using Bank = BasicBank<IndexPolicy, HistoryPolicy, QueuePolicy>;
+
+/// Bank with one policy swapped for the other structure of its kind.
+using BankWithOtherIndex   = BasicBank<OtherIndexPolicy, HistoryPolicy, QueuePolicy>;
+using BankWithOtherHistory = BasicBank<IndexPolicy, OtherHistoryPolicy, QueuePolicy>;
+using BankWithOtherQueue   = BasicBank<IndexPolicy, HistoryPolicy, OtherQueuePolicy>;
+
+/// Calls INSTANTIATE(B) for every bank type the service layer is built
+/// for. The functions taking a bank are templates on it, defined in the
+/// .cpp files and explicitly instantiated there through this list, so a
+/// bank type missing from it fails at link time.
+#define BANK_FOR_EACH_BANK_TYPE(INSTANTIATE) \
+    INSTANTIATE(Bank)                        \
+    INSTANTIATE(BankWithOtherIndex)          \
+    INSTANTIATE(BankWithOtherHistory)        \
+    INSTANTIATE(BankWithOtherQueue)
+
+/// Outcome of a single deposit / withdrawal.
+enum class OperationStatus {
+    Ok,
+    InvalidAmount,         // amount <= 0
+    AccountNotFound,
+    InsufficientFunds,
+    InvalidType,           // only Deposit / Withdraw are accepted
+    SameAccount,           // transfer source and destination are equal
+    ArchiveFailed,         // closing: the archive files could not be written
+    InvalidAccountNumber,  // creating: account number <= 0
+    DuplicateAccount,      // creating: the account number is already used
+    VelocityLimitExceeded, // withdrawing: a velocity rule would be exceeded
+    RequestInProgress,     // keyed request: the first attempt is still running
+    IdempotencyKeyReused,  // keyed request: the key was used for another request
+    TransferSuspended,     // sharded transfer: neither delivered nor refunded (see shardedSuspense)
+    Count                  // number of statuses above (not a status; keep it last)
 };
 
-/// Initializes the Bank: empty BST + empty queue.
-void initBank(Bank& bank);
+/// Short lower-case name of a status ("ok", "not_found", ...).
+const char* operationStatusName(OperationStatus status);
 
-/// Frees all accounts (and their histories) and all pending transactions.
-void destroyBank(Bank& bank);
+/// One deposit or withdrawal inside a batch.
+struct BatchOperation {
+    int             accountNumber{};
+    TransactionType type{TransactionType::Deposit};
+    double          amount{};
+};
+
+/// Initializes the Bank: empty BST + empty queue + history segment file.
+template <typename BankT>
+void initBank(BankT& bank);
+
+/// Frees all accounts (with their histories and versions), all pending
+/// transactions and everything still waiting for reclamation.
+template <typename BankT>
+void destroyBank(BankT& bank);
 
 /// Creates a new account if the accountNumber is not already used.
-/// @return true if inserted, false if duplicate.
-bool createAccount(Bank& bank,
+/// Prints nothing.
+/// @return Ok, InvalidAccountNumber (<= 0), InvalidAmount (negative
+///         initial balance) or DuplicateAccount.
+template <typename BankT>
+OperationStatus addAccount(BankT& bank,
+                           int accountNumber,
+                           const std::string& holderName,
+                           double initialBalance);
+
+/// Creates a new account (see addAccount) and prints why if it cannot.
+/// @return true if inserted, false if invalid or duplicate.
+template <typename BankT>
+bool createAccount(BankT& bank,
                    int accountNumber,
                    const std::string& holderName,
                    double initialBalance);
 
+/// Applies a batch of deposits / withdrawals without printing anything.
+///
+/// Operations are grouped by account (operations on the same account keep
+/// their relative order), so each account is looked up once, and the whole
+/// batch shares one timestamp.
+///
+/// @param ops   Pointer to the first operation.
+/// @param count Number of operations.
+/// @return One status per operation, in the same order as `ops`.
+template <typename BankT>
+std::vector<OperationStatus> applyBatch(BankT& bank,
+                                        const BatchOperation* ops,
+                                        std::size_t count);
+
+/// Convenience overload for a whole vector of operations.
+template <typename BankT>
+std::vector<OperationStatus> applyBatch(BankT& bank,
+                                        const std::vector<BatchOperation>& ops);
+
+/// Runs `apply` once per idempotency key (see idempotency.h): the first
+/// request with `key` runs it and its status is remembered; a retry with
+/// the same key returns that status in O(1) without running it again
+/// (RequestInProgress while the first one has not finished). A request
+/// whose `fingerprint` (see requestFingerprint) differs from the first
+/// one's is not run and gets IdempotencyKeyReused. If `apply` throws,
+/// the key is released so a retry runs it. An empty key always runs it.
+template <typename BankT>
+OperationStatus runIdempotent(BankT& bank,
+                              const std::string& key,
+                              std::uint64_t fingerprint,
+                              const std::function<OperationStatus()>& apply);
+
+/// Bounds the idempotency cache: at most `capacity` keys, each kept for
+/// `ttlSeconds` (least recently used ones are evicted first).
+template <typename BankT>
+void configureIdempotency(BankT& bank, std::size_t capacity, long long ttlSeconds);
+
 /// Performs a direct deposit on an existing account.
-/// Adds a transaction with current datetime.
+/// Adds a transaction with current datetime (single-operation applyBatch).
+/// With an idempotency key, a retry prints and returns the first outcome
+/// without depositing again (see runIdempotent).
 /// @return true on success, false if account not found or amount invalid.
-bool depositDirect(Bank& bank,
+template <typename BankT>
+bool depositDirect(BankT& bank,
                    int accountNumber,
-                   double amount);
+                   double amount,
+                   const std::string& idempotencyKey = {});
 
 /// Performs a direct withdrawal on an existing account.
-/// Adds a transaction with current datetime if successful.
-/// @return true on success, false if account not found / invalid amount / insufficient funds.
-bool withdrawDirect(Bank& bank,
+/// Adds a transaction with current datetime if successful (single-operation applyBatch).
+/// Idempotency key: see depositDirect.
+/// @return true on success, false if account not found / invalid amount /
+///         insufficient funds / velocity limit exceeded.
+template <typename BankT>
+bool withdrawDirect(BankT& bank,
                     int accountNumber,
+                    double amount,
+                    const std::string& idempotencyKey = {});
+
+/// Moves `amount` from one account to another as a single unit.
+///
+/// Both accounts are locked (smaller account number first, so concurrent
+/// transfers cannot deadlock), the sender is debited and the receiver
+/// credited together, and linked TransferOut / TransferIn entries with a
+/// shared transfer id are added to both histories. The sender's velocity
+/// limits apply (VelocityLimitExceeded, see setVelocityRules). Prints
+/// nothing.
+///
+/// @param transferId Id to record, or 0 to take the next one from the bank.
+template <typename BankT>
+OperationStatus transferFunds(BankT& bank,
+                              int fromAccount,
+                              int toAccount,
+                              double amount,
+                              long long transferId = 0);
+
+/// Sending half of a transfer to an account held by another Bank (see
+/// sharded_bank.h): debits `fromAccount` and records the TransferOut
+/// entry, within its velocity limits. Prints nothing.
+template <typename BankT>
+OperationStatus sendTransfer(BankT& bank,
+                             int fromAccount,
+                             int toAccount,
+                             double amount,
+                             long long transferId,
+                             const std::string& datetime);
+
+/// Receiving half of a transfer from another Bank: credits `toAccount`
+/// and records the TransferIn entry. Prints nothing.
+template <typename BankT>
+OperationStatus receiveTransfer(BankT& bank,
+                                int toAccount,
+                                int fromAccount,
+                                double amount,
+                                long long transferId,
+                                const std::string& datetime);
+
+/// Performs a transfer (see transferFunds) and prints the outcome.
+/// @return true on success, false otherwise.
+template <typename BankT>
+bool transferDirect(BankT& bank,
+                    int fromAccount,
+                    int toAccount,
                     double amount);
 
 /// Adds a transaction to the pending queue (to be processed later).
-/// Validates amount > 0 and that the account exists.
+/// Validates amount > 0, that the account exists and that the type is
+/// Deposit or Withdraw. With an idempotency key, a retry is not queued
+/// again and gets the first outcome (see runIdempotent). Prints nothing.
+template <typename BankT>
+OperationStatus queuePendingTransaction(BankT& bank,
+                                        int accountNumber,
+                                        TransactionType type,
+                                        double amount,
+                                        const std::string& idempotencyKey = {});
+
+/// Adds a transaction to the pending queue (see queuePendingTransaction)
+/// and prints the outcome.
 /// @return true if enqueued, false if validation fails.
-bool enqueuePendingTransaction(Bank& bank,
+template <typename BankT>
+bool enqueuePendingTransaction(BankT& bank,
                                int accountNumber,
                                TransactionType type,
-                               double amount);
+                               double amount,
+                               const std::string& idempotencyKey = {});
+
+/// Closes an account: appends it and its whole history to the archive
+/// files (see appendClosedAccount), removes it from the aggregates and
+/// both indexes and releases its memory.
+///
+/// Interest posted before the closure is materialized first, so the
+/// archived balance is final. The history (hot nodes, block index and
+/// the slots of its cold blocks in the segment file) and the node itself
+/// are freed once no snapshot taken before the closure is left. A node
+/// with two children stays in the tree as a tombstone until compactBank.
+/// Snapshots taken before the closure still see the account. Its number
+/// may be used again for a new account. Prints nothing.
+///
+/// The archive is written with no lock held. The account is marked
+/// closing first: from then on, deposits, withdrawals and transfers on it
+/// get AccountNotFound, and creating its number is still refused. If the
+/// archive fails, the mark is cleared and the account stays open.
+template <typename BankT>
+OperationStatus closeAccount(BankT& bank,
+                             int accountNumber,
+                             const std::string& accountsArchive,
+                             const std::string& transactionsArchive);
 
-/// Processes all pending transactions in FIFO order.
+/// Closes an account (see closeAccount) and prints the outcome.
+/// @return true on success, false otherwise.
+template <typename BankT>
+bool closeAccountDirect(BankT& bank,
+                        int accountNumber,
+                        const std::string& accountsArchive,
+                        const std::string& transactionsArchive);
+
+/// What one compactBank pass released.
+///
+/// Fields:
+///  - tombstonesFreed   : closed nodes removed from the tree
+///  - nameBytesReleased : name pool memory given back
+struct CompactionResult {
+    std::size_t tombstonesFreed{0};
+    std::size_t nameBytesReleased{0};
+};
+
+/// Removes what closed accounts left behind: rebuilds the account tree
+/// from its open accounts as a balanced tree (dropping every tombstone),
+/// drops the name index tombstones and rebuilds the name pool without
+/// the names of closed accounts, then frees whatever retired memory no
+/// reader needs any more.
+///
+/// Must not run concurrently with anything else on the bank (like
+/// loadBankFromFiles).
+template <typename BankT>
+CompactionResult compactBank(BankT& bank);
+
+/// True once enough tombstones piled up for compactBank to be worth it
+/// (at least 1024, and at least 1/8 of the open accounts).
+template <typename BankT>
+bool compactionDue(const BankT& bank);
+
+/// Outcome of one pass over the pending queue.
+///
+/// Fields:
+///  - applied : items applied to their account
+///  - skipped : items dropped (account not found, insufficient funds)
+struct QueueRunSummary {
+    std::size_t applied{0};
+    std::size_t skipped{0};
+};
+
+/// Processes all pending transactions in FIFO order without printing.
 /// For each successful operation, updates balance and adds a history record.
-void processPendingQueue(Bank& bank);
+/// Items are taken off the queue in chunks (one queue lock and one trace
+/// span per phase for each); the items of a chunk share one timestamp.
+template <typename BankT>
+QueueRunSummary applyPendingQueue(BankT& bank);
+
+/// Processes all pending transactions (see applyPendingQueue) and prints
+/// the outcome of each.
+template <typename BankT>
+void processPendingQueue(BankT& bank);
 
-/// Prints a summary of all accounts (in-order traversal of BST).
-void printAllAccounts(const Bank& bank);
+/// Replaces the bank's velocity rules (see velocity.h); an empty list
+/// removes every limit. Every withdrawal (direct, batch or queued) and
+/// every outgoing transfer (sendTransfer included) is checked against
+/// them, in O(1) per rule, and fails with VelocityLimitExceeded if one
+/// would be exceeded. Under the new rules each account's windows are
+/// rebuilt from its history on its next withdrawal, so what it already
+/// withdrew still counts.
+/// @return false if there are more than kMaxVelocityRules rules or one
+///         has windowSeconds <= 0, a negative limit or no limit at all.
+template <typename BankT>
+bool setVelocityRules(BankT& bank, const std::vector<VelocityRule>& rules);
+
+/// The rules set by setVelocityRules (empty if none).
+template <typename BankT>
+std::vector<VelocityRule> getVelocityRules(const BankT& bank);
+
+/// Prints a summary of all accounts (in-order traversal of BST), all as
+/// of the same moment.
+template <typename BankT>
+void printAllAccounts(const BankT& bank);
+
+/// Account numbers of the accounts whose holder name matches `query`
+/// (see NameMatch), in name order, at most `limit`. Uses the name index:
+/// two binary searches plus the matches, no traversal.
+template <typename BankT>
+std::vector<int> findAccountsByName(const BankT& bank,
+                                    const std::string& query,
+                                    NameMatch how,
+                                    std::size_t limit = std::numeric_limits<std::size_t>::max());
+
+/// Prints a summary of every account whose holder name matches `query`.
+/// @return true if at least one account matched.
+template <typename BankT>
+bool printAccountsByName(const BankT& bank,
+                         const std::string& query,
+                         NameMatch how);
 
 /// Prints a single account summary by number.
+///
+/// Like every single-account read below, this first materializes any
+/// interest posted since the account was last touched.
 /// @return true if found and printed, false if not found.
-bool printAccountByNumber(const Bank& bank,
+template <typename BankT>
+bool printAccountByNumber(BankT& bank,
                           int accountNumber);
 
 /// Prints full transaction history for a given account.
+/// Older entries are read back from the segment file lazily.
 /// @return true if account found, false otherwise.
-bool printAccountHistory(const Bank& bank,
+template <typename BankT>
+bool printAccountHistory(BankT& bank,
                          int accountNumber);
 
+/// Number of history entries shown per page by the paged printers.
+constexpr int kHistoryPageSize = 20;
+
+/// Fetches one page of an account's transactions dated in [from, to].
+/// Dates may be partial ("2025-01-31"); see toTimeKey.
+/// Uses binary search over the history's time index, no full scan.
+/// @return true if the account was found and the page read, false otherwise.
+template <typename BankT>
+bool queryAccountHistoryByTime(BankT& bank,
+                               int accountNumber,
+                               const std::string& from,
+                               const std::string& to,
+                               long long pageOffset,
+                               int pageSize,
+                               HistoryPage& out);
+
+/// Fetches one page of the last `count` transactions of an account.
+/// @return true if the account was found and the page read, false otherwise.
+template <typename BankT>
+bool queryRecentAccountHistory(BankT& bank,
+                               int accountNumber,
+                               long long count,
+                               long long pageOffset,
+                               int pageSize,
+                               HistoryPage& out);
+
+/// Prints page `page` (1-based) of an account's transactions in [from, to].
+/// @return true if account found, false otherwise.
+template <typename BankT>
+bool printAccountHistoryRange(BankT& bank,
+                              int accountNumber,
+                              const std::string& from,
+                              const std::string& to,
+                              int page);
+
+/// Prints page `page` (1-based) of the last `count` transactions of an account.
+/// @return true if account found, false otherwise.
+template <typename BankT>
+bool printRecentHistory(BankT& bank,
+                        int accountNumber,
+                        int count,
+                        int page);
+
+/// Balance of one account at a point in time (see balancesAsOf).
+struct AccountBalance {
+    int    accountNumber{};
+    double balance{};
+};
+
+/// Looks up an account's balance as of `datetime` (may be a partial date;
+/// a bare date means the end of that day). Before the first transaction
+/// this is the opening balance. O(log n) via the history checkpoints.
+/// @return true if the account was found, false otherwise.
+template <typename BankT>
+bool getBalanceAsOf(BankT& bank,
+                    int accountNumber,
+                    const std::string& datetime,
+                    double& out);
+
+/// Balances of all accounts as of `datetime`, in account-number order,
+/// computed in a single traversal of the account tree over one snapshot.
+/// Interest not yet materialized is included without materializing it.
+template <typename BankT>
+std::vector<AccountBalance> balancesAsOf(const BankT& bank,
+                                         const std::string& datetime);
+
+/// Prints one account's balance as of `datetime`.
+/// @return true if account found, false otherwise.
+template <typename BankT>
+bool printBalanceAsOf(BankT& bank,
+                      int accountNumber,
+                      const std::string& datetime);
+
+/// Prints every account's balance as of `datetime`.
+template <typename BankT>
+void printAllBalancesAsOf(const BankT& bank,
+                          const std::string& datetime);
+
+/// The `n` accounts with the highest balance, highest first.
+/// O(log n + n) via the balance index instead of a traversal and a sort.
+/// Balances include pending interest and come from one snapshot, and the
+/// result is ordered by them (ties by account number). Accounts created
+/// after the snapshot do not count towards `n`.
+template <typename BankT>
+std::vector<AccountBalance> topBalances(const BankT& bank, std::size_t n);
+
+/// Accounts with low <= balance <= high, lowest balance first (as of one
+/// snapshot, like topBalances). O(log n + k) via the balance index.
+template <typename BankT>
+std::vector<AccountBalance> accountsWithBalanceBetween(const BankT& bank,
+                                                       double low,
+                                                       double high);
+
+/// Accounts with balance < limit (e.g. under a minimum balance), lowest
+/// balance first (as of one snapshot). O(log n + k) via the balance index.
+template <typename BankT>
+std::vector<AccountBalance> accountsBelowBalance(const BankT& bank, double limit);
+
+/// Prints the accounts with low <= balance <= high.
+template <typename BankT>
+void printBalanceRange(const BankT& bank, double low, double high);
+
 /// Interest feature: apply a simple interest rate to all accounts.
 /// Example: rate = 0.01 means +1% of current balance.
-/// A transaction of type Interest is added for each account.
-void applyInterestAll(Bank& bank, double rate);
+///
+/// O(1): the rate is only recorded as a new InterestEpoch. Each account
+/// catches up on the postings it missed the next time it is changed or
+/// read on its own, or during sweepInterest. Catching up applies them
+/// in order exactly as an immediate walk would have (same balances, and
+/// an Interest entry dated at the posting for each non-zero amount).
+/// Reports over all accounts include pending interest on the fly.
+template <typename BankT>
+void applyInterestAll(BankT& bank, double rate);
+
+/// Records an interest posting (see applyInterestAll) without printing.
+/// @return false if rate <= 0.
+template <typename BankT>
+bool postInterest(BankT& bank, double rate);
+
+/// Materializes all pending interest on every account (background sweep).
+/// @return number of accounts that had pending interest.
+template <typename BankT>
+std::size_t sweepInterest(BankT& bank);
+
+/// Bank-wide totals as maintained by the service layer. O(1), no lock
+/// except a brief one for the daily deposit sum. Under concurrent
+/// writers the fields may come from slightly different moments.
+template <typename BankT>
+BankAggregates getAggregates(const BankT& bank);
+
+/// Recomputes the aggregates from scratch with a full scan of one
+/// snapshot (today's deposits via the time index of each history).
+template <typename BankT>
+BankAggregates scanAggregates(const BankT& bank);
+
+/// Compares the maintained aggregates with a full scan and prints every
+/// field that drifted. Only exact while no writer is running.
+/// @return true if all fields agree.
+template <typename BankT>
+bool verifyAggregates(const BankT& bank);
+
+/// Replaces the maintained aggregates by a full scan (used after loading).
+/// Must not run concurrently with writers.
+template <typename BankT>
+void resetAggregates(BankT& bank);
+
+/// Prints the maintained aggregates.
+template <typename BankT>
+void printAggregates(const BankT& bank);
+
+/// Called for each pending interest posting by balanceWithPendingInterest
+/// with the posting, the interest amount and the balance after it.
+using PendingInterestVisitor =
+    std::function<void(const InterestEpoch& epoch, double interest, double balanceAfter)>;
+
+/// Balance of `version` plus the interest postings visible in `snapshot`
+/// that are not materialized on it yet, applied in order. `visit` (if
+/// set) sees each posting whose interest is non-zero, i.e. each Interest
+/// entry eager application would have added.
+template <typename BankT>
+double balanceWithPendingInterest(const BankT& bank,
+                                  const ReadSnapshot& snapshot,
+                                  const AccountVersion& version,
+                                  const PendingInterestVisitor& visit = {});
 
 } // namespace bank
 
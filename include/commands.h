@@ -0,0 +1,80 @@
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+#include <iosfwd>
+#include <string>
+
+#include "bank_service.h"
+#include "sharded_bank.h"
+
+namespace bank {
+
+/// Line-oriented command language for driving a Bank without the menu
+/// (batch files, scripted jobs).
+///
+/// One command per line, words separated by blanks; empty lines and
+/// lines starting with '#' are ignored:
+///   create   <account> <initialBalance> <holder name...>
+///   deposit  <account> <amount>
+///   withdraw <account> <amount>
+///   transfer <from> <to> <amount>
+///   enqueue  <account> deposit|withdraw <amount>
+///   id       <key> <deposit|withdraw|transfer|enqueue command>
+///                               (applied once per key; a retry gets the
+///                                first result, see runIdempotent)
+///   idempotency <capacity> <ttlSeconds>   (bounds of the key cache)
+///   process                     (runs the pending queue)
+///   interest <rate>
+///   balance  <account>
+///   close    <account> [accountsArchive transactionsArchive]
+///                               (then compactBank, once compactionDue)
+///   save     [accountsFile transactionsFile]
+///   stats    [reset]            (counters and memory as JSON, see stats.h)
+///   memory                      (memory usage as JSON, see memory_usage.h)
+///   limit    [add <windowSeconds> <maxAmount> <maxCount> | clear]
+///                               (velocity rules, see velocity.h; 0 = no
+///                                limit; without arguments lists them)
+///   trace    <file>             (Chrome trace of the spans, see trace.h)
+///
+/// Each command yields one compact result line:
+///   "ok", "ok <value>" (balance, process, stats, memory, limit) or "error <reason>", where
+///   reason is a status name (see operationStatusName) or "bad_command".
+
+/// Runs a single command line and returns its result line (without
+/// '\n'). Returns an empty string for blank and comment lines. Nothing
+/// else may use the bank meanwhile (close may compact it).
+std::string executeCommand(Bank& bank, const std::string& line);
+
+/// Counts of one runBatch call.
+///
+/// Fields:
+///  - commands : commands executed (blank and comment lines excluded)
+///  - failed   : commands whose result was an error
+struct BatchSummary {
+    long long commands{0};
+    long long failed{0};
+};
+
+/// Runs every command read from `in` and writes "<line> <result>" to
+/// `out` for each, in input order, without prompts or pauses.
+///
+/// Runs of consecutive deposit / withdraw commands are applied together
+/// through applyBatch (one lookup per account and one timestamp per
+/// run); each still gets its own result line.
+BatchSummary runBatch(Bank& bank, std::istream& in, std::ostream& out);
+
+/// Runs one command line against a ShardedBank (see sharded_bank.h).
+/// Accepts create, deposit, withdraw, transfer (across shards too),
+/// enqueue, process (every shard's queue, in parallel), interest,
+/// balance, close, save (one file pair per shard, see shardFileName) and
+/// "suspense" ("ok <count>" of the transfers that
+/// could not be delivered nor refunded); anything else is a bad command.
+std::string executeShardedCommand(ShardedBank& sharded, const std::string& line);
+
+/// runBatch for a ShardedBank: runs of deposits / withdrawals go through
+/// shardedApplyBatch, every shard working on its part in parallel.
+BatchSummary runShardedBatch(ShardedBank& sharded, std::istream& in, std::ostream& out);
+
+} // namespace bank
+
+#endif // COMMANDS_H
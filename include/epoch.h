@@ -0,0 +1,92 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace bank {
+
+/// Commit stamps, reader registration and deferred freeing for the
+/// multi-version (MVCC) read path.
+///
+/// Writers publish every change under a commit stamp. Stamps are handed
+/// out in order and become visible strictly in order, so "all commits up
+/// to visibleStamp" is always a consistent state of the bank. Only the
+/// few instructions that publish a commit are serialized (commitMutex);
+/// the changes themselves run in parallel under the account locks.
+///
+/// Readers pin the current visibleStamp in a slot for as long as they
+/// read. Memory that writers unlink (old versions, spilled history
+/// nodes, ...) is retired instead of deleted and only freed once every
+/// pinned reader started after it was retired (epoch-based reclamation).
+/// Writers never wait for readers.
+
+/// Registration of one reader. Slots are never freed, only reused.
+struct ReaderSlot {
+    std::atomic<std::uint64_t> pinnedStamp{0};   // kIdleStamp when unused
+    std::atomic<bool>          inUse{false};
+    ReaderSlot*                next{nullptr};
+};
+
+/// Object waiting to be freed.
+struct RetiredObject {
+    void*         ptr{nullptr};
+    void        (*deleter)(void*){nullptr};
+    std::uint64_t retireStamp{0};
+};
+
+/// Number of independently locked retire lists (spreads writer contention).
+constexpr int kRetireShards = 16;
+
+/// One retire list and its lock. A reclaim pass runs once the list
+/// reaches reclaimAt entries; the threshold grows with what a pass had to
+/// keep, so a long-running reader does not make every retire O(n).
+struct RetireShard {
+    std::mutex                 mutex;
+    std::vector<RetiredObject> objects;
+    std::size_t                reclaimAt{256};
+};
+
+/// Shared state of the MVCC machinery, owned by the Bank.
+struct EpochManager {
+    std::mutex                 commitMutex;   // held from beginCommit to endCommit
+    std::atomic<std::uint64_t> nextStamp{1};
+    std::atomic<std::uint64_t> visibleStamp{0};
+    std::atomic<ReaderSlot*>   readers{nullptr};
+    RetireShard                retired[kRetireShards];
+};
+
+/// Takes the next commit stamp. Call after all locks of the commit are
+/// held, and keep the work until endCommit to publishing pointers: other
+/// commits wait (blocked, not spinning) until then.
+std::uint64_t beginCommit(EpochManager& epochs);
+
+/// Makes `stamp` visible to new readers and lets the next commit start.
+void endCommit(EpochManager& epochs, std::uint64_t stamp);
+
+/// Registers a reader and pins the current visible stamp.
+/// @return the slot to pass to unpinReader; slot->pinnedStamp is the snapshot.
+ReaderSlot* pinReader(EpochManager& epochs);
+
+/// Ends a read started with pinReader.
+void unpinReader(ReaderSlot* slot);
+
+/// Oldest stamp any reader still has pinned (visibleStamp if none).
+std::uint64_t oldestPinnedStamp(const EpochManager& epochs);
+
+/// Defers `deleter(ptr)` until no reader can still reach `ptr`.
+/// The object must already be unlinked from everything readers can find.
+void retire(EpochManager& epochs, void* ptr, void (*deleter)(void*));
+
+/// Frees retired objects that no pinned reader can reach any more.
+void reclaim(EpochManager& epochs);
+
+/// Frees everything still retired and all reader slots.
+/// Only call once no reader or writer uses the manager.
+void destroyEpochManager(EpochManager& epochs);
+
+} // namespace bank
+
+#endif // EPOCH_H
@@ -0,0 +1,279 @@
+#ifndef HISTORY_STORE_H
+#define HISTORY_STORE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "transaction_list.h"
+
+namespace bank {
+
+/// Default number of most recent transactions kept in memory per account.
+constexpr int kDefaultHotHistoryLimit = 64;
+
+/// Default number of transactions written to disk as one cold block.
+constexpr int kDefaultColdBlockSize = 32;
+
+/// Location of one spilled block of transactions in the segment file.
+///
+/// Fields:
+///  - offset     : byte offset of the block's first record in the file
+///  - firstIndex : position of the block's first entry in the history
+///  - count      : number of records in the block
+///  - firstTime  : time key (see toTimeKey) of the block's oldest entry
+///  - lastTime   : time key of the block's newest entry
+///  - closingBalance : balance after the block's newest entry
+///
+/// Since history is appended in time order, the blocks of one account
+/// form a sorted time index that can be binary searched. Together with
+/// closingBalance they act as sparse balance checkpoints.
+struct ColdBlock {
+    std::int64_t offset{};
+    long long    firstIndex{};
+    int          count{};
+    long long    firstTime{};
+    long long    lastTime{};
+    double       closingBalance{};
+};
+
+/// Memory that a spill unlinked from an AccountHistory.
+///
+/// Readers holding an older HistoryView may still be walking it, so a
+/// spill does not free it; the owner collects it with takeHistoryGarbage
+/// and frees it (freeHistoryGarbage) once no such reader is left.
+///
+/// Fields:
+///  - spilled      : first of the spilledCount hot nodes moved to disk
+///                   (the last one still links into the live list, so
+///                   the run is freed by count, not up to nullptr)
+///  - spilledCount : number of nodes in the run
+///  - oldBlocks    : block array replaced because it had to grow
+struct HistoryGarbage {
+    Transaction* spilled{nullptr};
+    int          spilledCount{0};
+    ColdBlock*   oldBlocks{nullptr};
+};
+
+/// Transaction history of one account, split into two tiers:
+///  - hot  : the most recent entries, a linked list kept in memory
+///  - cold : older entries, spilled to the shared segment file in blocks
+///
+/// Entries are numbered 0..size-1 in the order they were appended.
+/// All cold entries come before all hot entries.
+///
+/// Nothing a reader can reach is changed in place: hot nodes are only
+/// appended, blocks[0..blockCount) are never rewritten, and spilled nodes
+/// or an outgrown block array go to `garbage` instead of being freed.
+/// That is what lets a HistoryView taken earlier stay readable.
+struct AccountHistory {
+    Transaction* head{nullptr};   // oldest entry still in memory
+    Transaction* tail{nullptr};   // newest entry
+    int          hotCount{0};
+    long long    coldCount{0};
+    ColdBlock*   blocks{nullptr}; // cold block index, oldest first
+    long long    blockCount{0};
+    long long    blockCapacity{0};
+    std::vector<HistoryGarbage> garbage;
+};
+
+/// Read-only view of a history as it was when the view was taken.
+///
+/// A view stays valid while the history grows, as long as the garbage
+/// produced after it was taken is not freed yet (see snapshot.h).
+///
+/// Fields:
+///  - blocks     : cold block index ([0, blockCount) are valid)
+///  - coldCount  : number of cold entries
+///  - head       : oldest hot entry (size - coldCount hot entries follow)
+///  - size       : total number of entries
+struct HistoryView {
+    const ColdBlock*   blocks{nullptr};
+    long long          blockCount{0};
+    long long          coldCount{0};
+    const Transaction* head{nullptr};
+    long long          size{0};
+};
+
+/// Shared on-disk storage for the cold blocks of every account.
+///
+/// Blocks are written to an anonymous temporary file that lives as long
+/// as the store. The CSV files stay the durable copy of the history; the
+/// segment file only keeps old entries out of RAM while the program runs.
+/// Every block holds exactly blockSize records, so the slot of a block
+/// released by a closed account can be reused by the next spill.
+///
+/// Fields:
+///  - segment    : temporary file holding the cold blocks (nullptr if
+///                 it could not be created; then everything stays hot)
+///  - segmentEnd : byte offset where the next new block will be written
+///  - freeBlocks : offsets of released block slots, reused before the
+///                 file is grown
+///  - hotLimit   : max entries kept in memory per account
+///  - blockSize  : entries moved to disk per spill
+///  - ioMutex    : serializes seek+read/write on the shared file, since
+///                 different accounts may spill or read at the same time
+///                 (also guards segmentEnd and freeBlocks)
+struct HistoryStore {
+    std::FILE*   segment{nullptr};
+    std::int64_t segmentEnd{0};
+    std::vector<std::int64_t> freeBlocks;
+    int          hotLimit{kDefaultHotHistoryLimit};
+    int          blockSize{kDefaultColdBlockSize};
+    mutable std::mutex ioMutex;
+};
+
+/// Called for each history entry, oldest first.
+using HistoryVisitor = std::function<void(long long index, const Transaction& tx)>;
+
+/// One page of a history query.
+///
+/// Fields:
+///  - firstIndex   : history index of entries[0]
+///  - totalMatches : number of entries matching the whole query
+///  - entries      : copies of the entries on this page (next == nullptr)
+struct HistoryPage {
+    long long firstIndex{0};
+    long long totalMatches{0};
+    std::vector<Transaction> entries;
+};
+
+/// Opens the segment file and sets the tier sizes.
+///
+/// @return true if the segment file is available, false if the store
+///         falls back to keeping every entry in memory.
+bool initHistoryStore(HistoryStore& store,
+                      int hotLimit = kDefaultHotHistoryLimit,
+                      int blockSize = kDefaultColdBlockSize);
+
+/// Closes (and thereby deletes) the segment file.
+void closeHistoryStore(HistoryStore& store);
+
+/// Appends a transaction to the end of an account history in O(1).
+/// `balanceAfter` is the account balance once the transaction is applied;
+/// `counterparty` and `transferId` link the two halves of a transfer.
+///
+/// When the hot list grows past store.hotLimit, its oldest
+/// store.blockSize entries are written to the segment file as one
+/// block and their nodes are moved to history.garbage.
+void appendHistory(HistoryStore& store,
+                   AccountHistory& history,
+                   TransactionType type,
+                   double amount,
+                   double balanceAfter,
+                   const std::string& datetime,
+                   int counterparty = 0,
+                   long long transferId = 0);
+
+/// Total number of entries (cold + hot) in the history.
+long long historySize(const AccountHistory& history);
+
+/// Takes a view of the history's current state.
+/// The caller must keep the history from changing meanwhile (account lock).
+HistoryView viewOf(const AccountHistory& history);
+
+/// Hands the garbage collected so far over to the caller.
+std::vector<HistoryGarbage> takeHistoryGarbage(AccountHistory& history);
+
+/// Frees the spilled nodes and the old block array of one garbage entry.
+void freeHistoryGarbage(HistoryGarbage& garbage);
+
+/// Detaches everything a history holds (hot list, block index, pending
+/// garbage) as garbage and leaves the history empty, for closing an
+/// account while views of it may still be read.
+///
+/// `coldOffsets` receives the offsets of the history's cold blocks, to
+/// pass to releaseColdBlocks once no view can read them any more.
+std::vector<HistoryGarbage> detachHistory(AccountHistory& history,
+                                          std::vector<std::int64_t>& coldOffsets);
+
+/// Hands cold block slots back to the store for reuse by later spills.
+void releaseColdBlocks(HistoryStore& store, const std::vector<std::int64_t>& offsets);
+
+/// Number of released block slots waiting to be reused.
+std::size_t freeColdBlockCount(const HistoryStore& store);
+
+/// Visits every entry of the history, oldest first.
+///
+/// Cold blocks are read back from disk one block at a time, so only a
+/// single block is resident at any moment.
+///
+/// @return false if a cold block could not be read.
+bool forEachHistoryEntry(const HistoryStore& store,
+                         const HistoryView& history,
+                         const HistoryVisitor& visit);
+
+/// Visits the entries with index in [from, to), oldest first.
+///
+/// Only the cold blocks overlapping the range are read from disk; the
+/// first one is located by binary search over the block index.
+///
+/// @return false if a cold block could not be read.
+bool forEachHistoryEntryInRange(const HistoryStore& store,
+                                const HistoryView& history,
+                                long long from,
+                                long long to,
+                                const HistoryVisitor& visit);
+
+/// Returns the index of the first entry whose time key is >= timeKey
+/// (or > timeKey when `strictlyAfter` is true), or history.size if
+/// there is none.
+///
+/// Binary searches the cold block time index and reads at most one
+/// block from disk; the bounded hot list is scanned linearly.
+long long findFirstEntryAtOrAfter(const HistoryStore& store,
+                                  const HistoryView& history,
+                                  long long timeKey,
+                                  bool strictlyAfter = false);
+
+/// Collects one page of the entries whose timestamp lies in [from, to].
+///
+/// `from` and `to` may be partial dates (see toTimeKey); a bare date as
+/// `to` includes the whole day. The page starts `pageOffset` matches
+/// into the range and holds at most `pageSize` entries.
+///
+/// @return false if a cold block could not be read.
+bool queryHistoryByTime(const HistoryStore& store,
+                        const HistoryView& history,
+                        const std::string& from,
+                        const std::string& to,
+                        long long pageOffset,
+                        int pageSize,
+                        HistoryPage& out);
+
+/// Collects one page of the last `count` entries (oldest of them first).
+///
+/// @return false if a cold block could not be read.
+bool queryRecentHistory(const HistoryStore& store,
+                        const HistoryView& history,
+                        long long count,
+                        long long pageOffset,
+                        int pageSize,
+                        HistoryPage& out);
+
+/// Computes the balance as of a point in time: the balanceAfter of the
+/// last entry with time key <= timeKey, or `openingBalance` if there is
+/// no such entry.
+///
+/// Binary searches the block checkpoints and reads at most one block
+/// from disk (none if timeKey falls between two blocks).
+///
+/// @return false if a cold block could not be read.
+bool balanceAtTime(const HistoryStore& store,
+                   const HistoryView& history,
+                   double openingBalance,
+                   long long timeKey,
+                   double& out);
+
+/// Frees the hot nodes, the block index and any uncollected garbage.
+///
+/// Space in the segment file is not released (see detachHistory and
+/// releaseColdBlocks for that); it goes away when the store is closed.
+void freeHistory(AccountHistory& history);
+
+} // namespace bank
+
+#endif // HISTORY_STORE_H
@@ -0,0 +1,129 @@
+#ifndef IDEMPOTENCY_H
+#define IDEMPOTENCY_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace bank {
+
+enum class OperationStatus;   // bank_service.h
+
+/// Idempotency keys: a request sent with a key is applied once, and a
+/// retry with the same key (e.g. after a lost reply) gets the outcome of
+/// the first attempt back without being applied again.
+///
+/// The keys seen recently are kept in a bounded cache, spread over
+/// kIdempotencyStripes hash maps by key hash, each with its own lock and
+/// its own least-recently-used list. A lookup is one hash probe; a new
+/// key evicts the least recently used one once its stripe is full, and
+/// keys older than the time-to-live are dropped as they are met (from
+/// the old end of the list, so never by a scan). A retry arriving after
+/// its key was evicted is applied again.
+///
+/// Each key also remembers a fingerprint of its request (operation,
+/// accounts, amount), so a key reused for a different request is refused
+/// instead of being answered with the first request's outcome.
+
+/// Number of independently locked stripes.
+constexpr int kIdempotencyStripes = 16;
+
+/// Default bound on the number of keys kept (over all stripes).
+constexpr std::size_t kDefaultIdempotencyCapacity = 1 << 16;
+
+/// Default time a key is remembered (24 hours).
+constexpr long long kDefaultIdempotencyTtlSeconds = 24 * 60 * 60;
+
+/// One remembered request.
+///
+/// Fields:
+///  - key         : the idempotency key
+///  - fingerprint : requestFingerprint of the first request
+///  - outcome     : status of the first attempt (valid once done)
+///  - done        : false while the first attempt is still running
+///  - expires     : time (idempotencyNow) after which the key is forgotten
+struct IdempotencyEntry {
+    std::string     key;
+    std::uint64_t   fingerprint{0};
+    OperationStatus outcome{};
+    bool            done{false};
+    long long       expires{0};
+};
+
+/// One stripe: its entries, most recently used first, and a map from
+/// key to entry (the keys viewed are those of the list nodes).
+struct IdempotencyStripe {
+    using List = std::list<IdempotencyEntry>;
+
+    std::mutex                                         mutex;
+    List                                               entries;
+    std::unordered_map<std::string_view, List::iterator> index;
+};
+
+/// The whole cache, owned by the Bank.
+///
+/// Fields:
+///  - capacityPerStripe : most keys one stripe keeps
+///  - ttlSeconds        : how long a key is remembered
+struct IdempotencyCache {
+    IdempotencyStripe        stripes[kIdempotencyStripes];
+    std::atomic<std::size_t> capacityPerStripe{kDefaultIdempotencyCapacity / kIdempotencyStripes};
+    std::atomic<long long>   ttlSeconds{kDefaultIdempotencyTtlSeconds};
+};
+
+/// What claimIdempotencyKey found.
+enum class IdempotencyClaim {
+    New,          // first time: the caller applies the request, then completes the key
+    Done,         // seen before: `outcome` is the first attempt's status
+    InProgress,   // the first attempt is still running
+    Mismatch      // the key was used for a different request
+};
+
+/// Identifies what a keyed request asks for (`operation` is a name such
+/// as "deposit"; `counterparty` is 0 when there is none).
+std::uint64_t requestFingerprint(const char* operation,
+                                 int account,
+                                 int counterparty,
+                                 double amount);
+
+/// Looks `key` up; if it is new, records it as in progress with
+/// `fingerprint`. O(1) expected, under the lock of one stripe.
+IdempotencyClaim claimIdempotencyKey(IdempotencyCache& cache,
+                                     const std::string& key,
+                                     std::uint64_t fingerprint,
+                                     long long now,
+                                     OperationStatus& outcome);
+
+/// Records the outcome of the first attempt of a claimed key (nothing if
+/// the key was evicted meanwhile).
+void completeIdempotencyKey(IdempotencyCache& cache,
+                            const std::string& key,
+                            OperationStatus outcome);
+
+/// Forgets a claimed key whose first attempt did not finish (it threw),
+/// so a retry runs the request again.
+void releaseIdempotencyKey(IdempotencyCache& cache, const std::string& key);
+
+/// Changes the bounds; stripes over the new capacity are trimmed now,
+/// keys already remembered keep their expiry time.
+void configureIdempotency(IdempotencyCache& cache,
+                          std::size_t capacity,
+                          long long ttlSeconds);
+
+/// Number of keys remembered and the bytes they take (estimated).
+void measureIdempotency(IdempotencyCache& cache, std::size_t& keys, std::size_t& bytes);
+
+/// Forgets every key.
+void clearIdempotency(IdempotencyCache& cache);
+
+/// Current time in seconds for the cache (monotonic).
+long long idempotencyNow();
+
+} // namespace bank
+
+#endif // IDEMPOTENCY_H
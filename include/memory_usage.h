@@ -0,0 +1,92 @@
+#ifndef MEMORY_USAGE_H
+#define MEMORY_USAGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+
+#include "bank_service.h"
+
+namespace bank {
+
+/// Memory accounting: how many objects and bytes each data structure of
+/// a Bank holds, for sizing hosts and for checking what a layout change
+/// saves.
+///
+/// Measured on demand by walking the structures (nothing is counted on
+/// the hot paths). Bytes are what the structures asked the allocator
+/// for: sizeof of every node plus the heap buffers of its strings
+/// (strings short enough for the in-place buffer cost nothing extra).
+/// Node overhead of std::set / std::unordered_set is estimated from the
+/// usual layout; allocator rounding and headers are not included.
+
+/// Objects and bytes of one data structure.
+struct MemoryFootprint {
+    std::size_t objects{0};
+    std::size_t bytes{0};
+};
+
+/// Memory held by one Bank, per data structure.
+///
+/// Fields:
+///  - accountNodes    : tree nodes, tombstones included (each with its
+///                      Account and the fixed part of its history), plus
+///                      the pages of a radix index
+///  - accountVersions : published account versions still linked
+///  - holderNames     : distinct names; bytes: pool chunks + lookup set
+///  - historyEntries  : in-memory (hot) Transaction nodes
+///  - historyStrings  : datetime heap buffers of those entries
+///  - historyBlocks   : cold block index entries (bytes: the arrays)
+///  - historyGarbage  : spilled nodes and outgrown block arrays not yet
+///                      handed to reclamation, with their strings
+///  - balanceIndex    : balance index entries (set nodes)
+///  - nameIndex       : name index entries, folded names included
+///  - pendingQueue    : queued transactions
+///  - interestEpochs  : interest postings, datetime strings included
+///  - velocityWindows : per-account velocity limit windows
+///  - idempotencyKeys : remembered request keys (list and map nodes)
+///  - retiredObjects  : objects waiting for reclamation (sizes unknown)
+///  - coldEntries     : history entries spilled to the segment file
+///  - segmentBytes    : size of the segment file (disk, not memory)
+struct MemoryUsage {
+    MemoryFootprint accountNodes;
+    MemoryFootprint accountVersions;
+    MemoryFootprint holderNames;
+    MemoryFootprint historyEntries;
+    MemoryFootprint historyStrings;
+    MemoryFootprint historyBlocks;
+    MemoryFootprint historyGarbage;
+    MemoryFootprint balanceIndex;
+    MemoryFootprint nameIndex;
+    MemoryFootprint pendingQueue;
+    MemoryFootprint interestEpochs;
+    MemoryFootprint velocityWindows;
+    MemoryFootprint idempotencyKeys;
+    std::size_t     retiredObjects{0};
+    long long       coldEntries{0};
+    std::int64_t    segmentBytes{0};
+
+    /// Sum of the bytes of every footprint above.
+    std::size_t totalBytes() const;
+};
+
+/// Measures every structure of the bank.
+///
+/// Safe while other threads use the bank: the tree is walked in one
+/// read snapshot, each account's history under its lock, the queue
+/// and the indexes under their locks (one at a time, so the parts are
+/// not from exactly the same moment).
+template <typename BankT>
+MemoryUsage measureMemory(BankT& bank);
+
+/// Writes `usage` as one line of JSON:
+///   {"account_nodes":{"objects":..,"bytes":..},..,"retired_objects":..,
+///    "cold_entries":..,"segment_bytes":..,"total_bytes":..}
+void writeMemoryJson(std::ostream& out, const MemoryUsage& usage);
+
+/// Prints `usage` as a table (objects and bytes per structure).
+void printMemoryUsage(const MemoryUsage& usage);
+
+} // namespace bank
+
+#endif // MEMORY_USAGE_H
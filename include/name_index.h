@@ -0,0 +1,123 @@
+#ifndef NAME_INDEX_H
+#define NAME_INDEX_H
+
+#include <cstddef>
+#include <limits>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+#include "account_bst.h"
+#include "name_pool.h"
+
+namespace bank {
+
+/// Secondary index of the accounts by holder name.
+///
+/// Names are stored case-folded (ASCII letters lowered) in a sorted
+/// table: one contiguous sorted array, searched by binary search. The
+/// folded names themselves live in the bank's NamePool, so equal names
+/// are stored once and an entry is a handle, not a string of its own.
+/// New accounts go to a small sorted delta set first, which is merged
+/// into the table once it reaches a fraction of the table's size, so an
+/// insert costs O(log n) amortized and a lookup a few binary searches.
+/// Closed accounts leave a tombstone in the table (an entry without a
+/// node) that lookups skip; merging drops them, and a merge is forced
+/// once they make up the same fraction of the table.
+///
+/// A merge builds the new table without holding the lock: the delta is
+/// set aside (still searched) and a fresh delta takes new accounts, while
+/// closures during the merge are noted and applied to the new table when
+/// it is swapped in. Only setting aside and swapping lock exclusively.
+
+/// One indexed name.
+///
+/// Fields:
+///  - folded        : holderName with ASCII letters lowered (the key),
+///                    pooled
+///  - accountNumber : the account (ties between equal names)
+///  - node          : the account node, for the case-sensitive check
+///                    (nullptr for a tombstone)
+struct NameEntry {
+    PooledName         folded;
+    int                accountNumber{};
+    const AccountNode* node{nullptr};
+};
+
+/// Orders entries by folded name, then by account number.
+struct NameEntryLess {
+    bool operator()(const NameEntry& a, const NameEntry& b) const {
+        int cmp = a.folded.view().compare(b.folded.view());
+        if (cmp != 0) return cmp < 0;
+        return a.accountNumber < b.accountNumber;
+    }
+};
+
+/// The index, owned by the Bank.
+///
+/// Fields:
+///  - mutex           : lookups share it, changes take it exclusively
+///  - table           : merged entries, sorted
+///  - delta           : entries added since the last merge (started)
+///  - removed         : tombstones in the table
+///  - merging         : a merge is building the next table; it reads
+///                      table and frozen without the lock, so neither
+///                      changes meanwhile
+///  - frozen          : the delta being merged
+///  - lateErase       : entries of table / frozen closed during the
+///                      merge, made tombstones in the new table
+///  - lateErasedNodes : their nodes, for lookups to skip meanwhile
+struct NameIndex {
+    mutable std::shared_mutex               mutex;
+    std::vector<NameEntry>                  table;
+    std::set<NameEntry, NameEntryLess>      delta;
+    std::size_t                             removed{0};
+    bool                                    merging{false};
+    std::set<NameEntry, NameEntryLess>      frozen;
+    std::vector<NameEntry>                  lateErase;
+    std::unordered_set<const AccountNode*>  lateErasedNodes;
+};
+
+/// How a query matches holder names.
+///  - Exact      : the whole name, same case
+///  - IgnoreCase : the whole name, any case
+///  - Prefix     : names starting with the query, any case
+enum class NameMatch {
+    Exact,
+    IgnoreCase,
+    Prefix
+};
+
+/// `name` with ASCII letters lowered.
+std::string foldName(std::string_view name);
+
+/// Adds a new account under its holder name (folded into `pool`).
+void nameIndexInsert(NameIndex& index, NamePool& pool, const AccountNode* node);
+
+/// Removes a closed account (call before its node is freed).
+void nameIndexErase(NameIndex& index, const AccountNode* node);
+
+/// Merges the delta and drops every tombstone now.
+void compactNameIndex(NameIndex& index);
+
+/// Appends the pool handles of every entry to `handles` (for
+/// compactNamePool). Only right after compactNameIndex, with the index
+/// to itself.
+void nameIndexHandles(NameIndex& index, std::vector<PooledName*>& handles);
+
+/// Account numbers whose holder name matches `query`, in name order (then
+/// account-number order), at most `limit` of them.
+std::vector<int> nameIndexFind(const NameIndex& index,
+                               const std::string& query,
+                               NameMatch how,
+                               std::size_t limit = std::numeric_limits<std::size_t>::max());
+
+/// Removes every entry (the nodes are freed by the caller).
+void clearNameIndex(NameIndex& index);
+
+} // namespace bank
+
+#endif // NAME_INDEX_H
@@ -0,0 +1,82 @@
+#ifndef NAME_POOL_H
+#define NAME_POOL_H
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace bank {
+
+/// Handle to a holder name stored in a NamePool (8 bytes instead of a
+/// 32-byte std::string plus its heap buffer).
+///
+/// Points at the null-terminated characters inside the pool, which never
+/// move, so the handle can be read without the pool or any lock. The
+/// default handle is the empty name.
+struct PooledName {
+    const char* chars{""};
+
+    std::string_view view() const { return chars; }
+    std::string      str() const { return chars; }
+};
+
+inline bool operator==(PooledName name, std::string_view other) { return name.view() == other; }
+inline bool operator!=(PooledName name, std::string_view other) { return name.view() != other; }
+
+inline std::ostream& operator<<(std::ostream& out, PooledName name) {
+    return out << name.chars;
+}
+
+/// Deduplicated, append-only storage for holder names (one per Bank).
+///
+/// Names are copied once into large chunks; the same name interned again
+/// returns the same handle. Chunks are only freed by freeNamePool, or by
+/// compactNamePool once closed accounts have left names nobody uses.
+///
+/// Fields:
+///  - mutex     : guards everything below
+///  - chunks    : the character arena
+///  - chunkUsed : bytes used in the last chunk
+///  - names     : every stored name, viewing into the chunks
+///  - bytes     : total bytes allocated for chunks
+struct NamePool {
+    std::mutex                              mutex;
+    std::vector<std::unique_ptr<char[]>>    chunks;
+    std::size_t                             chunkUsed{0};
+    std::unordered_set<std::string_view>    names;
+    std::size_t                             bytes{0};
+};
+
+/// Size of one arena chunk (longer names get a chunk of their own).
+constexpr std::size_t kNamePoolChunkSize = 64 * 1024;
+
+/// Returns the pooled copy of `name`, storing it if it is new.
+/// A name must not contain '\0' (holder names never do).
+PooledName internName(NamePool& pool, std::string_view name);
+
+/// Number of distinct names stored.
+std::size_t namePoolSize(NamePool& pool);
+
+/// Bytes used by the pool (arena chunks; the lookup set not included).
+std::size_t namePoolBytes(NamePool& pool);
+
+/// Rebuilds the pool with only the names `handles` point at, rewrites
+/// each handle to its new copy and frees the old chunks.
+///
+/// Every live handle must be in `handles`; any other handle becomes
+/// invalid. Only call while nothing else reads names (e.g. exclusive
+/// access to the bank).
+/// @return bytes of chunk memory released.
+std::size_t compactNamePool(NamePool& pool, const std::vector<PooledName*>& handles);
+
+/// Frees every name. Handles into the pool become invalid.
+void freeNamePool(NamePool& pool);
+
+} // namespace bank
+
+#endif // NAME_POOL_H
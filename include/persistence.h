@@ -8,22 +8,44 @@ namespace bank {
 
     /// Save all accounts and their transaction histories to two CSV files.
     /// Format:
-    ///   accounts.csv:     accountNumber,holderName,balance
-    ///   transactions.csv: accountNumber,type,amount,datetime
+    ///   accounts.csv:     accountNumber,holderName,balance,openingBalance
+    ///   transactions.csv: accountNumber,type,amount,datetime,balanceAfter,
+    ///                     counterparty,transferId
     ///
     /// Returns true on success, false on failure.
-    bool saveBankToFiles(const Bank& bank,
+    template <typename BankT>
+    bool saveBankToFiles(const BankT& bank,
                          const std::string& accountsFile,
                          const std::string& transactionsFile);
 
-    /// Load accounts and histories from two CSV files into an existing Bank.
+    /// Load accounts and histories from two CSV files into an existing bank.
+    ///
+    /// Columns are located by the header line. Files written before the
+    /// openingBalance / balanceAfter columns existed are still accepted:
+    /// opening balances are derived from the final balances and the
+    /// running balances are replayed from them.
     ///
     /// If files do not exist, this function prints a message and returns false.
     /// If some data is loaded, returns true.
-    bool loadBankFromFiles(Bank& bank,
+    template <typename BankT>
+    bool loadBankFromFiles(BankT& bank,
                            const std::string& accountsFile,
                            const std::string& transactionsFile);
 
+    /// Append one closed account and its whole history to two archive
+    /// CSV files (created with a header line if they do not exist yet).
+    /// Format: as saveBankToFiles, plus a closedAt column in the
+    /// accounts archive.
+    ///
+    /// The caller keeps the account from changing meanwhile (node lock).
+    /// Returns true on success, false on failure.
+    template <typename BankT>
+    bool appendClosedAccount(const BankT& bank,
+                             const Account& account,
+                             const std::string& closedAt,
+                             const std::string& accountsArchive,
+                             const std::string& transactionsArchive);
+
 } // namespace bank
 
 #endif // PERSISTENCE_H
@@ -0,0 +1,127 @@
+#ifndef REPORTING_H
+#define REPORTING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "bank_service.h"
+
+namespace bank {
+
+/// Analytical reports over the whole bank.
+///
+/// A report first copies the accounts and their histories out of one
+/// read snapshot into plain column arrays (a ReportView), then runs its
+/// scans over those arrays, split across threads. The live structures are
+/// only touched while building the view, and writers are never blocked.
+
+/// One row per account, stored column by column (index i of every
+/// vector belongs to the same account, in account-number order).
+///
+/// Fields:
+///  - number       : account numbers
+///  - balance      : balances, pending interest included
+///  - activity     : number of transactions of the account
+struct AccountColumns {
+    std::vector<int>       number;
+    std::vector<double>    balance;
+    std::vector<long long> activity;
+};
+
+/// One row per transaction, stored column by column.
+///
+/// Fields:
+///  - account : account the transaction belongs to
+///  - type    : TransactionType, as its underlying integer
+///  - amount  : amount (always positive, see balanceEffect)
+///  - timeKey : timestamp as YYYYMMDDHHMMSS (see toTimeKey)
+struct TransactionColumns {
+    std::vector<int>           account;
+    std::vector<std::uint8_t>  type;
+    std::vector<double>        amount;
+    std::vector<long long>     timeKey;
+};
+
+/// Columnar copy of the bank as of one snapshot.
+struct ReportView {
+    AccountColumns     accounts;
+    TransactionColumns transactions;
+};
+
+/// Builds the columnar view from one ReadSnapshot. Interest that is
+/// posted but not materialized shows up as Interest rows, as when saving.
+template <typename BankT>
+void buildReportView(const BankT& bank, ReportView& out);
+
+/// What transactions are grouped by.
+///  - Type         : key is the TransactionType (as integer)
+///  - Day          : key is the date as YYYYMMDD
+///  - AccountRange : key is the first account number of the range
+enum class GroupBy {
+    Type,
+    Day,
+    AccountRange
+};
+
+/// One group of a group-by.
+struct GroupRow {
+    long long key{};
+    long long count{0};
+    double    sum{0.0};
+    double    min{0.0};
+    double    max{0.0};
+
+    double average() const { return count > 0 ? sum / count : 0.0; }
+};
+
+/// count / sum / avg / min / max of the transaction amounts per group,
+/// sorted by key. Rows with timeKey outside [fromKey, toKey] are skipped.
+///
+/// @param rangeSize Width of an account range (GroupBy::AccountRange);
+///                  ranges are [1, rangeSize], [rangeSize + 1, ...], ...
+/// @param threads   Number of scanning threads (0 = hardware concurrency).
+std::vector<GroupRow> groupTransactions(const ReportView& view,
+                                        GroupBy by,
+                                        int rangeSize = 100,
+                                        long long fromKey = 0,
+                                        long long toKey = 99999999999999LL,
+                                        unsigned threads = 0);
+
+/// One account of a top-N list.
+struct AccountRank {
+    int    accountNumber{};
+    double value{};
+};
+
+/// The `n` accounts with the highest balance, highest first.
+std::vector<AccountRank> topAccountsByBalance(const ReportView& view, std::size_t n);
+
+/// The `n` accounts with the most transactions, most first.
+std::vector<AccountRank> topAccountsByActivity(const ReportView& view, std::size_t n);
+
+/// Name of a group key (type name, date, or "first-last" account range).
+std::string groupKeyLabel(GroupBy by, long long key, int rangeSize = 100);
+
+/// Writes a group-by result as CSV: group,count,sum,avg,min,max.
+/// @return true on success, false if the file could not be written.
+bool exportGroupsCsv(const std::vector<GroupRow>& rows,
+                     GroupBy by,
+                     int rangeSize,
+                     const std::string& path);
+
+/// Writes a top-N list as CSV: rank,accountNumber,value.
+/// @return true on success, false if the file could not be written.
+bool exportRankingCsv(const std::vector<AccountRank>& ranks,
+                      const std::string& path);
+
+/// Prints a group-by result as a table.
+void printGroups(const std::vector<GroupRow>& rows, GroupBy by, int rangeSize = 100);
+
+/// Prints a top-N list.
+void printRanking(const std::vector<AccountRank>& ranks, const std::string& valueName);
+
+} // namespace bank
+
+#endif // REPORTING_H
@@ -0,0 +1,58 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <string>
+
+#include "bank_service.h"
+
+namespace bank {
+
+/// Long-lived service mode: the bank answers requests in the binary
+/// protocol of wire_protocol.h on a Unix domain socket. (Linux only:
+/// built when the platform has epoll, see CMakeLists.txt.)
+///
+/// Each of `threads` event loops has its own epoll instance and owns the
+/// connections it accepts; the listening socket is shared (exclusive
+/// wakeup, so a new client wakes one loop, not all). Sockets are
+/// non-blocking and edge-triggered. Every readable burst of a connection
+/// is decoded into as many requests as it holds; they run in order, runs
+/// of consecutive deposits / withdrawals through a single applyBatch
+/// call, and all responses of the burst go out in one write. The loops
+/// share nothing but the Bank, whose service functions are thread-safe,
+/// and one worker thread: Save, ProcessQueue and Close (file writes, a
+/// walk of the whole queue) are handed to it so they never stall a loop.
+/// Their connection is served no further until the worker's response is
+/// back (through an eventfd of the loop), which keeps responses in order.
+/// After a Close, once compactionDue, the worker pauses the loops between
+/// two epoll_wait rounds and runs compactBank.
+
+/// Settings of one server run.
+///
+/// Fields:
+///  - socketPath          : where to listen (an old socket file is replaced)
+///  - threads             : event loops (0 = one per hardware thread)
+///  - accountsFile        : target of the Save request
+///  - transactionsFile    : likewise
+///  - accountsArchive     : archive of the Close request
+///  - transactionsArchive : likewise
+struct ServerOptions {
+    std::string socketPath{"bank.sock"};
+    unsigned    threads{0};
+    std::string accountsFile{"accounts.csv"};
+    std::string transactionsFile{"transactions.csv"};
+    std::string accountsArchive{"closed_accounts.csv"};
+    std::string transactionsArchive{"closed_transactions.csv"};
+};
+
+/// Serves requests until SIGINT / SIGTERM or requestServerStop, then
+/// closes every connection and removes the socket file.
+/// @return false if the socket could not be set up.
+bool runServer(Bank& bank, const ServerOptions& options);
+
+/// Asks a running server to stop (safe from any thread and from signal
+/// handlers).
+void requestServerStop();
+
+} // namespace bank
+
+#endif // SERVER_H
@@ -0,0 +1,199 @@
+#ifndef SHARDED_BANK_H
+#define SHARDED_BANK_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bank_service.h"
+
+namespace bank {
+
+/// Shared-nothing deployment mode: accounts are partitioned by account
+/// number over N independent Banks ("shards"). Each shard has its own
+/// account tree, pending queue and history segment file and is only ever
+/// touched by its own worker thread, which executes the messages posted
+/// to its inbox one after another. The account locks inside a shard are
+/// therefore never contended; shards only talk through their inboxes.
+///
+/// Account k lives in shard (k % shardCount).
+
+/// Work sent to a shard; runs on the shard's thread with its Bank.
+using ShardTask = std::function<void(Bank& bank)>;
+
+/// One shard: a Bank, its worker thread and its inbox.
+///
+/// Fields:
+///  - bank    : the accounts of this shard
+///  - worker  : the only thread that touches `bank`
+///  - inbox   : messages waiting to run, oldest first
+///  - mutex   : guards inbox and stopping
+///  - ready   : signalled when a message arrives or the shard stops
+///  - stopping: set once the shard should exit after draining its inbox
+struct Shard {
+    Bank                    bank;
+    std::thread             worker;
+    std::deque<ShardTask>   inbox;
+    std::mutex              mutex;
+    std::condition_variable ready;
+    bool                    stopping{false};
+};
+
+/// A cross-shard transfer whose amount left the sender but could be
+/// neither credited to the receiver nor refunded (both accounts were
+/// closed meanwhile). Kept so the money can be accounted for by hand.
+///
+/// Fields:
+///  - transferId  : id of both TransferOut and the missing TransferIn
+///  - fromAccount : debited account
+///  - toAccount   : account it was meant for
+///  - amount      : amount debited
+///  - datetime    : timestamp of the TransferOut entry
+struct SuspendedTransfer {
+    long long   transferId{};
+    int         fromAccount{};
+    int         toAccount{};
+    double      amount{};
+    std::string datetime;
+};
+
+/// The set of shards plus the state shared by all of them.
+///
+/// Fields:
+///  - shards         : the shards (fixed after initShardedBank)
+///  - nextTransferId : transfer ids, unique across all shards
+///  - archiveMutex   : serializes closures, whose archive files all
+///                     shards share
+///  - suspenseMutex  : guards suspense
+///  - suspense       : transfers that could not be delivered nor refunded
+struct ShardedBank {
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::atomic<long long> nextTransferId{1};
+    std::mutex             archiveMutex;
+    std::mutex             suspenseMutex;
+    std::vector<SuspendedTransfer> suspense;
+};
+
+/// Creates `shardCount` shards (at least 1) and starts their threads.
+void initShardedBank(ShardedBank& sharded, int shardCount);
+
+/// Lets every shard finish the messages already posted, stops the
+/// threads and destroys the shards.
+void destroyShardedBank(ShardedBank& sharded);
+
+/// Index of the shard that owns `accountNumber`.
+std::size_t shardIndexOf(const ShardedBank& sharded, int accountNumber);
+
+/// Posts `task` to a shard's inbox and returns immediately.
+void postToShard(Shard& shard, ShardTask task);
+
+/// Creates an account in its shard (see addAccount). Prints nothing;
+/// the caller reports the status.
+/// @return Ok, InvalidAccountNumber, InvalidAmount or DuplicateAccount.
+OperationStatus shardedCreateAccount(ShardedBank& sharded,
+                                     int accountNumber,
+                                     const std::string& holderName,
+                                     double initialBalance);
+
+/// Applies a batch of deposits / withdrawals (see applyBatch).
+///
+/// The batch is split by shard and all parts run in parallel, one
+/// message per shard involved.
+/// @return One status per operation, in the same order as `ops`.
+std::vector<OperationStatus> shardedApplyBatch(ShardedBank& sharded,
+                                               const BatchOperation* ops,
+                                               std::size_t count);
+
+/// Moves `amount` between two accounts, possibly in different shards.
+///
+/// Within one shard this is transferFunds. Across shards it is a
+/// two-phase handoff:
+///  1) prepare : the receiver's shard confirms the account exists
+///  2) send    : the sender's shard debits and records TransferOut, then
+///               hands a credit message to the receiver's shard
+///  3) receive : the receiver's shard credits and records TransferIn
+/// A prepared receive only fails if the receiving account was closed in
+/// between; the amount is then credited back to the sender (a TransferIn
+/// from the closed account with the same transfer id) and the transfer
+/// reports AccountNotFound. If the sender was closed as well, the refund
+/// fails too: the transfer is recorded in the suspense list (see
+/// shardedSuspense) and reports TransferSuspended. Between 2) and 3) the
+/// amount is in flight: a report that reads the two shards separately
+/// may miss it for that moment.
+OperationStatus shardedTransfer(ShardedBank& sharded,
+                                int fromAccount,
+                                int toAccount,
+                                double amount);
+
+/// Transfers recorded in the suspense list so far, oldest first.
+std::vector<SuspendedTransfer> shardedSuspense(ShardedBank& sharded);
+
+/// Queues a deposit / withdrawal in the pending queue of the account's
+/// shard (see queuePendingTransaction). Prints nothing.
+OperationStatus shardedEnqueue(ShardedBank& sharded,
+                               int accountNumber,
+                               TransactionType type,
+                               double amount);
+
+/// Runs the pending queue of every shard (see applyPendingQueue), all
+/// shards in parallel; each queue keeps its FIFO order.
+/// @return The counts of all shards added up.
+QueueRunSummary shardedProcessQueue(ShardedBank& sharded);
+
+/// Closes an account in its shard (see closeAccount), then compacts the
+/// shard once compactionDue.
+OperationStatus shardedCloseAccount(ShardedBank& sharded,
+                                    int accountNumber,
+                                    const std::string& accountsArchive,
+                                    const std::string& transactionsArchive);
+
+/// Records an interest posting in every shard (see applyInterestAll).
+/// @return false if rate <= 0.
+bool shardedPostInterest(ShardedBank& sharded, double rate);
+
+/// Current balances of all accounts of all shards, in account-number order.
+std::vector<AccountBalance> shardedBalances(ShardedBank& sharded);
+
+/// Current balance of one account, pending interest included.
+/// @return false if the account was not found.
+bool shardedBalance(ShardedBank& sharded, int accountNumber, double& balance);
+
+/// Name of the file of shard `shard` out of `shardCount` for a file of
+/// the single-bank mode: "accounts.csv" -> "accounts.shard1-of-4.csv".
+/// The shard count is part of the name because accounts are placed by
+/// it (k % shardCount): files written with another count are not read.
+std::string shardFileName(const std::string& file, std::size_t shard, std::size_t shardCount);
+
+/// Shard count of existing shard files of `file` (in its directory) that
+/// were written with a count other than `shardCount`, or 0 if there are
+/// none. Such files hold accounts placed by that other count, so the
+/// caller should refuse to start rather than begin with an empty bank
+/// and later save a second, diverging set of files.
+std::size_t otherShardCountOnDisk(const std::string& file, std::size_t shardCount);
+
+/// Loads every shard from its own pair of files (see shardFileName and
+/// loadBankFromFiles), one shard after another so the loader's messages
+/// do not interleave. Call before any other work is posted. Files of
+/// another shard count are not read (see otherShardCountOnDisk).
+/// @return true if at least one shard loaded data.
+bool shardedLoad(ShardedBank& sharded,
+                 const std::string& accountsFile,
+                 const std::string& transactionsFile);
+
+/// Saves every shard to its own pair of files (see saveBankToFiles), all
+/// shards in parallel.
+/// @return true if every shard was saved.
+bool shardedSave(ShardedBank& sharded,
+                 const std::string& accountsFile,
+                 const std::string& transactionsFile);
+
+} // namespace bank
+
+#endif // SHARDED_BANK_H
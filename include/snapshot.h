@@ -0,0 +1,77 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "account_bst.h"
+#include "epoch.h"
+#include "history_store.h"
+
+namespace bank {
+
+/// Immutable state of one account as of one commit.
+///
+/// Every change to an account publishes a new version at the head of the
+/// node's version chain (newest first). Readers pick the newest version
+/// whose stamp is not after their snapshot, so a report sees each
+/// account exactly as it was at one moment, even while writers go on.
+///
+/// Fields:
+///  - stamp   : commit stamp that published this version
+///  - balance : account balance
+///  - history : view of the history (same length as at the commit)
+///  - interestApplied : interest postings included in balance/history
+///  - closed  : the account was closed by this commit (a tombstone)
+///  - older   : previous version, or nullptr once no reader needs it
+struct AccountVersion {
+    std::uint64_t stamp{0};
+    double        balance{0.0};
+    HistoryView   history;
+    std::size_t   interestApplied{0};
+    bool          closed{false};
+    std::atomic<AccountVersion*> older{nullptr};
+};
+
+/// Publishes the current state of `count` accounts as one commit, so
+/// readers see all of them changed or none (e.g. both transfer halves).
+///
+/// Call after the changes are made, while holding the lock of every node
+/// (or with exclusive access, as the loader has). Versions no reader can
+/// reach any more and the history garbage of the nodes are retired.
+void commitAccounts(EpochManager& epochs, AccountNode* const* nodes, std::size_t count);
+
+/// commitAccounts for a single account.
+void commitAccount(EpochManager& epochs, AccountNode* node);
+
+/// A consistent, read-only view of the whole bank (RAII).
+///
+/// Pins the current commit stamp on construction and releases it on
+/// destruction. Takes no locks; writers are never blocked by it.
+/// Nothing reached through the snapshot is freed while it is alive.
+struct ReadSnapshot {
+    explicit ReadSnapshot(EpochManager& epochs);
+    ~ReadSnapshot();
+
+    ReadSnapshot(const ReadSnapshot&) = delete;
+    ReadSnapshot& operator=(const ReadSnapshot&) = delete;
+
+    /// Commits up to and including this stamp are visible.
+    std::uint64_t stamp() const;
+
+    ReaderSlot* slot;
+};
+
+/// State of `node` in the snapshot.
+/// @return nullptr if the account was created after the snapshot was
+///         taken, or closed before it.
+const AccountVersion* versionAt(const ReadSnapshot& snapshot, const AccountNode* node);
+
+/// Frees every version of a node.
+/// Must not run concurrently with any other access to the node.
+void freeAccountVersions(AccountNode* node);
+
+} // namespace bank
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,137 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+
+#include "bank_service.h"
+
+namespace bank {
+
+/// Operation counters and latency histograms of the service layer.
+///
+/// Compiled in only with BANK_ENABLE_STATS (CMake option of the same
+/// name). Without it StatTimer and recordBatchStats are empty inline
+/// functions, so the instrumented code compiles to what it was before.
+///
+/// Every thread records into its own counters (plain stores, no shared
+/// cache lines, no locks); a dump adds up the counters of all threads,
+/// including threads that have exited. Latencies go into log-linear
+/// buckets (16 per power of two, so a bucket is within ~6% of its
+/// values), HDR-histogram style: constant memory, constant-time record.
+
+/// Instrumented operations.
+enum class StatOp {
+    Create,
+    Deposit,
+    Withdraw,
+    Enqueue,
+    ProcessQueue,   // one queue run (failures: of the queued items)
+    Interest,
+    Save,
+    Load            // failure: nothing could be loaded
+};
+
+constexpr std::size_t kStatOpCount = 8;
+
+/// Failure slots: one per OperationStatus, plus one for failures that
+/// have none (e.g. a file that could not be written).
+constexpr std::size_t kStatFailureKinds = static_cast<std::size_t>(OperationStatus::Count) + 1;
+constexpr std::size_t kStatOtherFailure = kStatFailureKinds - 1;
+
+#ifdef BANK_ENABLE_STATS
+
+/// Counts one call of `op` taking `nanos`.
+void recordOp(StatOp op, std::uint64_t nanos);
+
+/// Counts one failure of `op` (OperationStatus::Ok is ignored).
+void recordFailure(StatOp op, OperationStatus status);
+
+/// Counts one failure of `op` without a status (kStatOtherFailure).
+void recordOtherFailure(StatOp op);
+
+/// Nanoseconds on a monotonic clock.
+inline std::uint64_t statsNow() {
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+/// Times one operation from construction to done().
+class StatTimer {
+public:
+    explicit StatTimer(StatOp op) : op_(op), start_(statsNow()) {}
+
+    /// Records the call and its outcome; returns `status` unchanged so
+    /// it can wrap a return value.
+    OperationStatus done(OperationStatus status) {
+        recordOp(op_, statsNow() - start_);
+        recordFailure(op_, status);
+        return status;
+    }
+
+    /// Records the call; `ok` false counts as a failure without status.
+    bool done(bool ok) {
+        recordOp(op_, statsNow() - start_);
+        if (!ok) {
+            recordOtherFailure(op_);
+        }
+        return ok;
+    }
+
+private:
+    StatOp        op_;
+    std::uint64_t start_;
+};
+
+/// Records a batch of deposits / withdrawals that took `nanos` in all;
+/// each operation is counted with an equal share of the time.
+void recordBatchStats(const BatchOperation* ops,
+                      const OperationStatus* results,
+                      std::size_t count,
+                      std::uint64_t nanos);
+
+#else
+
+inline std::uint64_t statsNow() { return 0; }
+
+class StatTimer {
+public:
+    explicit StatTimer(StatOp) {}
+    OperationStatus done(OperationStatus status) { return status; }
+    bool done(bool ok) { return ok; }
+};
+
+inline void recordFailure(StatOp, OperationStatus) {}
+
+inline void recordBatchStats(const BatchOperation*, const OperationStatus*,
+                             std::size_t, std::uint64_t) {}
+
+#endif // BANK_ENABLE_STATS
+
+/// True if the stats are compiled in.
+bool statsEnabled();
+
+/// Writes all counters as one line of JSON:
+///   {"enabled":true,"operations":{"create":{"calls":..,"failures":{..},
+///    "latency_ns":{"mean":..,"p50":..,"p90":..,"p99":..,"p999":..,"max":..}},..}}
+/// Failure reasons use the names of operationStatusName ("other" for
+/// failures without a status); only reasons seen are listed. Latencies
+/// are bucket midpoints, "max" that of the highest bucket used.
+/// Without stats: {"enabled":false}.
+void writeStatsJson(std::ostream& out);
+
+/// writeStatsJson plus the memory usage of `bank` (see memory_usage.h)
+/// as a last member, "memory":{...}; present with or without stats.
+template <typename BankT>
+void writeStatsJson(std::ostream& out, BankT& bank);
+
+/// Starts counting from zero: later dumps only show what was recorded
+/// after this call (the per-thread counters are left alone; the current
+/// totals become the baseline that dumps subtract).
+void resetStats();
+
+} // namespace bank
+
+#endif // STATS_H
@@ -0,0 +1,74 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <iosfwd>
+#include <string>
+
+namespace bank {
+
+/// Span tracing of the slow phases (loading, saving, queue settlement,
+/// interest), written out as Chrome trace JSON for chrome://tracing or
+/// ui.perfetto.dev.
+///
+/// Compiled in only with BANK_ENABLE_TRACING (CMake option of the same
+/// name); otherwise TraceSpan is an empty inline class. When compiled
+/// in, recording is on from the start (so startup is covered) and can be
+/// switched off with setTracing.
+///
+/// A span is one complete event (name, start, duration, thread). Each
+/// thread records into its own ring buffer of kTraceRingSize events, so
+/// the newest events are kept and old ones overwritten; the rings of
+/// exited threads are merged into one shared ring of the same size.
+/// Span names must be string literals (only the pointer is stored).
+
+/// Events kept per thread.
+constexpr int kTraceRingSize = 16384;
+
+#ifdef BANK_ENABLE_TRACING
+
+/// Records the time from construction to destruction as one span, if
+/// recording was on at construction.
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name);
+    ~TraceSpan();
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char*        name_;
+    bool               recording_;
+    unsigned long long start_;     // ns on the trace clock
+};
+
+#else
+
+class TraceSpan {
+public:
+    explicit TraceSpan(const char*) {}
+};
+
+#endif // BANK_ENABLE_TRACING
+
+/// True if tracing is compiled in.
+bool tracingEnabled();
+
+/// Switches recording on or off (no effect without tracing).
+void setTracing(bool on);
+
+/// Writes every buffered span as Chrome trace JSON
+/// ({"traceEvents":[...]}, times in microseconds since the first span).
+/// Without tracing the event list is empty.
+void writeChromeTrace(std::ostream& out);
+
+/// Writes the trace to `path`.
+/// @return false if the file could not be written.
+bool saveChromeTrace(const std::string& path);
+
+/// Drops every buffered span.
+void clearTrace();
+
+} // namespace bank
+
+#endif // TRACE_H
@@ -10,10 +10,14 @@ namespace bank {
 /// Deposit  - money is added to the account
 /// Withdraw - money is removed from the account
 /// Interest - interest is added to the account
+/// TransferOut / TransferIn - the two linked halves of an account-to-account
+///            transfer (debit on the sender, credit on the receiver)
 enum class TransactionType {
     Deposit,
     Withdraw,
-    Interest
+    Interest,
+    TransferOut,
+    TransferIn
 };
 
 /// Node for a singly linked list storing one transaction.
@@ -22,21 +26,33 @@ enum class TransactionType {
 ///  - type:     deposit / withdraw / interest
 ///  - amount:   numeric value of the operation
 ///  - datetime: timestamp string "YYYY-MM-DD HH:MM:SS"
+///  - balanceAfter: account balance right after this transaction
+///  - counterparty: for transfers, the account on the other side (else 0)
+///  - transferId:   for transfers, the id shared by both halves (else 0)
 ///  - next:     pointer to the next node in the history list
 struct Transaction {
     TransactionType type;
     double amount;
     std::string datetime;
+    double balanceAfter;
+    int counterparty{0};
+    long long transferId{0};
     Transaction* next;
 
     /// Convenience constructor to initialize all fields at once.
     Transaction(TransactionType t,
                 double a,
                 const std::string& dt,
+                double balAfter = 0.0,
                 Transaction* n = nullptr)
-        : type(t), amount(a), datetime(dt), next(n) {}
+        : type(t), amount(a), datetime(dt), balanceAfter(balAfter), next(n) {}
 };
 
+/// Returns how a transaction changes the balance:
+/// +amount for Deposit / Interest / TransferIn,
+/// -amount for Withdraw / TransferOut.
+double balanceEffect(TransactionType type, double amount);
+
 /// Appends a new transaction node to the end of the list.
 ///
 /// @param head   Reference to the head pointer of the list.
@@ -44,6 +60,7 @@ struct Transaction {
 /// @param type   Transaction type (Deposit / Withdraw / Interest).
 /// @param amount Transaction amount.
 /// @param datetime Timestamp string for when this transaction happened.
+/// @param balanceAfter Account balance after this transaction.
 ///
 /// Internally, this function allocates a new Transaction using `new`
 /// and either:
@@ -52,7 +69,15 @@ struct Transaction {
 void addTransaction(Transaction*& head,
                     TransactionType type,
                     double amount,
-                    const std::string& datetime);
+                    const std::string& datetime,
+                    double balanceAfter = 0.0);
+
+/// Prints one transaction as a numbered line to std::cout.
+///
+/// Format:
+///   index) TYPE: amount on datetime (balance: balanceAfter)
+/// Transfers also show the other account and the transfer id.
+void printTransaction(long long index, const Transaction& tx);
 
 /// Prints all transactions in the list to std::cout.
 ///
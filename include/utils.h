@@ -11,6 +11,24 @@ namespace bank {
     /// a human-readable timestamp.
     std::string getCurrentDateTime();
 
+    /// Converts a "YYYY-MM-DD HH:MM:SS" timestamp into a sortable integer
+    /// of the form YYYYMMDDHHMMSS (e.g. 20250131235959).
+    ///
+    /// Separators are ignored, so partial inputs such as "2025-01-31" are
+    /// accepted. Missing trailing digits are filled with '0', or with '9'
+    /// when `roundUp` is true, so that a bare date used as the upper end of
+    /// a range covers the whole day.
+    long long toTimeKey(const std::string& datetime, bool roundUp = false);
+
+    /// Converts a "YYYY-MM-DD HH:MM:SS" local timestamp (as written by
+    /// getCurrentDateTime) into seconds since the epoch.
+    /// Returns 0 if it cannot be read.
+    long long toEpochSeconds(const std::string& datetime);
+
+    /// Converts seconds since the epoch into the local time key
+    /// YYYYMMDDHHMMSS (see toTimeKey).
+    long long epochToTimeKey(long long seconds);
+
     /// Clears any leftover characters from the standard input buffer
     /// until a newline is found.
     ///
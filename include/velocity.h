@@ -0,0 +1,120 @@
+#ifndef VELOCITY_H
+#define VELOCITY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace bank {
+
+/// Velocity limits: withdrawals (and outgoing transfers) are refused once
+/// an account's withdrawals over a rolling window would exceed a
+/// configured amount or count (e.g. at most 5000 per 24 hours, at most
+/// 10 per hour).
+///
+/// Each account keeps, per rule, a ring of kVelocityBuckets buckets that
+/// together span the rule's window, plus the running totals over the
+/// ring. A withdrawal moves the ring forward to the current bucket
+/// (subtracting the buckets that fell out of the window), compares the
+/// totals with the limits and adds itself: O(1) per rule, amortized,
+/// and never a walk over the history. The window is exact to one bucket
+/// (1/kVelocityBuckets of its length).
+///
+/// The windows are not saved: an account without windows for the current
+/// rules (after a restart or a rule change) has them rebuilt once from
+/// the withdrawals in its history (see recordPastWithdrawal), so neither
+/// gives it a fresh allowance.
+
+/// Buckets per rolling window.
+constexpr int kVelocityBuckets = 16;
+
+/// Most rules a bank can have at once.
+constexpr std::size_t kMaxVelocityRules = 4;
+
+/// One limit over a rolling window.
+///
+/// Fields:
+///  - windowSeconds : length of the window
+///  - maxAmount     : largest total withdrawn within it (0 = no limit)
+///  - maxCount      : most withdrawals within it (0 = no limit)
+struct VelocityRule {
+    long long windowSeconds{0};
+    double    maxAmount{0.0};
+    long long maxCount{0};
+};
+
+/// An immutable set of rules, as published by the bank.
+///
+/// Fields:
+///  - generation : number of this set (windows built for another set
+///                 are started over)
+///  - count      : rules in use
+///  - rules      : the rules
+struct VelocityRuleSet {
+    std::uint64_t generation{0};
+    std::size_t   count{0};
+    VelocityRule  rules[kMaxVelocityRules];
+};
+
+/// Rolling totals of one rule for one account.
+///
+/// Fields:
+///  - headSlot     : bucket number (time / bucket width) of the newest bucket
+///  - amount       : withdrawn within the window
+///  - count        : withdrawals within the window
+///  - bucketAmount : per bucket, indexed by bucket number % kVelocityBuckets
+///  - bucketCount  : likewise
+struct VelocityWindow {
+    long long     headSlot{0};
+    double        amount{0.0};
+    long long     count{0};
+    double        bucketAmount[kVelocityBuckets]{};
+    std::uint32_t bucketCount[kVelocityBuckets]{};
+};
+
+/// The windows of one account, one per rule of the set they were built for.
+struct VelocityState {
+    std::uint64_t               generation{0};
+    std::vector<VelocityWindow> windows;
+};
+
+/// True if `state` holds the windows of `rules` (false for nullptr).
+bool velocityStateCurrent(const VelocityRuleSet& rules, const VelocityState* state);
+
+/// Gives `state` (created if needed) empty windows for `rules`, ending
+/// at time `now` (seconds).
+void resetVelocityState(const VelocityRuleSet& rules, VelocityState*& state, long long now);
+
+/// How far back (seconds before now) a withdrawal can still count in one
+/// of the windows of `rules`: the longest window, rounded up to whole
+/// buckets.
+long long velocityLookback(const VelocityRuleSet& rules);
+
+/// Counts a withdrawal made at `when`, before the `now` of the last
+/// resetVelocityState, in the windows still covering it. Used to rebuild
+/// the windows from the history.
+void recordPastWithdrawal(const VelocityRuleSet& rules, VelocityState& state,
+                          double amount, long long when);
+
+/// Checks a withdrawal of `amount` at time `now` (seconds) against every
+/// rule and, if all allow it, counts it in the windows.
+///
+/// `state` is started over (see resetVelocityState) when it does not
+/// match `rules`; callers rebuild it from the history first to keep the
+/// earlier withdrawals. The caller holds the account lock.
+/// @return false if a rule would be exceeded; nothing is counted then.
+bool admitVelocity(const VelocityRuleSet& rules, VelocityState*& state,
+                   double amount, long long now);
+
+/// Current time in seconds for admitVelocity.
+long long velocityNow();
+
+/// Bytes held by one account's state (0 for nullptr).
+std::size_t velocityStateBytes(const VelocityState* state);
+
+/// Frees an account's state and sets it to nullptr.
+void freeVelocityState(VelocityState*& state);
+
+} // namespace bank
+
+#endif // VELOCITY_H
@@ -0,0 +1,121 @@
+#ifndef WIRE_PROTOCOL_H
+#define WIRE_PROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "bank_service.h"
+
+namespace bank {
+
+/// Compact binary request/response protocol of the bank server (see
+/// server.h), shared with its clients.
+///
+/// Every message is a frame: a 4-byte body length followed by the body.
+/// Integers and doubles are in host byte order (the server only listens
+/// locally). A client may send any number of requests without waiting
+/// (pipelining); responses come back in request order, each carrying the
+/// id of its request.
+///
+/// Request body : u32 id, u8 op, then by op
+///   Create      : i32 account, f64 initialBalance, u16 nameLength, name
+///   Deposit     : i32 account, f64 amount [, key]
+///   Withdraw    : i32 account, f64 amount [, key]
+///   Transfer    : i32 from, i32 to, f64 amount [, key]
+///   Enqueue     : i32 account, u8 type (TransactionType), f64 amount [, key]
+///   ProcessQueue: -
+///   Interest    : f64 rate
+///   Balance     : i32 account
+///   Close       : i32 account
+///   Save        : -
+///   Batch       : u32 count, count x (i32 account, u8 type, f64 amount)
+/// where the optional key is u16 keyLength, key: an idempotency key (see
+/// runIdempotent). A keyed request runs at most once per key; a retry
+/// gets the first outcome. Without it the body ends after the amount.
+///
+/// Response body: u32 id, u8 op, u8 status (OperationStatus, or
+/// kWireBadRequest / kWireFailed), then by op (only if status is Ok)
+///   Balance     : f64 balance
+///   ProcessQueue: u32 applied, u32 skipped
+///   Batch       : u32 count, count x u8 status (always present)
+
+/// Operation codes.
+enum class WireOp : std::uint8_t {
+    Create = 1,
+    Deposit,
+    Withdraw,
+    Transfer,
+    Enqueue,
+    ProcessQueue,
+    Interest,
+    Balance,
+    Close,
+    Save,
+    Batch
+};
+
+/// Status of a request the server could not parse.
+constexpr std::uint8_t kWireBadRequest = 254;
+
+/// Status of a request that failed for a reason other than an
+/// OperationStatus (e.g. saving the files).
+constexpr std::uint8_t kWireFailed = 255;
+
+/// Largest frame body accepted (a bigger length closes the connection).
+constexpr std::uint32_t kWireMaxFrame = 1u << 20;
+
+/// One decoded request. Only the fields of its op are meaningful.
+struct WireRequest {
+    std::uint32_t   id{0};
+    WireOp          op{WireOp::Balance};
+    int             account{0};
+    int             toAccount{0};
+    TransactionType type{TransactionType::Deposit};
+    double          amount{0.0};
+    std::string     name;
+    std::string     key;    // idempotency key (empty: none)
+    std::vector<BatchOperation> batch;
+};
+
+/// One decoded response. Only the fields of its op are meaningful.
+struct WireResponse {
+    std::uint32_t id{0};
+    WireOp        op{WireOp::Balance};
+    std::uint8_t  status{0};
+    double        balance{0.0};
+    std::uint32_t applied{0};
+    std::uint32_t skipped{0};
+    std::vector<std::uint8_t> statuses;
+};
+
+/// Result of decoding the front of a byte stream.
+///  - Complete  : one message decoded, `consumed` bytes used
+///  - NeedMore  : the frame is not complete yet
+///  - Malformed : the frame is complete but invalid (`consumed` set, so
+///                the stream can go on), or its length is out of range
+///                (`consumed` 0: the stream cannot be resynchronized)
+enum class WireDecode {
+    Complete,
+    NeedMore,
+    Malformed
+};
+
+/// Appends the frame of `request` to `out`.
+void encodeRequest(const WireRequest& request, std::vector<char>& out);
+
+/// Appends the frame of `response` to `out`.
+void encodeResponse(const WireResponse& response, std::vector<char>& out);
+
+/// Decodes the request frame at the start of [data, data + size).
+WireDecode decodeRequest(const char* data, std::size_t size,
+                         WireRequest& out, std::size_t& consumed);
+
+/// Decodes the response frame at the start of [data, data + size).
+WireDecode decodeResponse(const char* data, std::size_t size,
+                          WireResponse& out, std::size_t& consumed);
+
+} // namespace bank
+
+#endif // WIRE_PROTOCOL_H
@@ -1,48 +1,64 @@
 #include "account_bst.h"
 
+#include "snapshot.h"
+#include "velocity.h"
+
 #include <iostream>
 
 namespace bank {
 
-AccountNode* insertAccount(AccountNode*& root,
+AccountNode* insertAccount(std::atomic<AccountNode*>& root,
                            int accountNumber,
-                           const std::string& name,
+                           PooledName name,
                            double initialBalance,
-                           bool& inserted) {
-    // If tree (subtree) is empty, create a new node here.
-    if (root == nullptr) {
-        Account newAcc(accountNumber, name, initialBalance);
-        root = new AccountNode(newAcc);
-        inserted = true;
-        return root;
-    }
+                           bool& inserted,
+                           std::size_t interestApplied,
+                           double interestFactor) {
+    std::atomic<AccountNode*>* link = &root;
+
+    while (true) {
+        AccountNode* current = link->load(std::memory_order_acquire);
+
+        // If tree (subtree) is empty, create a new node here.
+        if (current == nullptr) {
+            AccountNode* node = new AccountNode(accountNumber, name, initialBalance);
+            node->data.interestApplied = interestApplied;
+            node->data.interestFactor  = interestFactor;
+
+            // Publish only the fully built node, so lock-free readers
+            // never see a half-initialized account.
+            link->store(node, std::memory_order_release);
+            inserted = true;
+            return node;
+        }
 
-    // If the key already exists, do not insert a duplicate.
-    if (accountNumber == root->data.accountNumber) {
-        inserted = false;
-        return root; // return existing node
-    }
+        // If the key already exists, do not insert a duplicate.
+        if (accountNumber == current->data.accountNumber &&
+            !current->closed.load(std::memory_order_acquire)) {
+            inserted = false;
+            return current; // return existing node
+        }
 
-    // If new account number is smaller, go to left subtree.
-    if (accountNumber < root->data.accountNumber) {
-        return insertAccount(root->left, accountNumber, name, initialBalance, inserted);
-    } else {
-        // Otherwise, go to right subtree.
-        return insertAccount(root->right, accountNumber, name, initialBalance, inserted);
+        // Smaller keys go to the left subtree, larger (or equal to a
+        // closed tombstone) to the right.
+        link = (accountNumber < current->data.accountNumber) ? &current->left
+                                                             : &current->right;
     }
 }
 
 AccountNode* searchAccount(AccountNode* root, int accountNumber) {
     AccountNode* current = root;
 
-    // Classic BST iterative search.
+    // Classic BST iterative search (lock-free: children are atomic).
     while (current != nullptr) {
-        if (accountNumber == current->data.accountNumber) {
+        if (accountNumber == current->data.accountNumber &&
+            !current->closed.load(std::memory_order_acquire)) {
             return current; // found it
         } else if (accountNumber < current->data.accountNumber) {
-            current = current->left; // go left
+            current = current->left.load(std::memory_order_acquire); // go left
         } else {
-            current = current->right; // go right
+            current = current->right.load(std::memory_order_acquire); // go right
+                                                                       // (also past a tombstone)
         }
     }
 
@@ -50,43 +66,86 @@ AccountNode* searchAccount(AccountNode* root, int accountNumber) {
     return nullptr;
 }
 
-void printAccountSummary(const Account& account) {
-    std::cout << "Account #" << account.accountNumber
-              << " | Holder: " << account.holderName
-              << " | Balance: " << account.balance
-              << '\n';
+bool unlinkAccountNode(std::atomic<AccountNode*>& root, AccountNode* node) {
+    AccountNode* left  = node->left.load(std::memory_order_acquire);
+    AccountNode* right = node->right.load(std::memory_order_acquire);
+    if (left != nullptr && right != nullptr) {
+        return false;
+    }
+
+    // Find the link that points at this very node (equal keys go right).
+    std::atomic<AccountNode*>* link = &root;
+    while (true) {
+        AccountNode* current = link->load(std::memory_order_acquire);
+        if (current == nullptr) {
+            return false;   // not in the tree
+        }
+        if (current == node) {
+            break;
+        }
+        link = (node->data.accountNumber < current->data.accountNumber) ? &current->left
+                                                                          : &current->right;
+    }
+
+    // A search already standing on `node` still follows its (unchanged)
+    // child links, so it misses nothing.
+    link->store(left != nullptr ? left : right, std::memory_order_release);
+    return true;
 }
 
-void inorderPrintAccounts(const AccountNode* root) {
-    if (root == nullptr) {
-        return; // base case: empty subtree
+namespace {
+
+/// Links nodes[from, to) (sorted) into a balanced subtree.
+AccountNode* linkBalanced(const std::vector<AccountNode*>& nodes, std::size_t from, std::size_t to) {
+    if (from >= to) {
+        return nullptr;
     }
+    std::size_t mid = from + (to - from) / 2;
+    AccountNode* node = nodes[mid];
+    node->left.store(linkBalanced(nodes, from, mid), std::memory_order_relaxed);
+    node->right.store(linkBalanced(nodes, mid + 1, to), std::memory_order_relaxed);
+    return node;
+}
 
-    // 1) Print left subtree
-    inorderPrintAccounts(root->left);
+} // namespace
 
-    // 2) Print current node
-    printAccountSummary(root->data);
+void rebuildBalanced(std::atomic<AccountNode*>& root, const std::vector<AccountNode*>& sorted) {
+    root.store(linkBalanced(sorted, 0, sorted.size()));
+}
 
-    // 3) Print right subtree
-    inorderPrintAccounts(root->right);
+void freeAccountNode(AccountNode* node) {
+    freeHistory(node->data.history);
+    freeVelocityState(node->data.velocity);
+    freeAccountVersions(node);
+    delete node;
+}
+
+void printAccountSummary(const Account& account, double balance) {
+    std::cout << "Account #" << account.accountNumber
+              << " | Holder: " << account.holderName
+              << " | Balance: " << balance
+              << '\n';
 }
 
-void freeAccountTree(AccountNode*& root) {
-    if (root == nullptr) {
+void freeAccountTree(std::atomic<AccountNode*>& root) {
+    AccountNode* node = root.load();
+    if (node == nullptr) {
         return;
     }
 
     // Post-order traversal: free children first.
-    freeAccountTree(root->left);
-    freeAccountTree(root->right);
+    freeAccountTree(node->left);
+    freeAccountTree(node->right);
 
-    // Free the transaction history list for this account.
-    freeTransactions(root->data.historyHead);
+    // Free the in-memory part of this account's history, its velocity
+    // windows and its versions.
+    freeHistory(node->data.history);
+    freeVelocityState(node->data.velocity);
+    freeAccountVersions(node);
 
     // Then free the node itself.
-    delete root;
-    root = nullptr;
+    delete node;
+    root.store(nullptr);
 }
 
 } // namespace bank
@@ -0,0 +1,167 @@
+#include "account_radix.h"
+
+namespace bank {
+
+namespace {
+
+constexpr unsigned kLeafMask = (1u << kRadixLeafBits) - 1;
+constexpr unsigned kMidMask  = (1u << kRadixMidBits) - 1;
+
+unsigned topIndex(int accountNumber) {
+    return static_cast<unsigned>(accountNumber) >> (kRadixMidBits + kRadixLeafBits);
+}
+
+unsigned midIndex(int accountNumber) {
+    return (static_cast<unsigned>(accountNumber) >> kRadixLeafBits) & kMidMask;
+}
+
+unsigned leafIndex(int accountNumber) {
+    return static_cast<unsigned>(accountNumber) & kLeafMask;
+}
+
+/// The slot of this number, or nullptr if its pages do not exist (yet).
+std::atomic<AccountNode*>* findSlot(const RadixTree& tree, int accountNumber) {
+    if (accountNumber <= 0) {
+        return nullptr;
+    }
+    RadixMid* mid = tree.mids[topIndex(accountNumber)].load(std::memory_order_acquire);
+    if (!mid) {
+        return nullptr;
+    }
+    RadixLeaf* leaf = mid->leaves[midIndex(accountNumber)].load(std::memory_order_acquire);
+    if (!leaf) {
+        return nullptr;
+    }
+    return &leaf->slots[leafIndex(accountNumber)];
+}
+
+/// The slot of this number, allocating its pages. Writers only
+/// (serialized): a page is published once it is fully zeroed.
+std::atomic<AccountNode*>& slotFor(RadixTree& tree, int accountNumber) {
+    std::atomic<RadixMid*>& midSlot = tree.mids[topIndex(accountNumber)];
+    RadixMid* mid = midSlot.load(std::memory_order_relaxed);
+    if (!mid) {
+        mid = new RadixMid();
+        midSlot.store(mid, std::memory_order_release);
+    }
+    std::atomic<RadixLeaf*>& leafSlot = mid->leaves[midIndex(accountNumber)];
+    RadixLeaf* leaf = leafSlot.load(std::memory_order_relaxed);
+    if (!leaf) {
+        leaf = new RadixLeaf();
+        leafSlot.store(leaf, std::memory_order_release);
+    }
+    return leaf->slots[leafIndex(accountNumber)];
+}
+
+} // namespace
+
+AccountNode* radixFind(const RadixTree& tree, int accountNumber) {
+    std::atomic<AccountNode*>* slot = findSlot(tree, accountNumber);
+    if (!slot) {
+        return nullptr;
+    }
+    AccountNode* node = slot->load(std::memory_order_acquire);
+    if (node && node->closed.load(std::memory_order_acquire)) {
+        return nullptr;
+    }
+    return node;
+}
+
+AccountNode* radixInsert(RadixTree& tree,
+                         int accountNumber,
+                         PooledName name,
+                         double initialBalance,
+                         bool& inserted,
+                         std::size_t interestApplied,
+                         double interestFactor) {
+    inserted = false;
+    if (accountNumber <= 0) {
+        return nullptr;
+    }
+
+    std::atomic<AccountNode*>& slot = slotFor(tree, accountNumber);
+    AccountNode* current = slot.load(std::memory_order_relaxed);
+    if (current && !current->closed.load(std::memory_order_acquire)) {
+        return current;   // do not insert a duplicate
+    }
+
+    // A closed node still in the slot belongs to a closure that unlinks
+    // it next (radixUnlink only clears a slot holding that very node).
+    AccountNode* node = new AccountNode(accountNumber, name, initialBalance);
+    node->data.interestApplied = interestApplied;
+    node->data.interestFactor  = interestFactor;
+
+    // Publish only the fully built node, as insertAccount does.
+    slot.store(node, std::memory_order_release);
+    inserted = true;
+    return node;
+}
+
+bool radixUnlink(RadixTree& tree, AccountNode* node) {
+    if (std::atomic<AccountNode*>* slot = findSlot(tree, node->data.accountNumber)) {
+        if (slot->load(std::memory_order_relaxed) == node) {
+            slot->store(nullptr, std::memory_order_release);
+        }
+    }
+    return true;
+}
+
+void radixRebuild(RadixTree& tree, const std::vector<AccountNode*>& sorted) {
+    for (std::atomic<RadixMid*>& midSlot : tree.mids) {
+        RadixMid* mid = midSlot.load(std::memory_order_relaxed);
+        if (!mid) continue;
+        for (std::atomic<RadixLeaf*>& leafSlot : mid->leaves) {
+            RadixLeaf* leaf = leafSlot.load(std::memory_order_relaxed);
+            if (!leaf) continue;
+            for (std::atomic<AccountNode*>& slot : leaf->slots) {
+                slot.store(nullptr, std::memory_order_relaxed);
+            }
+        }
+    }
+    for (AccountNode* node : sorted) {
+        slotFor(tree, node->data.accountNumber).store(node, std::memory_order_release);
+    }
+}
+
+bool radixEmpty(const RadixTree& tree) {
+    bool empty = true;
+    auto visit = [&](AccountNode*) { empty = false; };
+    forEachRadixNode(tree, visit);
+    return empty;
+}
+
+std::size_t radixTreeBytes(const RadixTree& tree) {
+    std::size_t bytes = 0;
+    for (const std::atomic<RadixMid*>& midSlot : tree.mids) {
+        const RadixMid* mid = midSlot.load(std::memory_order_acquire);
+        if (!mid) continue;
+        bytes += sizeof(RadixMid);
+        for (const std::atomic<RadixLeaf*>& leafSlot : mid->leaves) {
+            if (leafSlot.load(std::memory_order_acquire)) {
+                bytes += sizeof(RadixLeaf);
+            }
+        }
+    }
+    return bytes;
+}
+
+void freeRadixTree(RadixTree& tree) {
+    for (std::atomic<RadixMid*>& midSlot : tree.mids) {
+        RadixMid* mid = midSlot.load();
+        if (!mid) continue;
+        for (std::atomic<RadixLeaf*>& leafSlot : mid->leaves) {
+            RadixLeaf* leaf = leafSlot.load();
+            if (!leaf) continue;
+            for (std::atomic<AccountNode*>& slot : leaf->slots) {
+                if (AccountNode* node = slot.load()) {
+                    freeAccountNode(node);
+                }
+            }
+            delete leaf;
+        }
+        delete mid;
+        midSlot.store(nullptr);
+    }
+}
+
+} // namespace bank
@@ -0,0 +1,138 @@
+#include "balance_index.h"
+
+#include <limits>
+#include <mutex>
+#include <queue>
+
+namespace bank {
+
+namespace {
+
+using EntrySet = std::set<BalanceIndexEntry, BalanceIndexLess>;
+
+BalanceIndexStripe& stripeOf(BalanceIndex& index, int accountNumber) {
+    // Account numbers are positive (createAccount rejects the rest).
+    return index.stripes[static_cast<unsigned>(accountNumber) % kBalanceIndexStripes];
+}
+
+/// Shared locks on every stripe, taken in stripe order, for one query.
+struct AllStripesLock {
+    explicit AllStripesLock(const BalanceIndex& index) : index(&index) {
+        for (const BalanceIndexStripe& stripe : index.stripes) {
+            stripe.mutex.lock_shared();
+        }
+    }
+    ~AllStripesLock() {
+        for (const BalanceIndexStripe& stripe : index->stripes) {
+            stripe.mutex.unlock_shared();
+        }
+    }
+
+    AllStripesLock(const AllStripesLock&) = delete;
+    AllStripesLock& operator=(const AllStripesLock&) = delete;
+
+    const BalanceIndex* index{nullptr};
+};
+
+/// Position of one stripe in a k-way merge.
+template <typename Iterator>
+struct Cursor {
+    Iterator it;
+    Iterator end;
+};
+
+/// Merges the stripe ranges [cursor.it, cursor.end) in the order given by
+/// `before`, stopping after `limit` entries.
+template <typename Iterator, typename Before>
+std::vector<AccountNode*> mergeStripes(std::vector<Cursor<Iterator>> cursors,
+                                       std::size_t limit,
+                                       Before before) {
+    auto later = [&](std::size_t a, std::size_t b) {
+        return before(*cursors[b].it, *cursors[a].it);
+    };
+    std::priority_queue<std::size_t, std::vector<std::size_t>, decltype(later)> heads(later);
+    for (std::size_t i = 0; i < cursors.size(); ++i) {
+        if (cursors[i].it != cursors[i].end) {
+            heads.push(i);
+        }
+    }
+
+    std::vector<AccountNode*> out;
+    while (!heads.empty() && out.size() < limit) {
+        std::size_t i = heads.top();
+        heads.pop();
+        out.push_back(cursors[i].it->node);
+        if (++cursors[i].it != cursors[i].end) {
+            heads.push(i);
+        }
+    }
+    return out;
+}
+
+} // namespace
+
+void balanceIndexInsert(BalanceIndex& index, AccountNode* node, double key) {
+    const int number = node->data.accountNumber;
+    BalanceIndexStripe& stripe = stripeOf(index, number);
+    std::unique_lock<std::shared_mutex> guard(stripe.mutex);
+    stripe.entries.insert(BalanceIndexEntry{key, number, node});
+}
+
+void balanceIndexErase(BalanceIndex& index, AccountNode* node, double key) {
+    const int number = node->data.accountNumber;
+    BalanceIndexStripe& stripe = stripeOf(index, number);
+    std::unique_lock<std::shared_mutex> guard(stripe.mutex);
+    stripe.entries.erase(BalanceIndexEntry{key, number, node});
+}
+
+void balanceIndexUpdate(BalanceIndex& index, AccountNode* node, double oldKey, double newKey) {
+    const int number = node->data.accountNumber;
+    BalanceIndexStripe& stripe = stripeOf(index, number);
+    std::unique_lock<std::shared_mutex> guard(stripe.mutex);
+
+    // Reuse the set node instead of freeing and allocating one.
+    auto handle = stripe.entries.extract(BalanceIndexEntry{oldKey, number, node});
+    if (handle.empty()) {
+        stripe.entries.insert(BalanceIndexEntry{newKey, number, node});
+        return;
+    }
+    handle.value().key = newKey;
+    stripe.entries.insert(std::move(handle));
+}
+
+std::vector<AccountNode*> balanceIndexTop(const BalanceIndex& index, std::size_t n) {
+    AllStripesLock guard(index);
+
+    using Iterator = EntrySet::const_reverse_iterator;
+    std::vector<Cursor<Iterator>> cursors;
+    for (const BalanceIndexStripe& stripe : index.stripes) {
+        cursors.push_back({stripe.entries.rbegin(), stripe.entries.rend()});
+    }
+    return mergeStripes(std::move(cursors), n,
+                        [](const BalanceIndexEntry& a, const BalanceIndexEntry& b) {
+                            return BalanceIndexLess()(b, a);   // largest first
+                        });
+}
+
+std::vector<AccountNode*> balanceIndexRange(const BalanceIndex& index, double low, double high) {
+    AllStripesLock guard(index);
+
+    using Iterator = EntrySet::const_iterator;
+    std::vector<Cursor<Iterator>> cursors;
+    // Account numbers are > 0, so these bound every entry with such keys.
+    const BalanceIndexEntry from{low, 0, nullptr};
+    const BalanceIndexEntry to{high, std::numeric_limits<int>::max(), nullptr};
+    for (const BalanceIndexStripe& stripe : index.stripes) {
+        cursors.push_back({stripe.entries.lower_bound(from), stripe.entries.upper_bound(to)});
+    }
+    return mergeStripes(std::move(cursors), static_cast<std::size_t>(-1), BalanceIndexLess());
+}
+
+void clearBalanceIndex(BalanceIndex& index) {
+    for (BalanceIndexStripe& stripe : index.stripes) {
+        std::unique_lock<std::shared_mutex> guard(stripe.mutex);
+        stripe.entries.clear();
+    }
+}
+
+} // namespace bank
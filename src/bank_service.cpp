@@ -1,249 +1,1750 @@
 #include "bank_service.h"
 
+#include "persistence.h"
+#include "snapshot.h"
+#include "stats.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <mutex>
+#include <numeric>
+#include <shared_mutex>
 
 namespace bank {
 
-void initBank(Bank& bank) {
-    bank.accountsRoot = nullptr;
-    initQueue(bank.pendingQueue);
+template <typename BankT>
+void initBank(BankT& bank) {
+    BankT::Index::init(bank.accountsRoot);
+    BankT::Queue::init(bank.pendingQueue);
+    BankT::History::openStore(bank.historyStore);
 }
 
-void destroyBank(Bank& bank) {
-    freeAccountTree(bank.accountsRoot);   // frees all accounts + histories
-    freeQueue(bank.pendingQueue);         // frees any remaining pending transactions
-    bank.accountsRoot = nullptr;
+template <typename BankT>
+void destroyBank(BankT& bank) {
+    clearBalanceIndex(bank.balanceIndex); // points into the tree
+    clearNameIndex(bank.nameIndex);       // likewise
+    BankT::Index::clear(bank.accountsRoot);         // frees all accounts + histories
+    freeNamePool(bank.namePool);                   // holder names of those accounts
+    BankT::Queue::clear(bank.pendingQueue);         // frees any remaining pending transactions
+    destroyEpochManager(bank.epochs);              // frees retired versions + spilled history
+    delete bank.velocityRules.exchange(nullptr);   // rule sets before it were retired
+    clearIdempotency(bank.idempotency);            // remembered request keys
+    BankT::History::closeStore(bank.historyStore);  // drops the on-disk cold history
 }
 
-bool createAccount(Bank& bank,
-                   int accountNumber,
-                   const std::string& holderName,
-                   double initialBalance) {
+namespace {
+
+/// atomic<double> has no fetch_add before C++20.
+void addToTotal(std::atomic<double>& total, double delta) {
+    double current = total.load(std::memory_order_relaxed);
+    while (!total.compare_exchange_weak(current, current + delta,
+                                        std::memory_order_relaxed)) {
+        // current was reloaded; retry
+    }
+}
+
+/// Date part (YYYYMMDD) of a datetime.
+long long dayOf(const std::string& datetime) {
+    return toTimeKey(datetime) / 1000000;
+}
+
+/// Adds a deposit to the sum of today's deposits; the first deposit of a
+/// new day starts the sum over.
+template <typename BankT>
+void recordDeposit(BankT& bank, double amount, const std::string& datetime) {
+    const long long day = dayOf(datetime);
+    AggregateCounters& agg = bank.aggregates;
+    std::lock_guard<std::mutex> guard(agg.dayMutex);
+    if (day > agg.day) {
+        agg.day = day;
+        agg.depositedToday = 0.0;
+    }
+    if (day == agg.day) {
+        agg.depositedToday += amount;
+    }
+}
+
+/// Normalized balance of an account: the key of the balance index and
+/// its share of AggregateCounters::normalizedTotal.
+double normalizedBalance(const Account& acc) {
+    return acc.balance / acc.interestFactor;
+}
+
+/// Remembers an account's balance and, on destruction, folds whatever
+/// changed since into the bank aggregates and the balance index. Declare
+/// it after the node lock guard so it runs while the lock is still held.
+template <typename BankT>
+struct BalanceChange {
+    BalanceChange(BankT& bank, AccountNode* node)
+        : bank(bank),
+          node(node),
+          before(node ? node->data.balance : 0.0),
+          beforeKey(node ? normalizedBalance(node->data) : 0.0) {}
+
+    ~BalanceChange() {
+        if (!node) {
+            return;
+        }
+        // Interest alone leaves the normalized balance unchanged (up to
+        // rounding, which is carried over exactly).
+        const double after = node->data.balance;
+        const double afterKey = normalizedBalance(node->data);
+        if (afterKey != beforeKey) {
+            addToTotal(bank.aggregates.normalizedTotal, afterKey - beforeKey);
+            balanceIndexUpdate(bank.balanceIndex, node, beforeKey, afterKey);
+        }
+        int signChange = (after <= 0.0 ? 1 : 0) - (before <= 0.0 ? 1 : 0);
+        if (signChange != 0) {
+            bank.aggregates.nonPositiveCount.fetch_add(signChange);
+        }
+    }
+
+    BalanceChange(const BalanceChange&) = delete;
+    BalanceChange& operator=(const BalanceChange&) = delete;
+
+    BankT&       bank;
+    AccountNode* node;
+    double       before;
+    double       beforeKey;
+};
+
+/// Sum of the deposits in a history dated `day` (YYYYMMDD). Only the
+/// tail of the history from that day on is read.
+template <typename BankT>
+double depositsOnDay(const BankT& bank, const HistoryView& history, long long day) {
+    double sum = 0.0;
+    long long first = findFirstEntryAtOrAfter(bank.historyStore, history, day * 1000000);
+    forEachHistoryEntryInRange(bank.historyStore, history, first, history.size,
+                               [&](long long, const Transaction& tx) {
+                                   if (tx.type == TransactionType::Deposit &&
+                                       dayOf(tx.datetime) == day) {
+                                       sum += tx.amount;
+                                   }
+                               });
+    return sum;
+}
+
+} // namespace
+
+template <typename BankT>
+OperationStatus addAccount(BankT& bank,
+                           int accountNumber,
+                           const std::string& holderName,
+                           double initialBalance) {
+    StatTimer timer(StatOp::Create);
     if (accountNumber <= 0) {
-        std::cout << "Account number must be positive.\n";
-        return false;
+        return timer.done(OperationStatus::InvalidAccountNumber);
     }
     if (initialBalance < 0.0) {
-        std::cout << "Initial balance cannot be negative.\n";
-        return false;
+        return timer.done(OperationStatus::InvalidAmount);
     }
 
     bool inserted = false;
-    insertAccount(bank.accountsRoot,
-                  accountNumber,
-                  holderName,
-                  initialBalance,
-                  inserted);
+    {
+        // Readers never take this lock; only other creations wait.
+        std::lock_guard<std::mutex> guard(bank.insertMutex);
+        if (BankT::Index::find(bank.accountsRoot, accountNumber)) {
+            // Checked first so a duplicate adds no name to the pool.
+            return timer.done(OperationStatus::DuplicateAccount);
+        }
 
-    if (!inserted) {
-        std::cout << "Account #" << accountNumber << " already exists.\n";
+        // A new account is not owed interest posted before it existed.
+        std::size_t interestApplied = 0;
+        double interestFactor = 1.0;
+        {
+            std::shared_lock<std::shared_mutex> interestGuard(bank.interestMutex);
+            interestApplied = bank.interestEpochs.size();
+            interestFactor  = bank.interestFactor.load();
+        }
+
+        AccountNode* node = BankT::Index::insert(bank.accountsRoot,
+                                                accountNumber,
+                                                internName(bank.namePool, holderName),
+                                                initialBalance,
+                                                inserted,
+                                                interestApplied,
+                                                interestFactor);
+        if (inserted) {
+            // Snapshots taken before this commit do not see the account.
+            std::lock_guard<std::mutex> nodeGuard(node->lock);
+            commitAccount(bank.epochs, node);
+
+            const double key = normalizedBalance(node->data);
+            balanceIndexInsert(bank.balanceIndex, node, key);
+            nameIndexInsert(bank.nameIndex, bank.namePool, node);
+
+            AggregateCounters& agg = bank.aggregates;
+            agg.accountCount.fetch_add(1);
+            addToTotal(agg.normalizedTotal, key);
+            if (initialBalance <= 0.0) {
+                agg.nonPositiveCount.fetch_add(1);
+            }
+        }
     }
 
-    return inserted;
+    return timer.done(inserted ? OperationStatus::Ok : OperationStatus::DuplicateAccount);
 }
 
-bool depositDirect(Bank& bank,
+template <typename BankT>
+bool createAccount(BankT& bank,
                    int accountNumber,
-                   double amount) {
-    if (amount <= 0.0) {
-        std::cout << "Deposit amount must be positive.\n";
-        return false;
+                   const std::string& holderName,
+                   double initialBalance) {
+    switch (addAccount(bank, accountNumber, holderName, initialBalance)) {
+        case OperationStatus::Ok:
+            return true;
+        case OperationStatus::InvalidAccountNumber:
+            std::cout << "Account number must be positive.\n";
+            return false;
+        case OperationStatus::InvalidAmount:
+            std::cout << "Initial balance cannot be negative.\n";
+            return false;
+        default:
+            std::cout << "Account #" << accountNumber << " already exists.\n";
+            return false;
+    }
+}
+
+namespace {
+
+/// Applies the interest postings the account has not caught up on yet,
+/// in order, exactly as an immediate walk would have. Caller holds the
+/// node lock and commits if this returns true.
+/// @return true if the account changed.
+template <typename BankT>
+bool accruePendingInterest(BankT& bank, Account& acc) {
+    if (acc.interestApplied == bank.interestEpochCount.load(std::memory_order_acquire)) {
+        return false;   // common case: nothing posted since, no lock
+    }
+
+    std::shared_lock<std::shared_mutex> guard(bank.interestMutex);
+    for (; acc.interestApplied < bank.interestEpochs.size(); ++acc.interestApplied) {
+        const InterestEpoch& epoch = bank.interestEpochs[acc.interestApplied];
+        double interest = acc.balance * epoch.rate;
+        if (interest != 0.0) {
+            acc.balance += interest;
+            BankT::History::append(bank.historyStore,
+                                  acc.history,
+                                  TransactionType::Interest,
+                                  interest,
+                                  acc.balance,
+                                  epoch.datetime);
+        }
+        acc.interestFactor = epoch.factor;
+    }
+    return true;
+}
+
+/// Materializes an account's pending interest and publishes the result.
+/// Only locks the account if something is pending.
+/// @return true if there was pending interest.
+template <typename BankT>
+bool materializeInterest(BankT& bank, AccountNode* node) {
+    {
+        ReadSnapshot snapshot(bank.epochs);
+        const AccountVersion* version = versionAt(snapshot, node);
+        if (!version ||
+            version->interestApplied == bank.interestEpochCount.load(std::memory_order_acquire)) {
+            return false;
+        }
     }
 
-    AccountNode* node = searchAccount(bank.accountsRoot, accountNumber);
+    std::lock_guard<std::mutex> guard(node->lock);
+    if (node->closing.load(std::memory_order_relaxed)) {
+        return false;   // closed meanwhile
+    }
+    BalanceChange change(bank, node);
+    if (!accruePendingInterest(bank, node->data)) {
+        return false;   // someone else caught it up meanwhile
+    }
+    commitAccount(bank.epochs, node);
+    return true;
+}
+
+/// Checks money leaving an account (a withdrawal or an outgoing transfer)
+/// against the bank's velocity rules and counts it (see velocity.h).
+///
+/// Windows missing for the current rules (none yet since the account was
+/// loaded, or built for older rules) are first rebuilt from the
+/// withdrawals and outgoing transfers in the history, so a restart or a
+/// rule change never hands out a fresh allowance. The caller holds the
+/// account lock and is pinned (so the rule set stays alive).
+template <typename BankT>
+bool admitOutgoing(BankT& bank, Account& account, double amount) {
+    const VelocityRuleSet* rules = bank.velocityRules.load(std::memory_order_acquire);
+    if (!rules) {
+        return true;
+    }
+    const long long now = velocityNow();
+
+    if (!velocityStateCurrent(*rules, account.velocity)) {
+        resetVelocityState(*rules, account.velocity, now);
+        const HistoryView view = viewOf(account.history);
+        const long long since = epochToTimeKey(now - velocityLookback(*rules));
+        const long long first = findFirstEntryAtOrAfter(bank.historyStore, view, since);
+        forEachHistoryEntryInRange(bank.historyStore, view, first, view.size,
+                                   [&](long long, const Transaction& tx) {
+            if (tx.type == TransactionType::Withdraw || tx.type == TransactionType::TransferOut) {
+                recordPastWithdrawal(*rules, *account.velocity, tx.amount,
+                                     toEpochSeconds(tx.datetime));
+            }
+        });
+    }
+    return admitVelocity(*rules, account.velocity, amount, now);
+}
+
+/// Validates and applies one deposit / withdrawal to an already looked-up
+/// account (node may be nullptr if the lookup failed).
+/// On success updates the balance and appends the history entry.
+template <typename BankT>
+OperationStatus applyOperation(BankT& bank,
+                               AccountNode* node,
+                               TransactionType type,
+                               double amount,
+                               const std::string& datetime) {
+    if (amount <= 0.0) {
+        return OperationStatus::InvalidAmount;
+    }
     if (!node) {
-        std::cout << "Account #" << accountNumber << " not found.\n";
-        return false;
+        return OperationStatus::AccountNotFound;
     }
 
-    // Update balance.
-    node->data.balance += amount;
+    if (type == TransactionType::Deposit) {
+        node->data.balance += amount;
+        recordDeposit(bank, amount, datetime);
+    } else if (type == TransactionType::Withdraw) {
+        if (node->data.balance < amount) {
+            return OperationStatus::InsufficientFunds;
+        }
+        if (!admitOutgoing(bank, node->data, amount)) {
+            return OperationStatus::VelocityLimitExceeded;
+        }
+        node->data.balance -= amount;
+    } else {
+        return OperationStatus::InvalidType;
+    }
 
     // Record transaction.
+    BankT::History::append(bank.historyStore,
+                          node->data.history,
+                          type,
+                          amount,
+                          node->data.balance,
+                          datetime);
+    return OperationStatus::Ok;
+}
+
+} // namespace
+
+const char* operationStatusName(OperationStatus status) {
+    switch (status) {
+        case OperationStatus::Ok:                   return "ok";
+        case OperationStatus::InvalidAmount:        return "invalid_amount";
+        case OperationStatus::AccountNotFound:      return "not_found";
+        case OperationStatus::InsufficientFunds:    return "insufficient_funds";
+        case OperationStatus::InvalidType:          return "invalid_type";
+        case OperationStatus::SameAccount:          return "same_account";
+        case OperationStatus::ArchiveFailed:        return "archive_failed";
+        case OperationStatus::InvalidAccountNumber: return "invalid_account";
+        case OperationStatus::DuplicateAccount:     return "duplicate";
+        case OperationStatus::VelocityLimitExceeded: return "limit_exceeded";
+        case OperationStatus::RequestInProgress:    return "in_progress";
+        case OperationStatus::IdempotencyKeyReused: return "key_reused";
+        case OperationStatus::TransferSuspended:    return "suspended";
+        default:                                    return "unknown";
+    }
+}
+
+template <typename BankT>
+std::vector<OperationStatus> applyBatch(BankT& bank,
+                                        const BatchOperation* ops,
+                                        std::size_t count) {
+    std::vector<OperationStatus> results(count, OperationStatus::Ok);
+    if (count == 0) {
+        return results;
+    }
+    const std::uint64_t statsStart = statsNow();
+
+    // 1) Group by account; stable so one account's operations keep their order.
+    std::vector<std::size_t> order(count);
+    std::iota(order.begin(), order.end(), std::size_t{0});
+    if (count > 1) {
+        std::stable_sort(order.begin(), order.end(),
+                         [ops](std::size_t a, std::size_t b) {
+                             return ops[a].accountNumber < ops[b].accountNumber;
+                         });
+    }
+
+    // 2) One timestamp for the whole batch.
     const std::string datetime = getCurrentDateTime();
-    addTransaction(node->data.historyHead,
-                   TransactionType::Deposit,
-                   amount,
-                   datetime);
 
-    std::cout << "Deposited " << amount << " to account #" << accountNumber << ".\n";
-    return true;
+    // 3) One BST lookup per account, then apply its operations in order.
+    //    Pinned, so no node found here is freed by a closure meanwhile.
+    ReadSnapshot pin(bank.epochs);
+    std::size_t i = 0;
+    while (i < count) {
+        const int accountNumber = ops[order[i]].accountNumber;
+        AccountNode* node = BankT::Index::find(bank.accountsRoot, accountNumber);
+
+        std::unique_lock<std::mutex> guard;
+        if (node) {
+            guard = std::unique_lock<std::mutex>(node->lock);
+            if (node->closing.load(std::memory_order_relaxed)) {
+                guard.unlock();   // closed between lookup and lock
+                node = nullptr;
+            }
+        }
+        BalanceChange change(bank, node);
+        // Interest posted since the last change comes first, as it would
+        // have with an immediate walk.
+        bool changed = node && accruePendingInterest(bank, node->data);
+        for (; i < count && ops[order[i]].accountNumber == accountNumber; ++i) {
+            const BatchOperation& op = ops[order[i]];
+            results[order[i]] = applyOperation(bank, node, op.type, op.amount, datetime);
+            changed = changed || results[order[i]] == OperationStatus::Ok;
+        }
+
+        // One new version per account, not per operation.
+        if (changed) {
+            commitAccount(bank.epochs, node);
+        }
+    }
+    recordBatchStats(ops, results.data(), count, statsNow() - statsStart);
+    return results;
+}
+
+template <typename BankT>
+std::vector<OperationStatus> applyBatch(BankT& bank,
+                                        const std::vector<BatchOperation>& ops) {
+    return applyBatch(bank, ops.data(), ops.size());
+}
+
+template <typename BankT>
+OperationStatus runIdempotent(BankT& bank,
+                              const std::string& key,
+                              std::uint64_t fingerprint,
+                              const std::function<OperationStatus()>& apply) {
+    if (key.empty()) {
+        return apply();
+    }
+
+    OperationStatus outcome = OperationStatus::Ok;
+    switch (claimIdempotencyKey(bank.idempotency, key, fingerprint, idempotencyNow(), outcome)) {
+        case IdempotencyClaim::Done:
+            return outcome;   // a retry: answered without applying it again
+        case IdempotencyClaim::InProgress:
+            return OperationStatus::RequestInProgress;
+        case IdempotencyClaim::Mismatch:
+            return OperationStatus::IdempotencyKeyReused;
+        case IdempotencyClaim::New:
+            break;
+    }
+    try {
+        outcome = apply();
+    } catch (...) {
+        releaseIdempotencyKey(bank.idempotency, key);   // never finished: let a retry run it
+        throw;
+    }
+    completeIdempotencyKey(bank.idempotency, key, outcome);
+    return outcome;
 }
 
-bool withdrawDirect(Bank& bank,
+template <typename BankT>
+void configureIdempotency(BankT& bank, std::size_t capacity, long long ttlSeconds) {
+    configureIdempotency(bank.idempotency, capacity, ttlSeconds);
+}
+
+template <typename BankT>
+bool depositDirect(BankT& bank,
+                   int accountNumber,
+                   double amount,
+                   const std::string& idempotencyKey) {
+    BatchOperation op{accountNumber, TransactionType::Deposit, amount};
+
+    const std::uint64_t fingerprint = requestFingerprint("deposit", accountNumber, 0, amount);
+    OperationStatus status = runIdempotent(bank, idempotencyKey, fingerprint, [&] {
+        return applyBatch(bank, &op, 1).front();
+    });
+    switch (status) {
+        case OperationStatus::Ok:
+            std::cout << "Deposited " << amount << " to account #" << accountNumber << ".\n";
+            return true;
+        case OperationStatus::InvalidAmount:
+            std::cout << "Deposit amount must be positive.\n";
+            return false;
+        case OperationStatus::AccountNotFound:
+            std::cout << "Account #" << accountNumber << " not found.\n";
+            return false;
+        case OperationStatus::RequestInProgress:
+            std::cout << "Request '" << idempotencyKey << "' is still being processed.\n";
+            return false;
+        case OperationStatus::IdempotencyKeyReused:
+            std::cout << "Request key '" << idempotencyKey << "' was used for another request.\n";
+            return false;
+        default:
+            std::cout << "Deposit to account #" << accountNumber << " failed ("
+                      << operationStatusName(status) << ").\n";
+            return false;
+    }
+}
+
+template <typename BankT>
+bool withdrawDirect(BankT& bank,
                     int accountNumber,
-                    double amount) {
+                    double amount,
+                    const std::string& idempotencyKey) {
+    BatchOperation op{accountNumber, TransactionType::Withdraw, amount};
+
+    const std::uint64_t fingerprint = requestFingerprint("withdraw", accountNumber, 0, amount);
+    OperationStatus status = runIdempotent(bank, idempotencyKey, fingerprint, [&] {
+        return applyBatch(bank, &op, 1).front();
+    });
+    switch (status) {
+        case OperationStatus::Ok:
+            std::cout << "Withdrew " << amount << " from account #" << accountNumber << ".\n";
+            return true;
+        case OperationStatus::InvalidAmount:
+            std::cout << "Withdrawal amount must be positive.\n";
+            return false;
+        case OperationStatus::InsufficientFunds:
+            std::cout << "Insufficient funds in account #" << accountNumber << ".\n";
+            return false;
+        case OperationStatus::VelocityLimitExceeded:
+            std::cout << "Withdrawal limit reached for account #" << accountNumber << ".\n";
+            return false;
+        case OperationStatus::AccountNotFound:
+            std::cout << "Account #" << accountNumber << " not found.\n";
+            return false;
+        case OperationStatus::RequestInProgress:
+            std::cout << "Request '" << idempotencyKey << "' is still being processed.\n";
+            return false;
+        case OperationStatus::IdempotencyKeyReused:
+            std::cout << "Request key '" << idempotencyKey << "' was used for another request.\n";
+            return false;
+        default:
+            std::cout << "Withdrawal from account #" << accountNumber << " failed ("
+                      << operationStatusName(status) << ").\n";
+            return false;
+    }
+}
+
+template <typename BankT>
+OperationStatus transferFunds(BankT& bank,
+                              int fromAccount,
+                              int toAccount,
+                              double amount,
+                              long long transferId) {
     if (amount <= 0.0) {
-        std::cout << "Withdrawal amount must be positive.\n";
-        return false;
+        return OperationStatus::InvalidAmount;
+    }
+    if (fromAccount == toAccount) {
+        return OperationStatus::SameAccount;
     }
 
-    AccountNode* node = searchAccount(bank.accountsRoot, accountNumber);
-    if (!node) {
-        std::cout << "Account #" << accountNumber << " not found.\n";
-        return false;
+    ReadSnapshot pin(bank.epochs);
+    AccountNode* from = BankT::Index::find(bank.accountsRoot, fromAccount);
+    AccountNode* to   = BankT::Index::find(bank.accountsRoot, toAccount);
+    if (!from || !to) {
+        return OperationStatus::AccountNotFound;
     }
 
-    if (node->data.balance < amount) {
-        std::cout << "Insufficient funds in account #" << accountNumber << ".\n";
-        return false;
+    // Global lock order: smaller account number first.
+    AccountNode* first  = fromAccount < toAccount ? from : to;
+    AccountNode* second = fromAccount < toAccount ? to : from;
+    std::lock_guard<std::mutex> firstGuard(first->lock);
+    std::lock_guard<std::mutex> secondGuard(second->lock);
+    if (from->closing.load(std::memory_order_relaxed) ||
+        to->closing.load(std::memory_order_relaxed)) {
+        return OperationStatus::AccountNotFound;
     }
+    BalanceChange fromChange(bank, from);
+    BalanceChange toChange(bank, to);
+
+    AccountNode* changed[] = {first, second};
+    bool accrued = accruePendingInterest(bank, from->data);
+    accrued = accruePendingInterest(bank, to->data) || accrued;
 
-    node->data.balance -= amount;
+    if (from->data.balance < amount) {
+        if (accrued) {
+            commitAccounts(bank.epochs, changed, 2);
+        }
+        return OperationStatus::InsufficientFunds;
+    }
+    if (!admitOutgoing(bank, from->data, amount)) {
+        if (accrued) {
+            commitAccounts(bank.epochs, changed, 2);
+        }
+        return OperationStatus::VelocityLimitExceeded;
+    }
 
+    if (transferId == 0) {
+        transferId = bank.nextTransferId.fetch_add(1);
+    }
     const std::string datetime = getCurrentDateTime();
-    addTransaction(node->data.historyHead,
-                   TransactionType::Withdraw,
-                   amount,
-                   datetime);
 
-    std::cout << "Withdrew " << amount << " from account #" << accountNumber << ".\n";
-    return true;
+    from->data.balance -= amount;
+    BankT::History::append(bank.historyStore, from->data.history,
+                          TransactionType::TransferOut, amount, from->data.balance,
+                          datetime, toAccount, transferId);
+
+    to->data.balance += amount;
+    BankT::History::append(bank.historyStore, to->data.history,
+                          TransactionType::TransferIn, amount, to->data.balance,
+                          datetime, fromAccount, transferId);
+
+    // Both halves become visible to readers together.
+    commitAccounts(bank.epochs, changed, 2);
+
+    return OperationStatus::Ok;
 }
 
-bool enqueuePendingTransaction(Bank& bank,
-                               int accountNumber,
-                               TransactionType type,
-                               double amount) {
+template <typename BankT>
+OperationStatus sendTransfer(BankT& bank,
+                             int fromAccount,
+                             int toAccount,
+                             double amount,
+                             long long transferId,
+                             const std::string& datetime) {
     if (amount <= 0.0) {
-        std::cout << "Amount must be positive.\n";
-        return false;
+        return OperationStatus::InvalidAmount;
+    }
+    ReadSnapshot pin(bank.epochs);
+    AccountNode* from = BankT::Index::find(bank.accountsRoot, fromAccount);
+    if (!from) {
+        return OperationStatus::AccountNotFound;
     }
 
-    // Validate account exists before enqueueing.
-    AccountNode* node = searchAccount(bank.accountsRoot, accountNumber);
-    if (!node) {
-        std::cout << "Account #" << accountNumber << " not found. Cannot enqueue.\n";
-        return false;
+    std::lock_guard<std::mutex> guard(from->lock);
+    if (from->closing.load(std::memory_order_relaxed)) {
+        return OperationStatus::AccountNotFound;
+    }
+    BalanceChange change(bank, from);
+    bool accrued = accruePendingInterest(bank, from->data);
+    if (from->data.balance < amount) {
+        if (accrued) {
+            commitAccount(bank.epochs, from);
+        }
+        return OperationStatus::InsufficientFunds;
+    }
+    if (!admitOutgoing(bank, from->data, amount)) {
+        if (accrued) {
+            commitAccount(bank.epochs, from);
+        }
+        return OperationStatus::VelocityLimitExceeded;
+    }
+
+    from->data.balance -= amount;
+    BankT::History::append(bank.historyStore, from->data.history,
+                          TransactionType::TransferOut, amount, from->data.balance,
+                          datetime, toAccount, transferId);
+    commitAccount(bank.epochs, from);
+    return OperationStatus::Ok;
+}
+
+template <typename BankT>
+OperationStatus receiveTransfer(BankT& bank,
+                                int toAccount,
+                                int fromAccount,
+                                double amount,
+                                long long transferId,
+                                const std::string& datetime) {
+    if (amount <= 0.0) {
+        return OperationStatus::InvalidAmount;
+    }
+    ReadSnapshot pin(bank.epochs);
+    AccountNode* to = BankT::Index::find(bank.accountsRoot, toAccount);
+    if (!to) {
+        return OperationStatus::AccountNotFound;
+    }
+
+    std::lock_guard<std::mutex> guard(to->lock);
+    if (to->closing.load(std::memory_order_relaxed)) {
+        return OperationStatus::AccountNotFound;
+    }
+    BalanceChange change(bank, to);
+    accruePendingInterest(bank, to->data);
+    to->data.balance += amount;
+    BankT::History::append(bank.historyStore, to->data.history,
+                          TransactionType::TransferIn, amount, to->data.balance,
+                          datetime, fromAccount, transferId);
+    commitAccount(bank.epochs, to);
+    return OperationStatus::Ok;
+}
+
+template <typename BankT>
+bool transferDirect(BankT& bank,
+                    int fromAccount,
+                    int toAccount,
+                    double amount) {
+    switch (transferFunds(bank, fromAccount, toAccount, amount)) {
+        case OperationStatus::Ok:
+            std::cout << "Transferred " << amount << " from account #" << fromAccount
+                      << " to account #" << toAccount << ".\n";
+            return true;
+        case OperationStatus::InvalidAmount:
+            std::cout << "Transfer amount must be positive.\n";
+            return false;
+        case OperationStatus::SameAccount:
+            std::cout << "Cannot transfer to the same account.\n";
+            return false;
+        case OperationStatus::InsufficientFunds:
+            std::cout << "Insufficient funds in account #" << fromAccount << ".\n";
+            return false;
+        case OperationStatus::VelocityLimitExceeded:
+            std::cout << "Withdrawal limit reached for account #" << fromAccount << ".\n";
+            return false;
+        default:
+            std::cout << "Account #" << fromAccount << " or #" << toAccount
+                      << " not found.\n";
+            return false;
+    }
+}
+
+template <typename BankT>
+OperationStatus queuePendingTransaction(BankT& bank,
+                                        int accountNumber,
+                                        TransactionType type,
+                                        double amount,
+                                        const std::string& idempotencyKey) {
+    if (!idempotencyKey.empty()) {
+        const char* operation = type == TransactionType::Deposit ? "enqueue_deposit"
+                                                                 : "enqueue_withdraw";
+        const std::uint64_t fingerprint = requestFingerprint(operation, accountNumber, 0, amount);
+        return runIdempotent(bank, idempotencyKey, fingerprint, [&] {
+            return queuePendingTransaction(bank, accountNumber, type, amount);
+        });
+    }
+
+    StatTimer timer(StatOp::Enqueue);
+    if (amount <= 0.0) {
+        return timer.done(OperationStatus::InvalidAmount);
+    }
+
+    // Validate account exists before enqueueing (it may still be closed
+    // before the queue is processed; the item is skipped then).
+    bool exists = false;
+    {
+        ReadSnapshot pin(bank.epochs);
+        exists = BankT::Index::find(bank.accountsRoot, accountNumber) != nullptr;
+    }
+    if (!exists) {
+        return timer.done(OperationStatus::AccountNotFound);
     }
 
     if (type != TransactionType::Deposit &&
         type != TransactionType::Withdraw) {
-        std::cout << "Only deposit and withdraw are allowed in queue.\n";
-        return false;
+        return timer.done(OperationStatus::InvalidType);
     }
 
-    enqueue(bank.pendingQueue, accountNumber, type, amount);
-    std::cout << "Enqueued " << (type == TransactionType::Deposit ? "DEPOSIT" : "WITHDRAW")
-              << " of " << amount << " for account #" << accountNumber << ".\n";
+    {
+        std::lock_guard<std::mutex> guard(bank.queueMutex);
+        BankT::Queue::push(bank.pendingQueue, accountNumber, type, amount);
+    }
+    return timer.done(OperationStatus::Ok);
+}
 
-    return true;
+template <typename BankT>
+bool enqueuePendingTransaction(BankT& bank,
+                               int accountNumber,
+                               TransactionType type,
+                               double amount,
+                               const std::string& idempotencyKey) {
+    switch (queuePendingTransaction(bank, accountNumber, type, amount, idempotencyKey)) {
+        case OperationStatus::Ok:
+            std::cout << "Enqueued " << (type == TransactionType::Deposit ? "DEPOSIT" : "WITHDRAW")
+                      << " of " << amount << " for account #" << accountNumber << ".\n";
+            return true;
+        case OperationStatus::InvalidAmount:
+            std::cout << "Amount must be positive.\n";
+            return false;
+        case OperationStatus::InvalidType:
+            std::cout << "Only deposit and withdraw are allowed in queue.\n";
+            return false;
+        case OperationStatus::RequestInProgress:
+            std::cout << "Request '" << idempotencyKey << "' is still being processed.\n";
+            return false;
+        case OperationStatus::IdempotencyKeyReused:
+            std::cout << "Request key '" << idempotencyKey << "' was used for another request.\n";
+            return false;
+        default:
+            std::cout << "Account #" << accountNumber << " not found. Cannot enqueue.\n";
+            return false;
+    }
 }
 
-void processPendingQueue(Bank& bank) {
+namespace {
+
+/// Called by drainPendingQueue for each processed item and its outcome.
+using QueueItemVisitor = std::function<void(const PendingTransaction& pt, OperationStatus status)>;
+
+/// Items drainPendingQueue takes off the queue at a time. One trace span
+/// per phase and chunk, not per item, so a long queue does not push the
+/// rest of the trace out of the ring (kTraceRingSize).
+constexpr std::size_t kQueueChunk = 1024;
+
+/// Processes the pending queue in FIFO order, reporting every item.
+template <typename BankT>
+QueueRunSummary drainPendingQueue(BankT& bank, const QueueItemVisitor& visit) {
+    StatTimer timer(StatOp::ProcessQueue);
+    TraceSpan span("processPendingQueue");
+    QueueRunSummary summary;
+    PendingTransaction item(0, TransactionType::Deposit, 0.0);
+    std::vector<PendingTransaction> chunk;
+    std::vector<OperationStatus> statuses;
+    chunk.reserve(kQueueChunk);
+
+    while (true) {
+        // Hold the queue lock only while taking one chunk off the front.
+        chunk.clear();
+        {
+            TraceSpan dequeueSpan("queue.dequeue");
+            std::lock_guard<std::mutex> guard(bank.queueMutex);
+            while (chunk.size() < kQueueChunk && BankT::Queue::pop(bank.pendingQueue, item)) {
+                chunk.push_back(item);
+            }
+        }
+        if (chunk.empty()) {
+            break; // queue is empty
+        }
+
+        // The chunk shares one timestamp, like an applyBatch run.
+        std::string datetime;
+        {
+            TraceSpan datetimeSpan("queue.datetime");
+            datetime = getCurrentDateTime();
+        }
+
+        statuses.assign(chunk.size(), OperationStatus::AccountNotFound);
+        {
+            TraceSpan applySpan("queue.apply");
+            ReadSnapshot pin(bank.epochs);
+            for (std::size_t i = 0; i < chunk.size(); ++i) {
+                const PendingTransaction& pt = chunk[i];
+                AccountNode* node = BankT::Index::find(bank.accountsRoot, pt.accountNumber);
+                if (!node) {
+                    continue;
+                }
+                std::lock_guard<std::mutex> guard(node->lock);
+                if (!node->closing.load(std::memory_order_relaxed)) {
+                    BalanceChange change(bank, node);
+                    bool accrued = accruePendingInterest(bank, node->data);
+                    statuses[i] = applyOperation(bank, node, pt.type, pt.amount, datetime);
+                    if (statuses[i] == OperationStatus::Ok || accrued) {
+                        commitAccount(bank.epochs, node);
+                    }
+                }
+            }
+        }
+
+        for (OperationStatus status : statuses) {
+            if (status == OperationStatus::Ok) {
+                ++summary.applied;
+            } else {
+                ++summary.skipped;
+                recordFailure(StatOp::ProcessQueue, status);
+            }
+        }
+        if (visit) {
+            TraceSpan reportSpan("queue.report");
+            for (std::size_t i = 0; i < chunk.size(); ++i) {
+                visit(chunk[i], statuses[i]);
+            }
+        }
+    }
+    timer.done(true);
+    return summary;
+}
+
+} // namespace
+
+template <typename BankT>
+QueueRunSummary applyPendingQueue(BankT& bank) {
+    return drainPendingQueue(bank, {});
+}
+
+template <typename BankT>
+void processPendingQueue(BankT& bank) {
     std::cout << "\nProcessing pending queue...\n";
 
-    PendingTransaction* pt = nullptr;
+    drainPendingQueue(bank, [](const PendingTransaction& pt, OperationStatus status) {
+        if (status == OperationStatus::AccountNotFound) {
+            std::cout << "Account #" << pt.accountNumber
+                      << " not found. Skipping queued transaction.\n";
+        } else if (pt.type == TransactionType::Deposit) {
+            std::cout << "Applied queued DEPOSIT of " << pt.amount
+                      << " to account #" << pt.accountNumber << ".\n";
+        } else if (status == OperationStatus::InsufficientFunds) {
+            std::cout << "Queued WITHDRAW " << pt.amount
+                      << " from account #" << pt.accountNumber
+                      << " skipped (insufficient funds).\n";
+        } else if (status == OperationStatus::VelocityLimitExceeded) {
+            std::cout << "Queued WITHDRAW " << pt.amount
+                      << " from account #" << pt.accountNumber
+                      << " skipped (withdrawal limit reached).\n";
+        } else {
+            std::cout << "Applied queued WITHDRAW of " << pt.amount
+                      << " from account #" << pt.accountNumber << ".\n";
+        }
+    });
+
+    std::cout << "Done processing queue.\n";
+}
+
+namespace {
+
+void deleteVelocityRules(void* ptr) {
+    delete static_cast<const VelocityRuleSet*>(ptr);
+}
+
+} // namespace
 
-    while (!isQueueEmpty(bank.pendingQueue)) {
-        bool ok = dequeue(bank.pendingQueue, pt);
-        if (!ok || !pt) {
-            break; // safety
+template <typename BankT>
+bool setVelocityRules(BankT& bank, const std::vector<VelocityRule>& rules) {
+    if (rules.size() > kMaxVelocityRules) {
+        return false;
+    }
+    for (const VelocityRule& rule : rules) {
+        if (rule.windowSeconds <= 0 || rule.maxAmount < 0.0 || rule.maxCount < 0 ||
+            (rule.maxAmount == 0.0 && rule.maxCount == 0)) {
+            return false;
         }
+    }
+
+    VelocityRuleSet* set = nullptr;
+    if (!rules.empty()) {
+        set = new VelocityRuleSet();
+        set->generation = bank.velocityGeneration.fetch_add(1) + 1;
+        set->count = rules.size();
+        std::copy(rules.begin(), rules.end(), set->rules);
+    }
 
-        const std::string datetime = getCurrentDateTime();
+    // Withdrawals in flight may still read the old set: retire it.
+    const VelocityRuleSet* old = bank.velocityRules.exchange(set, std::memory_order_acq_rel);
+    if (old) {
+        retire(bank.epochs, const_cast<VelocityRuleSet*>(old), deleteVelocityRules);
+    }
+    return true;
+}
 
-        AccountNode* node = searchAccount(bank.accountsRoot, pt->accountNumber);
+template <typename BankT>
+std::vector<VelocityRule> getVelocityRules(const BankT& bank) {
+    ReadSnapshot pin(bank.epochs);
+    const VelocityRuleSet* set = bank.velocityRules.load(std::memory_order_acquire);
+    if (!set) {
+        return {};
+    }
+    return std::vector<VelocityRule>(set->rules, set->rules + set->count);
+}
+
+namespace {
+
+/// A closed account's history, waiting until no snapshot can read it.
+struct ClosedHistory {
+    HistoryStore*               store{nullptr};
+    std::vector<HistoryGarbage> garbage;
+    std::vector<std::int64_t>   coldOffsets;
+};
+
+void deleteClosedHistory(void* ptr) {
+    ClosedHistory* closed = static_cast<ClosedHistory*>(ptr);
+    for (HistoryGarbage& g : closed->garbage) {
+        freeHistoryGarbage(g);
+    }
+    // Only now may later spills overwrite the blocks old views read.
+    releaseColdBlocks(*closed->store, closed->coldOffsets);
+    delete closed;
+}
+
+void deleteAccountNode(void* ptr) {
+    freeAccountNode(static_cast<AccountNode*>(ptr));
+}
+
+} // namespace
+
+template <typename BankT>
+OperationStatus closeAccount(BankT& bank,
+                             int accountNumber,
+                             const std::string& accountsArchive,
+                             const std::string& transactionsArchive) {
+    // 1) Mark it closing, serialized with creations and other closures.
+    //    It stays in the tree meanwhile, so creating the same number is
+    //    still refused, and writers leave it alone from here on.
+    AccountNode* node = nullptr;
+    {
+        std::lock_guard<std::mutex> insertGuard(bank.insertMutex);
+        node = BankT::Index::find(bank.accountsRoot, accountNumber);
         if (!node) {
-            std::cout << "Account #" << pt->accountNumber
-                      << " not found. Skipping queued transaction.\n";
-            delete pt;
-            pt = nullptr;
-            continue;
-        }
-
-        if (pt->type == TransactionType::Deposit) {
-            node->data.balance += pt->amount;
-            addTransaction(node->data.historyHead,
-                           TransactionType::Deposit,
-                           pt->amount,
-                           datetime);
-            std::cout << "Applied queued DEPOSIT of " << pt->amount
-                      << " to account #" << pt->accountNumber << ".\n";
-        } else if (pt->type == TransactionType::Withdraw) {
-            if (node->data.balance < pt->amount) {
-                std::cout << "Queued WITHDRAW " << pt->amount
-                          << " from account #" << pt->accountNumber
-                          << " skipped (insufficient funds).\n";
-            } else {
-                node->data.balance -= pt->amount;
-                addTransaction(node->data.historyHead,
-                               TransactionType::Withdraw,
-                               pt->amount,
-                               datetime);
-                std::cout << "Applied queued WITHDRAW of " << pt->amount
-                          << " from account #" << pt->accountNumber << ".\n";
+            return OperationStatus::AccountNotFound;
+        }
+        std::lock_guard<std::mutex> guard(node->lock);
+        if (node->closing.load(std::memory_order_relaxed)) {
+            return OperationStatus::AccountNotFound;   // another closure has it
+        }
+
+        // Catch up on interest so the archived balance is final.
+        {
+            BalanceChange change(bank, node);
+            if (accruePendingInterest(bank, node->data)) {
+                commitAccount(bank.epochs, node);
             }
         }
+        node->closing.store(true, std::memory_order_relaxed);
+    }
 
-        delete pt;
-        pt = nullptr;
+    // 2) Archive before anything is dropped, with no lock held: nothing
+    //    changes the account now, and compactBank (the only other thing
+    //    that could free it) needs the bank to itself.
+    Account& acc = node->data;
+    const std::string closedAt = getCurrentDateTime();
+    if (!appendClosedAccount(bank, acc, closedAt, accountsArchive, transactionsArchive)) {
+        std::lock_guard<std::mutex> guard(node->lock);
+        node->closing.store(false, std::memory_order_relaxed);
+        return OperationStatus::ArchiveFailed;
     }
 
-    std::cout << "Done processing queue.\n";
+    std::lock_guard<std::mutex> insertGuard(bank.insertMutex);
+    {
+        std::lock_guard<std::mutex> guard(node->lock);
+
+        // 3) Take the account out of the totals and the indexes.
+        const double key = normalizedBalance(acc);
+        AggregateCounters& agg = bank.aggregates;
+        agg.accountCount.fetch_sub(1);
+        addToTotal(agg.normalizedTotal, -key);
+        if (acc.balance <= 0.0) {
+            agg.nonPositiveCount.fetch_sub(1);
+        }
+        {
+            const long long today = dayOf(closedAt);
+            const double deposited = depositsOnDay(bank, viewOf(acc.history), today);
+            std::lock_guard<std::mutex> dayGuard(agg.dayMutex);
+            if (agg.day == today) {
+                agg.depositedToday -= deposited;
+            }
+        }
+        balanceIndexErase(bank.balanceIndex, node, key);
+        nameIndexErase(bank.nameIndex, node);
+
+        // 4) Publish the tombstone; snapshots from here on skip the account.
+        auto* history = new ClosedHistory();
+        history->store   = &bank.historyStore;
+        history->garbage = detachHistory(acc.history, history->coldOffsets);
+        node->closed.store(true, std::memory_order_release);
+        commitAccount(bank.epochs, node);
+
+        // 5) Older snapshots may still read the history: free it later.
+        retire(bank.epochs, history, deleteClosedHistory);
+    }
+
+    // 6) Unlink the node (after the lock is released: once retired it may
+    //    be freed at any time). With two children it stays a tombstone.
+    if (BankT::Index::unlink(bank.accountsRoot, node)) {
+        retire(bank.epochs, node, deleteAccountNode);
+    } else {
+        bank.tombstoneCount.fetch_add(1);
+    }
+    return OperationStatus::Ok;
+}
+
+template <typename BankT>
+bool closeAccountDirect(BankT& bank,
+                        int accountNumber,
+                        const std::string& accountsArchive,
+                        const std::string& transactionsArchive) {
+    switch (closeAccount(bank, accountNumber, accountsArchive, transactionsArchive)) {
+        case OperationStatus::Ok:
+            std::cout << "Closed account #" << accountNumber << " (archived to "
+                      << accountsArchive << " / " << transactionsArchive << ").\n";
+            return true;
+        case OperationStatus::ArchiveFailed:
+            std::cout << "Could not archive account #" << accountNumber
+                      << "; it was not closed.\n";
+            return false;
+        default:
+            std::cout << "Account #" << accountNumber << " not found.\n";
+            return false;
+    }
 }
 
-void printAllAccounts(const Bank& bank) {
-    if (!bank.accountsRoot) {
+template <typename BankT>
+CompactionResult compactBank(BankT& bank) {
+    CompactionResult result;
+
+    // 1) Free whatever retired memory is left (no reader is running), so
+    //    no retired object still points at a node about to be freed.
+    reclaim(bank.epochs);
+
+    // 2) Rebuild the tree from the open accounts. Rebuilding also puts
+    //    the tree back in balance, whatever order accounts came in.
+    std::vector<AccountNode*> open;
+    BankT::Index::forEach(bank.accountsRoot, [&](AccountNode* node) {
+        if (node->closed.load(std::memory_order_relaxed)) {
+            freeAccountNode(node);   // forEach is done with a node once it visited it
+            ++result.tombstonesFreed;
+        } else {
+            open.push_back(node);
+        }
+    });
+    BankT::Index::rebuild(bank.accountsRoot, open);
+    bank.tombstoneCount.store(0);
+
+    // 3) Indexes and names: drop the leftovers of closed accounts.
+    compactNameIndex(bank.nameIndex);
+    std::vector<PooledName*> names;
+    names.reserve(2 * open.size());   // holder names, then the folded ones
+    for (AccountNode* node : open) {
+        names.push_back(&node->data.holderName);
+    }
+    nameIndexHandles(bank.nameIndex, names);   // the folded names
+    result.nameBytesReleased = compactNamePool(bank.namePool, names);
+    return result;
+}
+
+template <typename BankT>
+bool compactionDue(const BankT& bank) {
+    const std::size_t tombstones = bank.tombstoneCount.load();
+    const long long open = bank.aggregates.accountCount.load();
+    return tombstones >= 1024 && static_cast<long long>(tombstones) * 8 >= open;
+}
+
+template <typename BankT>
+void printAllAccounts(const BankT& bank) {
+    if (BankT::Index::empty(bank.accountsRoot)) {
         std::cout << "(no accounts)\n";
         return;
     }
-    inorderPrintAccounts(bank.accountsRoot);
+    ReadSnapshot snapshot(bank.epochs);
+
+    // In-order traversal: sorted by account number, all as of one moment,
+    // with interest that is posted but not yet materialized included.
+    BankT::Index::forEach(bank.accountsRoot, [&](const AccountNode* node) {
+        if (const AccountVersion* version = versionAt(snapshot, node)) {
+            printAccountSummary(node->data,
+                                balanceWithPendingInterest(bank, snapshot, *version));
+        }
+    });
+}
+
+template <typename BankT>
+std::vector<int> findAccountsByName(const BankT& bank,
+                                    const std::string& query,
+                                    NameMatch how,
+                                    std::size_t limit) {
+    return nameIndexFind(bank.nameIndex, query, how, limit);
+}
+
+template <typename BankT>
+bool printAccountsByName(const BankT& bank,
+                         const std::string& query,
+                         NameMatch how) {
+    std::vector<int> numbers = findAccountsByName(bank, query, how);
+    ReadSnapshot snapshot(bank.epochs);
+
+    bool any = false;
+    for (int number : numbers) {
+        const AccountNode* node = BankT::Index::find(bank.accountsRoot, number);
+        const AccountVersion* version = node ? versionAt(snapshot, node) : nullptr;
+        if (version) {
+            printAccountSummary(node->data,
+                                balanceWithPendingInterest(bank, snapshot, *version));
+            any = true;
+        }
+    }
+    if (!any) {
+        std::cout << "No accounts found for '" << query << "'.\n";
+    }
+    return any;
 }
 
-bool printAccountByNumber(const Bank& bank,
+namespace {
+
+/// Materializes the pending interest of an account before a
+/// single-account read, so a snapshot taken afterwards includes it. The
+/// reader then looks the account up again under that snapshot: the node
+/// found here may be closed and freed as soon as the pin is released.
+template <typename BankT>
+void prepareAccountRead(BankT& bank, int accountNumber) {
+    ReadSnapshot pin(bank.epochs);
+    if (AccountNode* node = BankT::Index::find(bank.accountsRoot, accountNumber)) {
+        materializeInterest(bank, node);
+    }
+}
+
+} // namespace
+
+template <typename BankT>
+bool printAccountByNumber(BankT& bank,
                           int accountNumber) {
-    AccountNode* node = searchAccount(bank.accountsRoot, accountNumber);
-    if (!node) {
+    prepareAccountRead(bank, accountNumber);
+    ReadSnapshot snapshot(bank.epochs);
+    const AccountNode* node = BankT::Index::find(bank.accountsRoot, accountNumber);
+    const AccountVersion* version = node ? versionAt(snapshot, node) : nullptr;
+    if (!version) {
         std::cout << "Account #" << accountNumber << " not found.\n";
         return false;
     }
-    printAccountSummary(node->data);
+    printAccountSummary(node->data, version->balance);
     return true;
 }
 
-bool printAccountHistory(const Bank& bank,
+template <typename BankT>
+bool printAccountHistory(BankT& bank,
                          int accountNumber) {
-    AccountNode* node = searchAccount(bank.accountsRoot, accountNumber);
-    if (!node) {
+    prepareAccountRead(bank, accountNumber);
+    ReadSnapshot snapshot(bank.epochs);
+    const AccountNode* node = BankT::Index::find(bank.accountsRoot, accountNumber);
+    const AccountVersion* version = node ? versionAt(snapshot, node) : nullptr;
+    if (!version) {
         std::cout << "Account #" << accountNumber << " not found.\n";
         return false;
     }
 
     std::cout << "History for account #" << accountNumber << ":\n";
-    printTransactions(node->data.historyHead);
+    // Cold entries are streamed back from disk block by block; writers
+    // may append meanwhile, the snapshot still ends where it started.
+    bool any = false;
+    forEachHistoryEntry(bank.historyStore, version->history,
+                        [&](long long index, const Transaction& tx) {
+                            printTransaction(index + 1, tx);
+                            any = true;
+                        });
+    if (!any) {
+        std::cout << "(no transactions)\n";
+    }
     return true;
 }
 
-void applyInterestAll(Bank& bank, double rate) {
-    if (rate <= 0.0) {
+template <typename BankT>
+bool queryAccountHistoryByTime(BankT& bank,
+                               int accountNumber,
+                               const std::string& from,
+                               const std::string& to,
+                               long long pageOffset,
+                               int pageSize,
+                               HistoryPage& out) {
+    prepareAccountRead(bank, accountNumber);
+    ReadSnapshot snapshot(bank.epochs);
+    const AccountNode* node = BankT::Index::find(bank.accountsRoot, accountNumber);
+    const AccountVersion* version = node ? versionAt(snapshot, node) : nullptr;
+    if (!version) {
+        return false;
+    }
+    return queryHistoryByTime(bank.historyStore, version->history,
+                              from, to, pageOffset, pageSize, out);
+}
+
+template <typename BankT>
+bool queryRecentAccountHistory(BankT& bank,
+                               int accountNumber,
+                               long long count,
+                               long long pageOffset,
+                               int pageSize,
+                               HistoryPage& out) {
+    prepareAccountRead(bank, accountNumber);
+    ReadSnapshot snapshot(bank.epochs);
+    const AccountNode* node = BankT::Index::find(bank.accountsRoot, accountNumber);
+    const AccountVersion* version = node ? versionAt(snapshot, node) : nullptr;
+    if (!version) {
+        return false;
+    }
+    return queryRecentHistory(bank.historyStore, version->history,
+                              count, pageOffset, pageSize, out);
+}
+
+namespace {
+
+/// Prints a page returned by the history queries, with a "page x of y" footer.
+void printHistoryPage(const HistoryPage& page, int pageNumber) {
+    if (page.totalMatches == 0) {
+        std::cout << "(no transactions)\n";
+        return;
+    }
+
+    for (std::size_t i = 0; i < page.entries.size(); ++i) {
+        printTransaction(page.firstIndex + static_cast<long long>(i) + 1,
+                         page.entries[i]);
+    }
+
+    long long pages = (page.totalMatches + kHistoryPageSize - 1) / kHistoryPageSize;
+    std::cout << "-- page " << pageNumber << " of " << pages
+              << " (" << page.totalMatches << " matching transactions) --\n";
+}
+
+} // namespace
+
+template <typename BankT>
+bool printAccountHistoryRange(BankT& bank,
+                              int accountNumber,
+                              const std::string& from,
+                              const std::string& to,
+                              int page) {
+    if (page < 1) {
+        page = 1;
+    }
+
+    HistoryPage result;
+    if (!queryAccountHistoryByTime(bank, accountNumber, from, to,
+                                   static_cast<long long>(page - 1) * kHistoryPageSize,
+                                   kHistoryPageSize, result)) {
+        std::cout << "Account #" << accountNumber << " not found.\n";
+        return false;
+    }
+
+    std::cout << "History for account #" << accountNumber
+              << " from " << from << " to " << to << ":\n";
+    printHistoryPage(result, page);
+    return true;
+}
+
+template <typename BankT>
+bool printRecentHistory(BankT& bank,
+                        int accountNumber,
+                        int count,
+                        int page) {
+    if (page < 1) {
+        page = 1;
+    }
+
+    HistoryPage result;
+    if (!queryRecentAccountHistory(bank, accountNumber, count,
+                                   static_cast<long long>(page - 1) * kHistoryPageSize,
+                                   kHistoryPageSize, result)) {
+        std::cout << "Account #" << accountNumber << " not found.\n";
+        return false;
+    }
+
+    std::cout << "Last " << count << " transactions for account #"
+              << accountNumber << ":\n";
+    printHistoryPage(result, page);
+    return true;
+}
+
+template <typename BankT>
+bool getBalanceAsOf(BankT& bank,
+                    int accountNumber,
+                    const std::string& datetime,
+                    double& out) {
+    prepareAccountRead(bank, accountNumber);
+    ReadSnapshot snapshot(bank.epochs);
+    const AccountNode* node = BankT::Index::find(bank.accountsRoot, accountNumber);
+    const AccountVersion* version = node ? versionAt(snapshot, node) : nullptr;
+    if (!version) {
+        return false;
+    }
+    return balanceAtTime(bank.historyStore,
+                         version->history,
+                         node->data.openingBalance,
+                         toTimeKey(datetime, true),
+                         out);
+}
+
+template <typename BankT>
+std::vector<AccountBalance> balancesAsOf(const BankT& bank,
+                                         const std::string& datetime) {
+    std::vector<AccountBalance> result;
+    const long long timeKey = toTimeKey(datetime, true);
+    ReadSnapshot snapshot(bank.epochs);
+
+    // In-order traversal so the report comes out sorted by account number.
+    BankT::Index::forEach(bank.accountsRoot, [&](const AccountNode* node) {
+        if (const AccountVersion* version = versionAt(snapshot, node)) {
+            AccountBalance entry;
+            entry.accountNumber = node->data.accountNumber;
+            balanceAtTime(bank.historyStore,
+                          version->history,
+                          node->data.openingBalance,
+                          timeKey,
+                          entry.balance);
+
+            // Pending interest is dated after every history entry, so it
+            // only matters if it was posted at or before timeKey.
+            balanceWithPendingInterest(bank, snapshot, *version,
+                                       [&](const InterestEpoch& epoch, double, double after) {
+                                           if (toTimeKey(epoch.datetime) <= timeKey) {
+                                               entry.balance = after;
+                                           }
+                                       });
+            result.push_back(entry);
+        }
+
+    });
+    return result;
+}
+
+template <typename BankT>
+bool printBalanceAsOf(BankT& bank,
+                      int accountNumber,
+                      const std::string& datetime) {
+    double balance = 0.0;
+    if (!getBalanceAsOf(bank, accountNumber, datetime, balance)) {
+        std::cout << "Account #" << accountNumber << " not found.\n";
+        return false;
+    }
+    std::cout << "Balance of account #" << accountNumber
+              << " as of " << datetime << ": " << balance << '\n';
+    return true;
+}
+
+template <typename BankT>
+void printAllBalancesAsOf(const BankT& bank,
+                          const std::string& datetime) {
+    std::vector<AccountBalance> balances = balancesAsOf(bank, datetime);
+    if (balances.empty()) {
+        std::cout << "(no accounts)\n";
+        return;
+    }
+
+    std::cout << "Balances as of " << datetime << ":\n";
+    for (const AccountBalance& entry : balances) {
+        std::cout << "Account #" << entry.accountNumber
+                  << " | Balance: " << entry.balance << '\n';
+    }
+}
+
+namespace {
+
+/// Real balances (pending interest included) of indexed accounts, as of
+/// one snapshot, keeping those that `keep` accepts.
+template <typename BankT>
+std::vector<AccountBalance> indexedBalances(const BankT& bank,
+                                            const ReadSnapshot& snapshot,
+                                            const std::vector<AccountNode*>& nodes,
+                                            const std::function<bool(double)>& keep) {
+    std::vector<AccountBalance> result;
+    result.reserve(nodes.size());
+    for (const AccountNode* node : nodes) {
+        const AccountVersion* version = versionAt(snapshot, node);
+        if (!version) {
+            continue;   // created after the snapshot
+        }
+        double balance = balanceWithPendingInterest(bank, snapshot, *version);
+        if (!keep || keep(balance)) {
+            result.push_back(AccountBalance{node->data.accountNumber, balance});
+        }
+    }
+    return result;
+}
+
+/// Sorts by balance (lowest or highest first), then by account number.
+/// The index is ordered by current balances; the snapshot's may differ.
+void sortByBalance(std::vector<AccountBalance>& balances, bool highestFirst) {
+    std::sort(balances.begin(), balances.end(),
+              [highestFirst](const AccountBalance& a, const AccountBalance& b) {
+                  if (a.balance != b.balance) {
+                      return highestFirst ? a.balance > b.balance : a.balance < b.balance;
+                  }
+                  return a.accountNumber < b.accountNumber;
+              });
+}
+
+/// Index key of a real balance, moved by `direction` (-1 / +1) by a
+/// little more than the rounding between the two, so that no account on
+/// the boundary is missed; the exact balances are filtered afterwards.
+template <typename BankT>
+double indexKeyOf(const BankT& bank, double balance, int direction) {
+    double key = balance / bank.interestFactor.load();
+    return key + direction * 1e-9 * std::max(1.0, std::fabs(key));
+}
+
+} // namespace
+
+template <typename BankT>
+std::vector<AccountBalance> topBalances(const BankT& bank, std::size_t n) {
+    ReadSnapshot snapshot(bank.epochs);
+
+    // Accounts created after the snapshot are skipped: ask the index for
+    // more until n visible ones are found or it has no more.
+    std::vector<AccountBalance> result;
+    for (std::size_t fetch = n; ; fetch *= 2) {
+        std::vector<AccountNode*> nodes = balanceIndexTop(bank.balanceIndex, fetch);
+        result = indexedBalances(bank, snapshot, nodes, {});
+        if (result.size() >= n || nodes.size() < fetch) {
+            break;
+        }
+    }
+    sortByBalance(result, true);
+    if (result.size() > n) {
+        result.resize(n);
+    }
+    return result;
+}
+
+template <typename BankT>
+std::vector<AccountBalance> accountsWithBalanceBetween(const BankT& bank,
+                                                       double low,
+                                                       double high) {
+    ReadSnapshot snapshot(bank.epochs);
+    std::vector<AccountNode*> nodes = balanceIndexRange(bank.balanceIndex,
+                                                        indexKeyOf(bank, low, -1),
+                                                        indexKeyOf(bank, high, +1));
+    auto inRange = [low, high](double balance) { return balance >= low && balance <= high; };
+    std::vector<AccountBalance> result = indexedBalances(bank, snapshot, nodes, inRange);
+    sortByBalance(result, false);
+    return result;
+}
+
+template <typename BankT>
+std::vector<AccountBalance> accountsBelowBalance(const BankT& bank, double limit) {
+    ReadSnapshot snapshot(bank.epochs);
+    std::vector<AccountNode*> nodes = balanceIndexRange(bank.balanceIndex,
+                                                        std::numeric_limits<double>::lowest(),
+                                                        indexKeyOf(bank, limit, +1));
+    auto below = [limit](double balance) { return balance < limit; };
+    std::vector<AccountBalance> result = indexedBalances(bank, snapshot, nodes, below);
+    sortByBalance(result, false);
+    return result;
+}
+
+template <typename BankT>
+void printBalanceRange(const BankT& bank, double low, double high) {
+    std::vector<AccountBalance> balances = accountsWithBalanceBetween(bank, low, high);
+    if (balances.empty()) {
+        std::cout << "(no accounts)\n";
+        return;
+    }
+
+    std::cout << "Accounts with balance between " << low << " and " << high << ":\n";
+    for (const AccountBalance& entry : balances) {
+        std::cout << "Account #" << entry.accountNumber
+                  << " | Balance: " << entry.balance << '\n';
+    }
+}
+
+template <typename BankT>
+void applyInterestAll(BankT& bank, double rate) {
+    TraceSpan span("applyInterestAll");
+    if (!postInterest(bank, rate)) {
         std::cout << "Interest rate must be positive.\n";
         return;
     }
+    std::cout << "Applied interest with rate " << rate << " to all accounts.\n";
+}
 
-    const std::string datetime = getCurrentDateTime();
+template <typename BankT>
+bool postInterest(BankT& bank, double rate) {
+    StatTimer timer(StatOp::Interest);
+    TraceSpan span("postInterest");
+    if (rate <= 0.0) {
+        timer.done(OperationStatus::InvalidAmount);
+        return false;
+    }
 
-    // Recursive lambda to traverse BST and apply interest.
-    std::function<void(AccountNode*)> applyRec = [&](AccountNode* node) {
-        if (!node) return;
+    // Record the posting once; accounts catch up on it lazily.
+    {
+        std::unique_lock<std::shared_mutex> guard(bank.interestMutex);
+        InterestEpoch epoch;
+        epoch.rate = rate;
+        {
+            TraceSpan datetimeSpan("interest.datetime");
+            epoch.datetime = getCurrentDateTime();
+        }
+        epoch.factor   = bank.interestFactor.load() * (1.0 + rate);
+        bank.interestEpochs.push_back(epoch);
 
-        applyRec(node->left);
+        // Snapshots from this stamp on see the interest.
+        TraceSpan commitSpan("interest.commit");
+        const std::uint64_t stamp = beginCommit(bank.epochs);
+        bank.interestEpochs.back().stamp = stamp;
+        bank.interestEpochCount.store(bank.interestEpochs.size(), std::memory_order_release);
+        // The normalized aggregate total grows with this factor for free.
+        bank.interestFactor.store(epoch.factor);
+        endCommit(bank.epochs, stamp);
+    }
+    return timer.done(true);
+}
 
-        double interest = node->data.balance * rate;
-        if (interest != 0.0) {
-            node->data.balance += interest;
-            addTransaction(node->data.historyHead,
-                           TransactionType::Interest,
-                           interest,
-                           datetime);
+template <typename BankT>
+std::size_t sweepInterest(BankT& bank) {
+    TraceSpan span("sweepInterest");
+    std::size_t swept = 0;
+    ReadSnapshot pin(bank.epochs);   // keeps closed nodes on the way alive
+
+    // Catch every account up, in account-number order.
+    BankT::Index::forEach(bank.accountsRoot, [&](AccountNode* node) {
+        if (materializeInterest(bank, node)) {
+            ++swept;
+        }
+    });
+    return swept;
+}
+
+template <typename BankT>
+BankAggregates getAggregates(const BankT& bank) {
+    const AggregateCounters& agg = bank.aggregates;
+    BankAggregates out;
+    out.accountCount     = agg.accountCount.load();
+    out.totalBalance     = agg.normalizedTotal.load() * bank.interestFactor.load();
+    out.nonPositiveCount = agg.nonPositiveCount.load();
+
+    const long long today = dayOf(getCurrentDateTime());
+    std::lock_guard<std::mutex> guard(agg.dayMutex);
+    out.depositedToday = agg.day == today ? agg.depositedToday : 0.0;
+    return out;
+}
+
+template <typename BankT>
+BankAggregates scanAggregates(const BankT& bank) {
+    BankAggregates out;
+    const long long today = dayOf(getCurrentDateTime());
+    ReadSnapshot snapshot(bank.epochs);
+
+    BankT::Index::forEach(bank.accountsRoot, [&](const AccountNode* node) {
+        if (const AccountVersion* version = versionAt(snapshot, node)) {
+            ++out.accountCount;
+            double balance = balanceWithPendingInterest(bank, snapshot, *version);
+            out.totalBalance += balance;
+            if (balance <= 0.0) {
+                ++out.nonPositiveCount;
+            }
+
+            out.depositedToday += depositsOnDay(bank, version->history, today);
         }
+    });
+    return out;
+}
 
-        applyRec(node->right);
+namespace {
+
+/// Equal up to the rounding of summing in a different order.
+bool sameAmount(double a, double b) {
+    return std::fabs(a - b) <= std::max(1e-6, 1e-9 * std::fabs(b));
+}
+
+} // namespace
+
+template <typename BankT>
+bool verifyAggregates(const BankT& bank) {
+    BankAggregates kept = getAggregates(bank);
+    BankAggregates scanned = scanAggregates(bank);
+
+    bool ok = true;
+    auto report = [&](const char* field, double keptValue, double scannedValue) {
+        std::cout << "Aggregate drift in " << field << ": maintained " << keptValue
+                  << ", full scan " << scannedValue << ".\n";
+        ok = false;
     };
 
-    applyRec(bank.accountsRoot);
+    if (kept.accountCount != scanned.accountCount) {
+        report("accountCount", kept.accountCount, scanned.accountCount);
+    }
+    if (!sameAmount(kept.totalBalance, scanned.totalBalance)) {
+        report("totalBalance", kept.totalBalance, scanned.totalBalance);
+    }
+    if (kept.nonPositiveCount != scanned.nonPositiveCount) {
+        report("nonPositiveCount", kept.nonPositiveCount, scanned.nonPositiveCount);
+    }
+    if (!sameAmount(kept.depositedToday, scanned.depositedToday)) {
+        report("depositedToday", kept.depositedToday, scanned.depositedToday);
+    }
+    return ok;
+}
+
+template <typename BankT>
+void resetAggregates(BankT& bank) {
+    BankAggregates scanned = scanAggregates(bank);
+    AggregateCounters& agg = bank.aggregates;
+    agg.accountCount.store(scanned.accountCount);
+    agg.normalizedTotal.store(scanned.totalBalance / bank.interestFactor.load());
+    agg.nonPositiveCount.store(scanned.nonPositiveCount);
 
-    std::cout << "Applied interest with rate " << rate << " to all accounts.\n";
+    std::lock_guard<std::mutex> guard(agg.dayMutex);
+    agg.day            = dayOf(getCurrentDateTime());
+    agg.depositedToday = scanned.depositedToday;
 }
 
+template <typename BankT>
+void printAggregates(const BankT& bank) {
+    BankAggregates agg = getAggregates(bank);
+    std::cout << "Accounts: " << agg.accountCount << '\n'
+              << "Total balance: " << agg.totalBalance << '\n'
+              << "Zero / negative balances: " << agg.nonPositiveCount << '\n'
+              << "Deposited today: " << agg.depositedToday << '\n';
+}
+
+template <typename BankT>
+double balanceWithPendingInterest(const BankT& bank,
+                                  const ReadSnapshot& snapshot,
+                                  const AccountVersion& version,
+                                  const PendingInterestVisitor& visit) {
+    double balance = version.balance;
+    if (version.interestApplied == bank.interestEpochCount.load(std::memory_order_acquire)) {
+        return balance;   // nothing pending: no lock
+    }
+
+    std::shared_lock<std::shared_mutex> guard(bank.interestMutex);
+    for (std::size_t i = version.interestApplied; i < bank.interestEpochs.size(); ++i) {
+        const InterestEpoch& epoch = bank.interestEpochs[i];
+        if (epoch.stamp > snapshot.stamp()) {
+            break;   // posted after the snapshot was taken
+        }
+        double interest = balance * epoch.rate;
+        if (interest != 0.0) {
+            balance += interest;
+            if (visit) {
+                visit(epoch, interest, balance);
+            }
+        }
+    }
+    return balance;
+}
+
+// Built for every bank type (see BANK_FOR_EACH_BANK_TYPE).
+#define INSTANTIATE_BANK_SERVICE(B) \
+    template void initBank<B>(B&); \
+    template void destroyBank<B>(B&); \
+    template OperationStatus addAccount<B>(B&, int, const std::string&, double); \
+    template bool createAccount<B>(B&, int, const std::string&, double); \
+    template std::vector<OperationStatus> applyBatch<B>(B&, const BatchOperation*, std::size_t); \
+    template std::vector<OperationStatus> applyBatch<B>(B&, const std::vector<BatchOperation>&); \
+    template OperationStatus runIdempotent<B>(B&, const std::string&, std::uint64_t, const std::function<OperationStatus()>&); \
+    template void configureIdempotency<B>(B&, std::size_t, long long); \
+    template bool depositDirect<B>(B&, int, double, const std::string&); \
+    template bool withdrawDirect<B>(B&, int, double, const std::string&); \
+    template OperationStatus transferFunds<B>(B&, int, int, double, long long); \
+    template OperationStatus sendTransfer<B>(B&, int, int, double, long long, const std::string&); \
+    template OperationStatus receiveTransfer<B>(B&, int, int, double, long long, const std::string&); \
+    template bool transferDirect<B>(B&, int, int, double); \
+    template OperationStatus queuePendingTransaction<B>(B&, int, TransactionType, double, const std::string&); \
+    template bool enqueuePendingTransaction<B>(B&, int, TransactionType, double, const std::string&); \
+    template OperationStatus closeAccount<B>(B&, int, const std::string&, const std::string&); \
+    template bool closeAccountDirect<B>(B&, int, const std::string&, const std::string&); \
+    template CompactionResult compactBank<B>(B&); \
+    template bool compactionDue<B>(const B&); \
+    template QueueRunSummary applyPendingQueue<B>(B&); \
+    template void processPendingQueue<B>(B&); \
+    template bool setVelocityRules<B>(B&, const std::vector<VelocityRule>&); \
+    template std::vector<VelocityRule> getVelocityRules<B>(const B&); \
+    template void printAllAccounts<B>(const B&); \
+    template std::vector<int> findAccountsByName<B>(const B&, const std::string&, NameMatch, std::size_t); \
+    template bool printAccountsByName<B>(const B&, const std::string&, NameMatch); \
+    template bool printAccountByNumber<B>(B&, int); \
+    template bool printAccountHistory<B>(B&, int); \
+    template bool queryAccountHistoryByTime<B>(B&, int, const std::string&, const std::string&, long long, int, HistoryPage&); \
+    template bool queryRecentAccountHistory<B>(B&, int, long long, long long, int, HistoryPage&); \
+    template bool printAccountHistoryRange<B>(B&, int, const std::string&, const std::string&, int); \
+    template bool printRecentHistory<B>(B&, int, int, int); \
+    template bool getBalanceAsOf<B>(B&, int, const std::string&, double&); \
+    template std::vector<AccountBalance> balancesAsOf<B>(const B&, const std::string&); \
+    template bool printBalanceAsOf<B>(B&, int, const std::string&); \
+    template void printAllBalancesAsOf<B>(const B&, const std::string&); \
+    template std::vector<AccountBalance> topBalances<B>(const B&, std::size_t); \
+    template std::vector<AccountBalance> accountsWithBalanceBetween<B>(const B&, double, double); \
+    template std::vector<AccountBalance> accountsBelowBalance<B>(const B&, double); \
+    template void printBalanceRange<B>(const B&, double, double); \
+    template void applyInterestAll<B>(B&, double); \
+    template bool postInterest<B>(B&, double); \
+    template std::size_t sweepInterest<B>(B&); \
+    template BankAggregates getAggregates<B>(const B&); \
+    template BankAggregates scanAggregates<B>(const B&); \
+    template bool verifyAggregates<B>(const B&); \
+    template void resetAggregates<B>(B&); \
+    template void printAggregates<B>(const B&); \
+    template double balanceWithPendingInterest<B>(const B&, const ReadSnapshot&, const AccountVersion&, const PendingInterestVisitor&);
+BANK_FOR_EACH_BANK_TYPE(INSTANTIATE_BANK_SERVICE)
+#undef INSTANTIATE_BANK_SERVICE
+
 } // namespace bank
@@ -0,0 +1,476 @@
+#include "commands.h"
+
+#include "persistence.h"
+#include "memory_usage.h"
+#include "stats.h"
+#include "trace.h"
+
+#include <iomanip>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <vector>
+
+namespace bank {
+
+namespace {
+
+/// Deposits / withdrawals collected before one applyBatch call.
+constexpr std::size_t kMaxBatchRun = 4096;
+
+const char* const kBadCommand = "error bad_command";
+
+/// True for empty lines and '#' comments.
+bool isBlankOrComment(const std::string& line) {
+    std::size_t first = line.find_first_not_of(" \t\r");
+    return first == std::string::npos || line[first] == '#';
+}
+
+/// True if nothing but blanks is left in `in`.
+bool atEnd(std::istringstream& in) {
+    in >> std::ws;
+    return in.eof();
+}
+
+/// Parses "deposit|withdraw <account> <amount>".
+/// @return false for any other command or a malformed line.
+bool parseBalanceOperation(const std::string& line, BatchOperation& op) {
+    std::istringstream in(line);
+    std::string verb;
+    in >> verb;
+    if (verb == "deposit") {
+        op.type = TransactionType::Deposit;
+    } else if (verb == "withdraw") {
+        op.type = TransactionType::Withdraw;
+    } else {
+        return false;
+    }
+    return static_cast<bool>(in >> op.accountNumber >> op.amount) && atEnd(in);
+}
+
+/// A transfer or an enqueue command.
+struct KeyedOperation {
+    bool            transfer{false};
+    int             account{};
+    int             toAccount{};
+    TransactionType type{TransactionType::Deposit};
+    double          amount{};
+};
+
+/// Parses "transfer <from> <to> <amount>" or
+/// "enqueue <account> deposit|withdraw <amount>".
+/// @return false for any other command or a malformed line.
+bool parseKeyedOperation(const std::string& line, KeyedOperation& op) {
+    std::istringstream in(line);
+    std::string verb;
+    in >> verb;
+    if (verb == "transfer") {
+        op.transfer = true;
+        return static_cast<bool>(in >> op.account >> op.toAccount >> op.amount) && atEnd(in);
+    }
+    if (verb != "enqueue") {
+        return false;
+    }
+    std::string kind;
+    if (!(in >> op.account >> kind >> op.amount) || !atEnd(in) ||
+        (kind != "deposit" && kind != "withdraw")) {
+        return false;
+    }
+    op.type = kind == "deposit" ? TransactionType::Deposit : TransactionType::Withdraw;
+    return true;
+}
+
+/// requestFingerprint of a keyed transfer or enqueue (same names as the
+/// service layer uses).
+std::uint64_t fingerprintOf(const KeyedOperation& op) {
+    if (op.transfer) {
+        return requestFingerprint("transfer", op.account, op.toAccount, op.amount);
+    }
+    const char* operation = op.type == TransactionType::Deposit ? "enqueue_deposit"
+                                                                : "enqueue_withdraw";
+    return requestFingerprint(operation, op.account, 0, op.amount);
+}
+
+OperationStatus applyKeyedOperation(Bank& bank, const KeyedOperation& op) {
+    return op.transfer ? transferFunds(bank, op.account, op.toAccount, op.amount)
+                       : queuePendingTransaction(bank, op.account, op.type, op.amount);
+}
+
+std::string statusResult(OperationStatus status) {
+    if (status == OperationStatus::Ok) {
+        return "ok";
+    }
+    return std::string("error ") + operationStatusName(status);
+}
+
+/// Reads the optional pair of file names of close / save.
+bool readFilePair(std::istringstream& in, std::string& first, std::string& second) {
+    if (atEnd(in)) {
+        return true;   // keep the defaults
+    }
+    return static_cast<bool>(in >> first >> second) && atEnd(in);
+}
+
+/// Parses the rest of "create <account> <initialBalance> <holder name...>".
+bool parseCreate(std::istringstream& in, int& account, double& balance, std::string& name) {
+    if (!(in >> account >> balance) || atEnd(in)) {
+        return false;
+    }
+    std::getline(in, name);
+    while (!name.empty() && (name.back() == '\r' || name.back() == ' ')) {
+        name.pop_back();   // CRLF files, trailing blanks
+    }
+    return true;
+}
+
+/// "ok <balance>" with enough digits to read the balance back.
+std::string balanceResult(double balance) {
+    std::ostringstream result;
+    result << "ok " << std::setprecision(15) << balance;
+    return result.str();
+}
+
+/// Applies a run of deposits / withdrawals through `applyRun` (one call
+/// for the whole run) and writes their results.
+template <typename ApplyRun>
+void flushRun(ApplyRun& applyRun,
+              std::vector<BatchOperation>& ops,
+              std::vector<long long>& lines,
+              std::ostream& out,
+              BatchSummary& summary) {
+    if (ops.empty()) {
+        return;
+    }
+    std::vector<OperationStatus> results = applyRun(ops);
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        out << lines[i] << ' ' << statusResult(results[i]) << '\n';
+        if (results[i] != OperationStatus::Ok) {
+            ++summary.failed;
+        }
+    }
+    summary.commands += static_cast<long long>(ops.size());
+    ops.clear();
+    lines.clear();
+}
+
+} // namespace
+
+std::string executeCommand(Bank& bank, const std::string& line) {
+    if (isBlankOrComment(line)) {
+        return "";
+    }
+
+    BatchOperation op;
+    if (parseBalanceOperation(line, op)) {
+        return statusResult(applyBatch(bank, &op, 1).front());
+    }
+
+    std::istringstream in(line);
+    std::string verb;
+    in >> verb;
+
+    if (verb == "create") {
+        int account{};
+        double balance{};
+        std::string name;
+        if (!parseCreate(in, account, balance, name)) {
+            return kBadCommand;
+        }
+        return statusResult(addAccount(bank, account, name, balance));
+    }
+    if (verb == "transfer" || verb == "enqueue") {
+        KeyedOperation keyed;
+        if (!parseKeyedOperation(line, keyed)) {
+            return kBadCommand;
+        }
+        return statusResult(applyKeyedOperation(bank, keyed));
+    }
+    if (verb == "id") {
+        // A retry with the same key gets the first result back (see runIdempotent).
+        std::string key, command;
+        if (!(in >> key) || atEnd(in)) {
+            return kBadCommand;
+        }
+        std::getline(in, command);
+        KeyedOperation keyed;
+        if (parseBalanceOperation(command, op)) {
+            const char* operation = op.type == TransactionType::Deposit ? "deposit" : "withdraw";
+            const std::uint64_t fingerprint =
+                requestFingerprint(operation, op.accountNumber, 0, op.amount);
+            return statusResult(runIdempotent(bank, key, fingerprint, [&] {
+                return applyBatch(bank, &op, 1).front();
+            }));
+        }
+        if (parseKeyedOperation(command, keyed)) {
+            return statusResult(runIdempotent(bank, key, fingerprintOf(keyed), [&] {
+                return applyKeyedOperation(bank, keyed);
+            }));
+        }
+        return kBadCommand;
+    }
+    if (verb == "idempotency") {
+        long long capacity{}, ttlSeconds{};
+        if (!(in >> capacity >> ttlSeconds) || !atEnd(in) || capacity <= 0 || ttlSeconds <= 0) {
+            return kBadCommand;
+        }
+        configureIdempotency(bank, static_cast<std::size_t>(capacity), ttlSeconds);
+        return "ok";
+    }
+    if (verb == "process") {
+        if (!atEnd(in)) {
+            return kBadCommand;
+        }
+        QueueRunSummary run = applyPendingQueue(bank);
+        return "ok applied=" + std::to_string(run.applied) +
+               " skipped=" + std::to_string(run.skipped);
+    }
+    if (verb == "interest") {
+        double rate{};
+        if (!(in >> rate) || !atEnd(in)) {
+            return kBadCommand;
+        }
+        return postInterest(bank, rate) ? "ok" : statusResult(OperationStatus::InvalidAmount);
+    }
+    if (verb == "balance") {
+        int account{};
+        if (!(in >> account) || !atEnd(in)) {
+            return kBadCommand;
+        }
+        double balance = 0.0;
+        // As of the far future == now, pending interest included.
+        if (!getBalanceAsOf(bank, account, "9999", balance)) {
+            return statusResult(OperationStatus::AccountNotFound);
+        }
+        return balanceResult(balance);
+    }
+    if (verb == "close") {
+        int account{};
+        std::string accountsArchive = "closed_accounts.csv";
+        std::string transactionsArchive = "closed_transactions.csv";
+        if (!(in >> account) || !readFilePair(in, accountsArchive, transactionsArchive)) {
+            return kBadCommand;
+        }
+        OperationStatus status = closeAccount(bank, account, accountsArchive, transactionsArchive);
+        // Commands run alone on the bank, so compacting here is safe.
+        if (status == OperationStatus::Ok && compactionDue(bank)) {
+            compactBank(bank);
+        }
+        return statusResult(status);
+    }
+    if (verb == "save") {
+        std::string accountsFile = "accounts.csv";
+        std::string transactionsFile = "transactions.csv";
+        if (!readFilePair(in, accountsFile, transactionsFile)) {
+            return kBadCommand;
+        }
+        return saveBankToFiles(bank, accountsFile, transactionsFile) ? "ok" : "error save_failed";
+    }
+    if (verb == "stats") {
+        std::string action;
+        in >> action;
+        if (!atEnd(in) || (!action.empty() && action != "reset")) {
+            return kBadCommand;
+        }
+        if (action == "reset") {
+            resetStats();
+            return "ok";
+        }
+        std::ostringstream result;
+        result << "ok ";
+        writeStatsJson(result, bank);
+        return result.str();
+    }
+    if (verb == "memory") {
+        if (!atEnd(in)) {
+            return kBadCommand;
+        }
+        std::ostringstream result;
+        result << "ok ";
+        writeMemoryJson(result, measureMemory(bank));
+        return result.str();
+    }
+    if (verb == "limit") {
+        std::string action;
+        in >> action;
+        std::vector<VelocityRule> rules = getVelocityRules(bank);
+        if (action.empty()) {
+            std::ostringstream result;
+            result << "ok rules=" << rules.size();
+            for (const VelocityRule& rule : rules) {
+                result << ' ' << rule.windowSeconds << ':' << rule.maxAmount
+                       << ':' << rule.maxCount;
+            }
+            return result.str();
+        }
+        if (action == "clear" && atEnd(in)) {
+            setVelocityRules(bank, {});
+            return "ok";
+        }
+        VelocityRule rule;
+        if (action != "add" ||
+            !(in >> rule.windowSeconds >> rule.maxAmount >> rule.maxCount) || !atEnd(in)) {
+            return kBadCommand;
+        }
+        rules.push_back(rule);
+        return setVelocityRules(bank, rules) ? "ok" : statusResult(OperationStatus::InvalidAmount);
+    }
+    if (verb == "trace") {
+        std::string file;
+        if (!(in >> file) || !atEnd(in)) {
+            return kBadCommand;
+        }
+        return saveChromeTrace(file) ? "ok" : "error trace_failed";
+    }
+    return kBadCommand;
+}
+
+std::string executeShardedCommand(ShardedBank& sharded, const std::string& line) {
+    if (isBlankOrComment(line)) {
+        return "";
+    }
+
+    BatchOperation op;
+    if (parseBalanceOperation(line, op)) {
+        return statusResult(shardedApplyBatch(sharded, &op, 1).front());
+    }
+
+    std::istringstream in(line);
+    std::string verb;
+    in >> verb;
+
+    if (verb == "create") {
+        int account{};
+        double balance{};
+        std::string name;
+        if (!parseCreate(in, account, balance, name)) {
+            return kBadCommand;
+        }
+        return statusResult(shardedCreateAccount(sharded, account, name, balance));
+    }
+    if (verb == "transfer") {
+        KeyedOperation keyed;
+        if (!parseKeyedOperation(line, keyed)) {
+            return kBadCommand;
+        }
+        return statusResult(shardedTransfer(sharded, keyed.account, keyed.toAccount, keyed.amount));
+    }
+    if (verb == "enqueue") {
+        KeyedOperation keyed;
+        if (!parseKeyedOperation(line, keyed)) {
+            return kBadCommand;
+        }
+        return statusResult(shardedEnqueue(sharded, keyed.account, keyed.type, keyed.amount));
+    }
+    if (verb == "process") {
+        if (!atEnd(in)) {
+            return kBadCommand;
+        }
+        QueueRunSummary run = shardedProcessQueue(sharded);
+        return "ok applied=" + std::to_string(run.applied) +
+               " skipped=" + std::to_string(run.skipped);
+    }
+    if (verb == "interest") {
+        double rate{};
+        if (!(in >> rate) || !atEnd(in)) {
+            return kBadCommand;
+        }
+        return shardedPostInterest(sharded, rate) ? "ok" : statusResult(OperationStatus::InvalidAmount);
+    }
+    if (verb == "balance") {
+        int account{};
+        if (!(in >> account) || !atEnd(in)) {
+            return kBadCommand;
+        }
+        double balance = 0.0;
+        if (!shardedBalance(sharded, account, balance)) {
+            return statusResult(OperationStatus::AccountNotFound);
+        }
+        return balanceResult(balance);
+    }
+    if (verb == "close") {
+        int account{};
+        std::string accountsArchive = "closed_accounts.csv";
+        std::string transactionsArchive = "closed_transactions.csv";
+        if (!(in >> account) || !readFilePair(in, accountsArchive, transactionsArchive)) {
+            return kBadCommand;
+        }
+        return statusResult(shardedCloseAccount(sharded, account,
+                                                accountsArchive, transactionsArchive));
+    }
+    if (verb == "save") {
+        std::string accountsFile = "accounts.csv";
+        std::string transactionsFile = "transactions.csv";
+        if (!readFilePair(in, accountsFile, transactionsFile)) {
+            return kBadCommand;
+        }
+        return shardedSave(sharded, accountsFile, transactionsFile) ? "ok" : "error save_failed";
+    }
+    if (verb == "suspense") {
+        if (!atEnd(in)) {
+            return kBadCommand;
+        }
+        return "ok " + std::to_string(shardedSuspense(sharded).size());
+    }
+    return kBadCommand;
+}
+
+namespace {
+
+/// Body of runBatch / runShardedBatch: `applyRun` applies a run of
+/// deposits / withdrawals, `execute` any other command line.
+template <typename ApplyRun, typename Execute>
+BatchSummary runCommands(std::istream& in, std::ostream& out,
+                         ApplyRun applyRun, Execute execute) {
+    BatchSummary summary;
+    std::vector<BatchOperation> run;
+    std::vector<long long> runLines;
+
+    std::string line;
+    long long lineNumber = 0;
+    while (std::getline(in, line)) {
+        ++lineNumber;
+        if (isBlankOrComment(line)) {
+            continue;
+        }
+
+        BatchOperation op;
+        if (parseBalanceOperation(line, op)) {
+            run.push_back(op);
+            runLines.push_back(lineNumber);
+            if (run.size() >= kMaxBatchRun) {
+                flushRun(applyRun, run, runLines, out, summary);
+            }
+            continue;
+        }
+
+        // Anything else may depend on the run before it: apply that first.
+        flushRun(applyRun, run, runLines, out, summary);
+        std::string result = execute(line);
+        out << lineNumber << ' ' << result << '\n';
+        ++summary.commands;
+        if (result.compare(0, 5, "error") == 0) {
+            ++summary.failed;
+        }
+    }
+    flushRun(applyRun, run, runLines, out, summary);
+    out.flush();
+    return summary;
+}
+
+} // namespace
+
+BatchSummary runBatch(Bank& bank, std::istream& in, std::ostream& out) {
+    return runCommands(in, out,
+                       [&](const std::vector<BatchOperation>& ops) { return applyBatch(bank, ops); },
+                       [&](const std::string& line) { return executeCommand(bank, line); });
+}
+
+BatchSummary runShardedBatch(ShardedBank& sharded, std::istream& in, std::ostream& out) {
+    return runCommands(in, out,
+                       [&](const std::vector<BatchOperation>& ops) {
+                           return shardedApplyBatch(sharded, ops.data(), ops.size());
+                       },
+                       [&](const std::string& line) { return executeShardedCommand(sharded, line); });
+}
+
+} // namespace bank
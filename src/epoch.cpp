@@ -0,0 +1,152 @@
+#include "epoch.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <thread>
+
+namespace bank {
+
+namespace {
+
+/// pinnedStamp of a slot that is not reading.
+constexpr std::uint64_t kIdleStamp = std::numeric_limits<std::uint64_t>::max();
+
+/// Minimum number of retired objects per shard before a reclaim pass.
+constexpr std::size_t kReclaimThreshold = 256;
+
+/// Frees the objects of one shard retired before `oldest` (caller holds the lock).
+void reclaimShard(RetireShard& shard, std::uint64_t oldest) {
+    auto keep = std::partition(shard.objects.begin(), shard.objects.end(),
+                               [oldest](const RetiredObject& obj) {
+                                   return obj.retireStamp >= oldest;
+                               });
+    for (auto it = keep; it != shard.objects.end(); ++it) {
+        it->deleter(it->ptr);
+    }
+    shard.objects.erase(keep, shard.objects.end());
+    shard.reclaimAt = std::max(kReclaimThreshold, 2 * shard.objects.size());
+}
+
+/// Smallest stamp pinned by an active reader, kIdleStamp if none.
+std::uint64_t minPinnedStamp(const EpochManager& epochs) {
+    std::uint64_t oldest = kIdleStamp;
+    for (ReaderSlot* slot = epochs.readers.load(); slot != nullptr; slot = slot->next) {
+        oldest = std::min(oldest, slot->pinnedStamp.load());
+    }
+    return oldest;
+}
+
+/// Picks a retire shard for the calling thread.
+RetireShard& shardForThisThread(EpochManager& epochs) {
+    std::size_t h = std::hash<std::thread::id>{}(std::this_thread::get_id());
+    return epochs.retired[h % kRetireShards];
+}
+
+} // namespace
+
+std::uint64_t beginCommit(EpochManager& epochs) {
+    // One commit publishes at a time, so stamps become visible in order.
+    // A blocking lock (rather than spinning until the previous stamp is
+    // visible) keeps a preempted committer from stalling everyone else
+    // when there are more threads than cores.
+    epochs.commitMutex.lock();
+    return epochs.nextStamp.fetch_add(1);
+}
+
+void endCommit(EpochManager& epochs, std::uint64_t stamp) {
+    epochs.visibleStamp.store(stamp, std::memory_order_release);
+    epochs.commitMutex.unlock();
+}
+
+ReaderSlot* pinReader(EpochManager& epochs) {
+    // 1) Reuse a free slot if there is one...
+    ReaderSlot* slot = epochs.readers.load(std::memory_order_acquire);
+    for (; slot != nullptr; slot = slot->next) {
+        bool expected = false;
+        if (!slot->inUse.load(std::memory_order_relaxed) &&
+            slot->inUse.compare_exchange_strong(expected, true)) {
+            break;
+        }
+    }
+
+    // 2) ...otherwise push a new one onto the list.
+    if (slot == nullptr) {
+        slot = new ReaderSlot();
+        slot->inUse.store(true);
+        slot->pinnedStamp.store(kIdleStamp);
+        ReaderSlot* head = epochs.readers.load();
+        do {
+            slot->next = head;
+        } while (!epochs.readers.compare_exchange_weak(head, slot));
+    }
+
+    // 3) Pin the visible stamp. Re-check after publishing the pin so that a
+    //    writer trimming old versions either sees this slot or trimmed
+    //    only versions older than the stamp we end up with.
+    std::uint64_t stamp = epochs.visibleStamp.load();
+    while (true) {
+        slot->pinnedStamp.store(stamp);
+        std::uint64_t now = epochs.visibleStamp.load();
+        if (now == stamp) {
+            break;
+        }
+        stamp = now;
+    }
+    return slot;
+}
+
+void unpinReader(ReaderSlot* slot) {
+    slot->pinnedStamp.store(kIdleStamp, std::memory_order_release);
+    slot->inUse.store(false, std::memory_order_release);
+}
+
+std::uint64_t oldestPinnedStamp(const EpochManager& epochs) {
+    // Load visibleStamp before scanning: a reader the scan misses pins a
+    // stamp at least this large (see the re-check in pinReader).
+    const std::uint64_t visible = epochs.visibleStamp.load();
+    return std::min(visible, minPinnedStamp(epochs));
+}
+
+void retire(EpochManager& epochs, void* ptr, void (*deleter)(void*)) {
+    RetiredObject obj;
+    obj.ptr         = ptr;
+    obj.deleter     = deleter;
+    obj.retireStamp = epochs.visibleStamp.load();
+
+    RetireShard& shard = shardForThisThread(epochs);
+    std::lock_guard<std::mutex> guard(shard.mutex);
+    shard.objects.push_back(obj);
+    if (shard.objects.size() >= shard.reclaimAt) {
+        // Readers pinned at a stamp > retireStamp started after the object
+        // was unlinked, so they cannot reach it.
+        reclaimShard(shard, minPinnedStamp(epochs));
+    }
+}
+
+void reclaim(EpochManager& epochs) {
+    std::uint64_t oldest = minPinnedStamp(epochs);
+    for (RetireShard& shard : epochs.retired) {
+        std::lock_guard<std::mutex> guard(shard.mutex);
+        reclaimShard(shard, oldest);
+    }
+}
+
+void destroyEpochManager(EpochManager& epochs) {
+    for (RetireShard& shard : epochs.retired) {
+        std::lock_guard<std::mutex> guard(shard.mutex);
+        for (RetiredObject& obj : shard.objects) {
+            obj.deleter(obj.ptr);
+        }
+        shard.objects.clear();
+    }
+
+    ReaderSlot* slot = epochs.readers.exchange(nullptr);
+    while (slot != nullptr) {
+        ReaderSlot* next = slot->next;
+        delete slot;
+        slot = next;
+    }
+}
+
+} // namespace bank
@@ -0,0 +1,521 @@
+#include "history_store.h"
+
+#include "utils.h"
+
+#include <algorithm> // std::min, std::copy, std::partition_point
+#include <cstring>   // std::memcpy, std::memset
+#include <iostream>
+
+namespace bank {
+
+namespace {
+
+/// Fixed-size on-disk form of one transaction.
+struct ColdRecord {
+    std::uint8_t type;
+    char         datetime[20];   // "YYYY-MM-DD HH:MM:SS" + '\0'
+    double       amount;
+    double       balanceAfter;
+    std::int32_t counterparty;
+    std::int64_t transferId;
+};
+
+ColdRecord toRecord(const Transaction& tx) {
+    ColdRecord rec;
+    std::memset(&rec, 0, sizeof(rec));
+    rec.type = static_cast<std::uint8_t>(tx.type);
+    std::memcpy(rec.datetime, tx.datetime.data(),
+                std::min(tx.datetime.size(), sizeof(rec.datetime) - 1));
+    rec.amount       = tx.amount;
+    rec.balanceAfter = tx.balanceAfter;
+    rec.counterparty = tx.counterparty;
+    rec.transferId   = tx.transferId;
+    return rec;
+}
+
+/// Reads one cold block from the segment file into `out`.
+bool readBlock(const HistoryStore& store,
+               const ColdBlock& block,
+               std::vector<ColdRecord>& out) {
+    out.resize(static_cast<std::size_t>(block.count));
+
+    std::lock_guard<std::mutex> guard(store.ioMutex);
+    if (!store.segment ||
+        std::fseek(store.segment, static_cast<long>(block.offset), SEEK_SET) != 0) {
+        return false;
+    }
+    return std::fread(out.data(), sizeof(ColdRecord), out.size(), store.segment)
+           == out.size();
+}
+
+Transaction fromRecord(const ColdRecord& rec) {
+    Transaction tx(static_cast<TransactionType>(rec.type),
+                   rec.amount,
+                   rec.datetime,
+                   rec.balanceAfter);
+    tx.counterparty = rec.counterparty;
+    tx.transferId   = rec.transferId;
+    return tx;
+}
+
+/// Moves the oldest store.blockSize hot entries to the segment file.
+void spillOldest(HistoryStore& store, AccountHistory& history) {
+    std::vector<ColdRecord> records;
+    records.reserve(static_cast<std::size_t>(store.blockSize));
+
+    Transaction* current = history.head;
+    while (current != nullptr &&
+           static_cast<int>(records.size()) < store.blockSize) {
+        records.push_back(toRecord(*current));
+        current = current->next;
+    }
+
+    // Write first; only drop the nodes once the block is safely on disk.
+    // Blocks all have the same size, so a released slot fits exactly.
+    ColdBlock block;
+    {
+        std::lock_guard<std::mutex> guard(store.ioMutex);
+        const bool reuse = !store.freeBlocks.empty();
+        const std::int64_t offset = reuse ? store.freeBlocks.back() : store.segmentEnd;
+        if (std::fseek(store.segment, static_cast<long>(offset), SEEK_SET) != 0 ||
+            std::fwrite(records.data(), sizeof(ColdRecord), records.size(), store.segment)
+                != records.size()) {
+            std::cerr << "Warning: could not spill history to disk; keeping it in memory.\n";
+            return;
+        }
+        block.offset = offset;
+        if (reuse) {
+            store.freeBlocks.pop_back();
+        } else {
+            store.segmentEnd += static_cast<std::int64_t>(records.size() * sizeof(ColdRecord));
+        }
+    }
+
+    block.firstIndex = history.coldCount;
+    block.count      = static_cast<int>(records.size());
+    block.firstTime  = toTimeKey(records.front().datetime);
+    block.lastTime   = toTimeKey(records.back().datetime);
+    block.closingBalance = records.back().balanceAfter;
+
+    HistoryGarbage garbage;
+    if (history.blockCount == history.blockCapacity) {
+        // Grow into a new array; views may still be reading the old one.
+        long long capacity = history.blockCapacity > 0 ? history.blockCapacity * 2 : 8;
+        ColdBlock* grown = new ColdBlock[static_cast<std::size_t>(capacity)];
+        std::copy(history.blocks, history.blocks + history.blockCount, grown);
+        garbage.oldBlocks     = history.blocks;
+        history.blocks        = grown;
+        history.blockCapacity = capacity;
+    }
+    history.blocks[history.blockCount] = block;
+    ++history.blockCount;
+
+    history.coldCount += block.count;
+    history.hotCount  -= block.count;
+
+    // Unlink the spilled nodes; they are freed later by the owner.
+    garbage.spilled      = history.head;
+    garbage.spilledCount = block.count;
+    history.garbage.push_back(garbage);
+
+    history.head = current;
+    if (history.head == nullptr) {
+        history.tail = nullptr;
+    }
+}
+
+/// Copy of a hot entry that does not touch its `next` link (which a
+/// writer may be setting while a view is read).
+Transaction detachedCopy(const Transaction& tx) {
+    Transaction copy(tx.type, tx.amount, tx.datetime, tx.balanceAfter);
+    copy.counterparty = tx.counterparty;
+    copy.transferId   = tx.transferId;
+    return copy;
+}
+
+/// Walks the hot entries of a view, following `next` only while another
+/// entry of the view is still needed. `visit` returns false to stop.
+template <typename Visit>
+void walkHot(const HistoryView& history, Visit visit) {
+    long long index = history.coldCount;
+    const Transaction* current = history.head;
+    while (index < history.size && current != nullptr) {
+        if (!visit(index, *current)) {
+            return;
+        }
+        if (++index < history.size) {
+            current = current->next;
+        }
+    }
+}
+
+} // namespace
+
+bool initHistoryStore(HistoryStore& store, int hotLimit, int blockSize) {
+    store.hotLimit   = hotLimit > 0 ? hotLimit : kDefaultHotHistoryLimit;
+    store.blockSize  = blockSize > 0 ? blockSize : kDefaultColdBlockSize;
+    if (store.blockSize > store.hotLimit) {
+        store.blockSize = store.hotLimit;
+    }
+    store.segmentEnd = 0;
+    store.freeBlocks.clear();
+    store.segment    = std::tmpfile();
+
+    if (!store.segment) {
+        std::cerr << "Warning: could not create history segment file; "
+                     "all history will stay in memory.\n";
+        return false;
+    }
+    return true;
+}
+
+void closeHistoryStore(HistoryStore& store) {
+    if (store.segment) {
+        std::fclose(store.segment);   // tmpfile() removes itself on close
+        store.segment = nullptr;
+    }
+    store.segmentEnd = 0;
+    store.freeBlocks.clear();
+}
+
+void appendHistory(HistoryStore& store,
+                   AccountHistory& history,
+                   TransactionType type,
+                   double amount,
+                   double balanceAfter,
+                   const std::string& datetime,
+                   int counterparty,
+                   long long transferId) {
+    Transaction* node = new Transaction(type, amount, datetime, balanceAfter, nullptr);
+    node->counterparty = counterparty;
+    node->transferId   = transferId;
+
+    // O(1) append thanks to the tail pointer.
+    if (history.tail == nullptr) {
+        history.head = node;
+    } else {
+        history.tail->next = node;
+    }
+    history.tail = node;
+    ++history.hotCount;
+
+    if (store.segment && history.hotCount > store.hotLimit) {
+        spillOldest(store, history);
+    }
+}
+
+long long historySize(const AccountHistory& history) {
+    return history.coldCount + history.hotCount;
+}
+
+HistoryView viewOf(const AccountHistory& history) {
+    HistoryView view;
+    view.blocks     = history.blocks;
+    view.blockCount = history.blockCount;
+    view.coldCount  = history.coldCount;
+    view.head       = history.head;
+    view.size       = historySize(history);
+    return view;
+}
+
+std::vector<HistoryGarbage> takeHistoryGarbage(AccountHistory& history) {
+    std::vector<HistoryGarbage> taken;
+    taken.swap(history.garbage);
+    return taken;
+}
+
+void freeHistoryGarbage(HistoryGarbage& garbage) {
+    for (int i = 0; i < garbage.spilledCount; ++i) {
+        Transaction* next = garbage.spilled->next;
+        delete garbage.spilled;
+        garbage.spilled = next;
+    }
+    garbage.spilled      = nullptr;
+    garbage.spilledCount = 0;
+    delete[] garbage.oldBlocks;
+    garbage.oldBlocks = nullptr;
+}
+
+std::vector<HistoryGarbage> detachHistory(AccountHistory& history,
+                                          std::vector<std::int64_t>& coldOffsets) {
+    coldOffsets.clear();
+    for (long long b = 0; b < history.blockCount; ++b) {
+        coldOffsets.push_back(history.blocks[b].offset);
+    }
+
+    // The hot list is null-terminated, so freeing hotCount nodes from
+    // head frees all of it.
+    HistoryGarbage whole;
+    whole.spilled      = history.head;
+    whole.spilledCount = history.hotCount;
+    whole.oldBlocks    = history.blocks;
+
+    std::vector<HistoryGarbage> detached = takeHistoryGarbage(history);
+    detached.push_back(whole);
+
+    history.head          = nullptr;
+    history.tail          = nullptr;
+    history.hotCount      = 0;
+    history.coldCount     = 0;
+    history.blocks        = nullptr;
+    history.blockCount    = 0;
+    history.blockCapacity = 0;
+    return detached;
+}
+
+void releaseColdBlocks(HistoryStore& store, const std::vector<std::int64_t>& offsets) {
+    std::lock_guard<std::mutex> guard(store.ioMutex);
+    if (!store.segment) {
+        return;   // store already closed
+    }
+    store.freeBlocks.insert(store.freeBlocks.end(), offsets.begin(), offsets.end());
+}
+
+std::size_t freeColdBlockCount(const HistoryStore& store) {
+    std::lock_guard<std::mutex> guard(store.ioMutex);
+    return store.freeBlocks.size();
+}
+
+bool forEachHistoryEntry(const HistoryStore& store,
+                         const HistoryView& history,
+                         const HistoryVisitor& visit) {
+    long long index = 0;
+
+    // 1) Cold entries, one block at a time.
+    std::vector<ColdRecord> records;
+    for (long long b = 0; b < history.blockCount; ++b) {
+        const ColdBlock& block = history.blocks[b];
+        if (!readBlock(store, block, records)) {
+            std::cerr << "Error: could not read history block from disk.\n";
+            return false;
+        }
+        for (const ColdRecord& rec : records) {
+            visit(index++, fromRecord(rec));
+        }
+    }
+
+    // 2) Hot entries straight from the linked list.
+    walkHot(history, [&](long long i, const Transaction& tx) {
+        visit(i, detachedCopy(tx));
+        return true;
+    });
+    return true;
+}
+
+bool forEachHistoryEntryInRange(const HistoryStore& store,
+                                const HistoryView& history,
+                                long long from,
+                                long long to,
+                                const HistoryVisitor& visit) {
+    from = std::max(from, 0LL);
+    to   = std::min(to, history.size);
+    if (from >= to) {
+        return true;
+    }
+
+    // 1) Cold part: binary search for the block that contains `from`,
+    //    then read blocks until the range is covered.
+    if (from < history.coldCount) {
+        const ColdBlock* begin = history.blocks;
+        const ColdBlock* end   = history.blocks + history.blockCount;
+        const ColdBlock* it = std::upper_bound(begin, end, from,
+                                               [](long long idx, const ColdBlock& b) {
+                                                   return idx < b.firstIndex;
+                                               });
+        --it;   // blocks[0].firstIndex == 0 <= from, so this is valid
+
+        std::vector<ColdRecord> records;
+        for (; it != end && it->firstIndex < to; ++it) {
+            if (!readBlock(store, *it, records)) {
+                std::cerr << "Error: could not read history block from disk.\n";
+                return false;
+            }
+            for (int i = 0; i < it->count; ++i) {
+                long long index = it->firstIndex + i;
+                if (index >= from && index < to) {
+                    visit(index, fromRecord(records[static_cast<std::size_t>(i)]));
+                }
+            }
+        }
+    }
+
+    // 2) Hot part: walk the (bounded) in-memory list.
+    walkHot(history, [&](long long index, const Transaction& tx) {
+        if (index >= to) {
+            return false;
+        }
+        if (index >= from) {
+            visit(index, detachedCopy(tx));
+        }
+        return true;
+    });
+    return true;
+}
+
+long long findFirstEntryAtOrAfter(const HistoryStore& store,
+                                  const HistoryView& history,
+                                  long long timeKey,
+                                  bool strictlyAfter) {
+    auto matches = [&](long long key) {
+        return strictlyAfter ? key > timeKey : key >= timeKey;
+    };
+
+    // 1) First cold block whose newest entry matches; the answer lies
+    //    inside it, or the previous block would have matched already.
+    const ColdBlock* end = history.blocks + history.blockCount;
+    const ColdBlock* it = std::partition_point(history.blocks, end,
+                                               [&](const ColdBlock& b) {
+                                                   return !matches(b.lastTime);
+                                               });
+    if (it != end) {
+        if (matches(it->firstTime)) {
+            return it->firstIndex;
+        }
+        std::vector<ColdRecord> records;
+        if (readBlock(store, *it, records)) {
+            auto rec = std::partition_point(records.begin(), records.end(),
+                                            [&](const ColdRecord& r) {
+                                                return !matches(toTimeKey(r.datetime));
+                                            });
+            return it->firstIndex + (rec - records.begin());
+        }
+        std::cerr << "Error: could not read history block from disk.\n";
+        return it->firstIndex;
+    }
+
+    // 2) Otherwise scan the hot list.
+    long long found = history.size;
+    walkHot(history, [&](long long index, const Transaction& tx) {
+        if (matches(toTimeKey(tx.datetime))) {
+            found = index;
+            return false;
+        }
+        return true;
+    });
+    return found;
+}
+
+namespace {
+
+/// Fills `out` with entries [first + pageOffset, ...) of the range
+/// [first, last), at most pageSize of them.
+bool collectPage(const HistoryStore& store,
+                 const HistoryView& history,
+                 long long first,
+                 long long last,
+                 long long pageOffset,
+                 int pageSize,
+                 HistoryPage& out) {
+    out.entries.clear();
+    out.totalMatches = std::max(last - first, 0LL);
+    out.firstIndex   = first + std::max(pageOffset, 0LL);
+
+    long long pageEnd = std::min(out.firstIndex + std::max(pageSize, 0), last);
+    if (pageEnd > out.firstIndex) {
+        out.entries.reserve(static_cast<std::size_t>(pageEnd - out.firstIndex));
+    }
+    return forEachHistoryEntryInRange(store, history, out.firstIndex, pageEnd,
+                                      [&](long long, const Transaction& tx) {
+                                          out.entries.push_back(tx);
+                                      });
+}
+
+} // namespace
+
+bool queryHistoryByTime(const HistoryStore& store,
+                        const HistoryView& history,
+                        const std::string& from,
+                        const std::string& to,
+                        long long pageOffset,
+                        int pageSize,
+                        HistoryPage& out) {
+    long long first = findFirstEntryAtOrAfter(store, history,
+                                              toTimeKey(from), false);
+    long long last  = findFirstEntryAtOrAfter(store, history,
+                                              toTimeKey(to, true), true);
+    return collectPage(store, history, first, last, pageOffset, pageSize, out);
+}
+
+bool queryRecentHistory(const HistoryStore& store,
+                        const HistoryView& history,
+                        long long count,
+                        long long pageOffset,
+                        int pageSize,
+                        HistoryPage& out) {
+    long long last  = history.size;
+    long long first = std::max(last - std::max(count, 0LL), 0LL);
+    return collectPage(store, history, first, last, pageOffset, pageSize, out);
+}
+
+bool balanceAtTime(const HistoryStore& store,
+                   const HistoryView& history,
+                   double openingBalance,
+                   long long timeKey,
+                   double& out) {
+    out = openingBalance;
+
+    // 1) The newest hot entry at or before timeKey wins if there is one.
+    //    The hot list is short, so a linear walk is fine.
+    bool foundHot = false;
+    walkHot(history, [&](long long, const Transaction& tx) {
+        if (toTimeKey(tx.datetime) > timeKey) {
+            return false;
+        }
+        out = tx.balanceAfter;
+        foundHot = true;
+        return true;
+    });
+    if (foundHot) {
+        return true;
+    }
+
+    // 2) Otherwise find the last cold block starting at or before timeKey.
+    const ColdBlock* it = std::partition_point(history.blocks,
+                                               history.blocks + history.blockCount,
+                                               [&](const ColdBlock& b) {
+                                                   return b.firstTime <= timeKey;
+                                               });
+    if (it == history.blocks) {
+        return true;   // everything happened later: opening balance
+    }
+    --it;
+
+    // 3) Checkpoint hit: the whole block is at or before timeKey.
+    if (it->lastTime <= timeKey) {
+        out = it->closingBalance;
+        return true;
+    }
+
+    // 4) timeKey falls inside this block: read it and binary search.
+    std::vector<ColdRecord> records;
+    if (!readBlock(store, *it, records)) {
+        std::cerr << "Error: could not read history block from disk.\n";
+        return false;
+    }
+    auto rec = std::partition_point(records.begin(), records.end(),
+                                    [&](const ColdRecord& r) {
+                                        return toTimeKey(r.datetime) <= timeKey;
+                                    });
+    // rec != begin because the block's firstTime <= timeKey.
+    out = (rec - 1)->balanceAfter;
+    return true;
+}
+
+void freeHistory(AccountHistory& history) {
+    freeTransactions(history.head);
+    history.tail      = nullptr;
+    history.hotCount  = 0;
+    history.coldCount = 0;
+
+    delete[] history.blocks;
+    history.blocks        = nullptr;
+    history.blockCount    = 0;
+    history.blockCapacity = 0;
+
+    for (HistoryGarbage& garbage : history.garbage) {
+        freeHistoryGarbage(garbage);
+    }
+    history.garbage.clear();
+}
+
+} // namespace bank
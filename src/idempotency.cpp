@@ -0,0 +1,170 @@
+#include "idempotency.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+
+namespace bank {
+
+namespace {
+
+IdempotencyStripe& stripeFor(IdempotencyCache& cache, const std::string& key) {
+    const std::size_t hash = std::hash<std::string_view>()(key);
+    return cache.stripes[hash % kIdempotencyStripes];
+}
+
+/// Drops the least recently used entry. Caller holds the stripe lock.
+void evictOldest(IdempotencyStripe& stripe) {
+    stripe.index.erase(stripe.entries.back().key);
+    stripe.entries.pop_back();
+}
+
+/// Drops expired entries from the old end, then the oldest ones while
+/// the stripe holds more than `capacity`. Caller holds the stripe lock.
+void trim(IdempotencyStripe& stripe, std::size_t capacity, long long now) {
+    while (!stripe.entries.empty() &&
+           (stripe.entries.size() > capacity || stripe.entries.back().expires <= now)) {
+        evictOldest(stripe);
+    }
+}
+
+/// FNV-1a over `size` bytes, continuing from `hash`.
+std::uint64_t mixBytes(std::uint64_t hash, const void* data, std::size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (std::size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+} // namespace
+
+std::uint64_t requestFingerprint(const char* operation,
+                                 int account,
+                                 int counterparty,
+                                 double amount) {
+    std::uint64_t hash = 14695981039346656037ULL;
+    hash = mixBytes(hash, operation, std::strlen(operation) + 1);
+    hash = mixBytes(hash, &account, sizeof(account));
+    hash = mixBytes(hash, &counterparty, sizeof(counterparty));
+    hash = mixBytes(hash, &amount, sizeof(amount));
+    return hash;
+}
+
+IdempotencyClaim claimIdempotencyKey(IdempotencyCache& cache,
+                                     const std::string& key,
+                                     std::uint64_t fingerprint,
+                                     long long now,
+                                     OperationStatus& outcome) {
+    IdempotencyStripe& stripe = stripeFor(cache, key);
+    std::lock_guard<std::mutex> guard(stripe.mutex);
+
+    auto found = stripe.index.find(key);
+    if (found != stripe.index.end()) {
+        IdempotencyStripe::List::iterator entry = found->second;
+        if (entry->expires > now) {
+            // Most recently used again.
+            stripe.entries.splice(stripe.entries.begin(), stripe.entries, entry);
+            if (entry->fingerprint != fingerprint) {
+                return IdempotencyClaim::Mismatch;
+            }
+            if (!entry->done) {
+                return IdempotencyClaim::InProgress;
+            }
+            outcome = entry->outcome;
+            return IdempotencyClaim::Done;
+        }
+        stripe.index.erase(found);   // expired: a new request
+        stripe.entries.erase(entry);
+    }
+
+    // Make room first (never below one entry, so the new key is kept).
+    trim(stripe, std::max<std::size_t>(cache.capacityPerStripe.load(), 1) - 1, now);
+
+    IdempotencyEntry fresh;
+    fresh.key         = key;
+    fresh.fingerprint = fingerprint;
+    fresh.expires     = now + cache.ttlSeconds.load();
+    stripe.entries.push_front(std::move(fresh));
+    stripe.index.emplace(stripe.entries.front().key, stripe.entries.begin());
+    return IdempotencyClaim::New;
+}
+
+void completeIdempotencyKey(IdempotencyCache& cache,
+                            const std::string& key,
+                            OperationStatus outcome) {
+    IdempotencyStripe& stripe = stripeFor(cache, key);
+    std::lock_guard<std::mutex> guard(stripe.mutex);
+
+    auto found = stripe.index.find(key);
+    if (found == stripe.index.end()) {
+        return;   // evicted while the request ran
+    }
+    found->second->outcome = outcome;
+    found->second->done    = true;
+}
+
+void releaseIdempotencyKey(IdempotencyCache& cache, const std::string& key) {
+    IdempotencyStripe& stripe = stripeFor(cache, key);
+    std::lock_guard<std::mutex> guard(stripe.mutex);
+
+    auto found = stripe.index.find(key);
+    if (found == stripe.index.end() || found->second->done) {
+        return;
+    }
+    IdempotencyStripe::List::iterator entry = found->second;
+    stripe.index.erase(found);
+    stripe.entries.erase(entry);
+}
+
+void configureIdempotency(IdempotencyCache& cache,
+                          std::size_t capacity,
+                          long long ttlSeconds) {
+    const std::size_t perStripe = std::max<std::size_t>(capacity / kIdempotencyStripes, 1);
+    cache.capacityPerStripe.store(perStripe);
+    cache.ttlSeconds.store(ttlSeconds);
+
+    const long long now = idempotencyNow();
+    for (IdempotencyStripe& stripe : cache.stripes) {
+        std::lock_guard<std::mutex> guard(stripe.mutex);
+        trim(stripe, perStripe, now);
+    }
+}
+
+void measureIdempotency(IdempotencyCache& cache, std::size_t& keys, std::size_t& bytes) {
+    static const std::size_t inlineCapacity = std::string().capacity();
+    keys  = 0;
+    bytes = 0;
+    for (IdempotencyStripe& stripe : cache.stripes) {
+        std::lock_guard<std::mutex> guard(stripe.mutex);
+        keys += stripe.entries.size();
+        // List node (two links + entry), map node (next, key, iterator,
+        // cached hash) and the buckets.
+        bytes += stripe.entries.size() * (2 * sizeof(void*) + sizeof(IdempotencyEntry))
+               + stripe.index.size() * (2 * sizeof(void*) + sizeof(std::string_view)
+                                        + sizeof(std::size_t))
+               + stripe.index.bucket_count() * sizeof(void*);
+        for (const IdempotencyEntry& entry : stripe.entries) {
+            if (entry.key.capacity() > inlineCapacity) {
+                bytes += entry.key.capacity() + 1;
+            }
+        }
+    }
+}
+
+void clearIdempotency(IdempotencyCache& cache) {
+    for (IdempotencyStripe& stripe : cache.stripes) {
+        std::lock_guard<std::mutex> guard(stripe.mutex);
+        stripe.index.clear();
+        stripe.entries.clear();
+    }
+}
+
+long long idempotencyNow() {
+    return static_cast<long long>(std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+} // namespace bank
@@ -1,35 +1,173 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <vector>
 #include <iostream>
 
-#include "/Users/xojambetov_islam/CLionProjects/bankingSystem/include/bank_service.h"
-#include "/Users/xojambetov_islam/CLionProjects/bankingSystem/include/ui.h"
-#include "/Users/xojambetov_islam/CLionProjects/bankingSystem/include/auth.h"
-#include "/Users/xojambetov_islam/CLionProjects/bankingSystem/include/persistence.h"
+#include "bank_service.h"
+#include "commands.h"
+#include "ui.h"
+#include "auth.h"
+#include "persistence.h"
+#include "sharded_bank.h"
+#ifdef BANK_WITH_SERVER
+#include "server.h"
+#endif
 
-int main() {
+namespace {
+
+/// Sends std::cout to std::cerr while alive, so that in batch mode the
+/// loader's and saver's messages do not mix with the result lines.
+struct CoutToCerr {
+    CoutToCerr() : saved(std::cout.rdbuf(std::cerr.rdbuf())) {}
+    ~CoutToCerr() { std::cout.rdbuf(saved); }
+
+    CoutToCerr(const CoutToCerr&) = delete;
+    CoutToCerr& operator=(const CoutToCerr&) = delete;
+
+    std::streambuf* saved;
+};
+
+/// Opens the command file `file` ("-" = stdin) of a batch mode.
+/// @return the stream to read, or nullptr (after a message) if it cannot be opened.
+std::istream* openCommands(const char* file, std::ifstream& fileIn) {
+    if (std::strcmp(file, "-") == 0) {
+        return &std::cin;
+    }
+    fileIn.open(file);
+    if (!fileIn.is_open()) {
+        std::cerr << "Error: could not open command file '" << file << "'.\n";
+        return nullptr;
+    }
+    return &fileIn;
+}
+
+void printBatchSummary(const bank::BatchSummary& summary) {
+    std::cerr << "Batch done: " << summary.commands << " commands, "
+              << summary.failed << " failed.\n";
+}
+
+/// Batch mode: runs the commands of `file` ("-" = stdin) without login,
+/// prompts or pauses (see commands.h); results go to stdout.
+int runBatchMode(bank::Bank& bank, const char* file) {
+    std::ifstream fileIn;
+    std::istream* in = openCommands(file, fileIn);
+    if (in == nullptr) {
+        return 2;
+    }
+    printBatchSummary(bank::runBatch(bank, *in, std::cout));
+    return 0;
+}
+
+/// Sharded batch mode: like the batch mode, over `shards` shards (see
+/// sharded_bank.h), each loaded from and saved to its own pair of files
+/// (accounts.shard<i>-of-<n>.csv, transactions.shard<i>-of-<n>.csv).
+/// Refuses to start if files of another shard count are present.
+int runShardedMode(const char* shards, const char* file) {
     using namespace bank;
 
+    std::ifstream fileIn;
+    std::istream* in = openCommands(file, fileIn);
+    if (in == nullptr) {
+        return 2;
+    }
+
+    // Accounts are placed by the shard count: files of another count
+    // cannot be read, and starting empty would fork a second data set.
+    const int shardCount = std::max(shards != nullptr ? std::atoi(shards) : 1, 1);
+    for (const char* file : {"accounts.csv", "transactions.csv"}) {
+        if (std::size_t found = otherShardCountOnDisk(file, shardCount)) {
+            std::cerr << "Error: '" << shardFileName(file, 0, found) << "' was written with "
+                      << found << " shards; run with --sharded " << found << ".\n";
+            return 2;
+        }
+    }
+
+    ShardedBank sharded;
+    initShardedBank(sharded, shardCount);
+    {
+        CoutToCerr quiet;
+        shardedLoad(sharded, "accounts.csv", "transactions.csv");
+    }
+
+    printBatchSummary(runShardedBatch(sharded, *in, std::cout));
+
+    int exitCode = 0;
+    if (!shardedSave(sharded, "accounts.csv", "transactions.csv")) {
+        std::cerr << "Warning: failed to save bank data.\n";
+        exitCode = 1;
+    }
+    destroyShardedBank(sharded);
+    return exitCode;
+}
+
+#ifdef BANK_WITH_SERVER
+/// Server mode: serves the wire protocol on `socketPath` (see server.h)
+/// until SIGINT / SIGTERM.
+int runServerMode(bank::Bank& bank, const char* socketPath, const char* threads) {
+    bank::ServerOptions options;
+    options.socketPath = socketPath;
+    if (threads != nullptr) {
+        options.threads = static_cast<unsigned>(std::max(0, std::atoi(threads)));
+    }
+    return bank::runServer(bank, options) ? 0 : 1;
+}
+#endif
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    using namespace bank;
+
+    // `bankingSystem --batch [file]` runs a command file instead of the menu,
+    // `bankingSystem --sharded <shards> [file]` does so over sharded storage,
+    // `bankingSystem --serve [socket] [threads]` serves clients (Linux).
+    const bool batch = argc >= 2 && std::strcmp(argv[1], "--batch") == 0;
+    const bool serve = argc >= 2 && std::strcmp(argv[1], "--serve") == 0;
+    if (argc >= 2 && std::strcmp(argv[1], "--sharded") == 0) {
+        return runShardedMode(argc >= 3 ? argv[2] : nullptr, argc >= 4 ? argv[3] : "-");
+    }
+
     Bank bank;
     initBank(bank);
 
     // 1) Try to load existing data (accounts + histories)
-    loadBankFromFiles(bank, "accounts.csv", "transactions.csv");
+    if (batch) {
+        CoutToCerr quiet;
+        loadBankFromFiles(bank, "accounts.csv", "transactions.csv");
+    } else {
+        loadBankFromFiles(bank, "accounts.csv", "transactions.csv");
+    }
 
-    // 2) Initialize list of system users and perform login
-    std::vector<User> users;
-    initUsers(users);
+    int exitCode = 0;
+    if (batch) {
+        exitCode = runBatchMode(bank, argc >= 3 ? argv[2] : "-");
+    } else if (serve) {
+#ifdef BANK_WITH_SERVER
+        exitCode = runServerMode(bank, argc >= 3 ? argv[2] : "bank.sock",
+                                 argc >= 4 ? argv[3] : nullptr);
+#else
+        std::cerr << "Error: server mode is not available on this platform.\n";
+        exitCode = 2;
+#endif
+    } else {
+        // 2) Initialize list of system users and perform login
+        std::vector<User> users;
+        initUsers(users);
 
-    // Important: Before using std::getline in login(), make sure
-    // there is no leftover newline in cin (on some setups).
-    // Here it's safe because we haven't read anything yet.
+        // Important: Before using std::getline in login(), make sure
+        // there is no leftover newline in cin (on some setups).
+        // Here it's safe because we haven't read anything yet.
 
-    if (!login(users)) {
-        destroyBank(bank);
-        return 0;
-    }
+        if (!login(users)) {
+            destroyBank(bank);
+            return 0;
+        }
 
-    // 3) After successful login, run the main banking menu
-    runMainMenu(bank);
+        // 3) After successful login, run the main banking menu
+        runMainMenu(bank);
+    }
 
     // 4) Save current state before exit
     if (!saveBankToFiles(bank, "accounts.csv", "transactions.csv")) {
@@ -37,5 +175,5 @@ int main() {
     }
 
     destroyBank(bank);
-    return 0;
+    return exitCode;
 }
@@ -0,0 +1,227 @@
+#include "memory_usage.h"
+
+#include "snapshot.h"
+
+#include <iostream>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+
+namespace bank {
+
+namespace {
+
+/// Bytes of the heap buffer of `s` (0 while it fits the in-place buffer).
+std::size_t stringHeapBytes(const std::string& s) {
+    static const std::size_t inlineCapacity = std::string().capacity();
+    return s.capacity() > inlineCapacity ? s.capacity() + 1 : 0;
+}
+
+/// Estimated size of one std::set node holding a T (color, parent, left,
+/// right, value).
+template <typename T>
+constexpr std::size_t setNodeBytes() {
+    return 4 * sizeof(void*) + sizeof(T);
+}
+
+/// Estimated size of one std::unordered_set node holding a T (next,
+/// value, cached hash).
+template <typename T>
+constexpr std::size_t hashNodeBytes() {
+    return sizeof(void*) + sizeof(T) + sizeof(std::size_t);
+}
+
+void addString(MemoryFootprint& footprint, const std::string& s) {
+    std::size_t bytes = stringHeapBytes(s);
+    if (bytes > 0) {
+        ++footprint.objects;
+        footprint.bytes += bytes;
+    }
+}
+
+/// Hot list and cold index of one history, plus its pending garbage.
+/// Caller holds the account lock.
+void measureHistory(const AccountHistory& history, MemoryUsage& usage) {
+    const Transaction* tx = history.head;
+    for (int i = 0; i < history.hotCount && tx; ++i, tx = tx->next) {
+        ++usage.historyEntries.objects;
+        usage.historyEntries.bytes += sizeof(Transaction);
+        addString(usage.historyStrings, tx->datetime);
+    }
+
+    usage.historyBlocks.objects += static_cast<std::size_t>(history.blockCount);
+    usage.historyBlocks.bytes   += static_cast<std::size_t>(history.blockCapacity) * sizeof(ColdBlock);
+    usage.coldEntries           += history.coldCount;
+
+    usage.historyGarbage.bytes += history.garbage.capacity() * sizeof(HistoryGarbage);
+    for (const HistoryGarbage& garbage : history.garbage) {
+        const Transaction* node = garbage.spilled;
+        for (int i = 0; i < garbage.spilledCount && node; ++i, node = node->next) {
+            ++usage.historyGarbage.objects;
+            usage.historyGarbage.bytes += sizeof(Transaction) + stringHeapBytes(node->datetime);
+        }
+        if (garbage.oldBlocks) {
+            ++usage.historyGarbage.objects;   // its capacity is not recorded
+        }
+    }
+}
+
+/// One row of the JSON output and the table.
+struct FootprintField {
+    const char*                      key;
+    const char*                      label;
+    MemoryFootprint MemoryUsage::*   member;
+};
+
+const FootprintField kFields[] = {
+    {"account_nodes",    "Account nodes",    &MemoryUsage::accountNodes},
+    {"account_versions", "Account versions", &MemoryUsage::accountVersions},
+    {"holder_names",     "Holder names",     &MemoryUsage::holderNames},
+    {"history_entries",  "History entries",  &MemoryUsage::historyEntries},
+    {"history_strings",  "History strings",  &MemoryUsage::historyStrings},
+    {"history_blocks",   "Cold block index", &MemoryUsage::historyBlocks},
+    {"history_garbage",  "History garbage",  &MemoryUsage::historyGarbage},
+    {"balance_index",    "Balance index",    &MemoryUsage::balanceIndex},
+    {"name_index",       "Name index",       &MemoryUsage::nameIndex},
+    {"pending_queue",    "Pending queue",    &MemoryUsage::pendingQueue},
+    {"interest_epochs",  "Interest epochs",  &MemoryUsage::interestEpochs},
+    {"velocity_windows", "Velocity windows", &MemoryUsage::velocityWindows},
+    {"idempotency_keys", "Idempotency keys", &MemoryUsage::idempotencyKeys},
+};
+
+} // namespace
+
+std::size_t MemoryUsage::totalBytes() const {
+    std::size_t total = 0;
+    for (const FootprintField& field : kFields) {
+        total += (this->*field.member).bytes;
+    }
+    return total;
+}
+
+template <typename BankT>
+MemoryUsage measureMemory(BankT& bank) {
+    MemoryUsage usage;
+
+    // ---- Account tree, versions and histories ----
+    {
+        ReadSnapshot pin(bank.epochs);   // keeps nodes and versions alive
+
+        BankT::Index::forEach(bank.accountsRoot, [&](AccountNode* node) {
+            ++usage.accountNodes.objects;
+            usage.accountNodes.bytes += sizeof(AccountNode);
+
+            for (const AccountVersion* version = node->version.load();
+                 version; version = version->older.load()) {
+                ++usage.accountVersions.objects;
+                usage.accountVersions.bytes += sizeof(AccountVersion);
+            }
+
+            {
+                std::lock_guard<std::mutex> guard(node->lock);
+                measureHistory(node->data.history, usage);
+                if (node->data.velocity) {
+                    ++usage.velocityWindows.objects;
+                    usage.velocityWindows.bytes += velocityStateBytes(node->data.velocity);
+                }
+            }
+        });
+        usage.accountNodes.bytes += BankT::Index::bytes(bank.accountsRoot);
+    }
+
+    // ---- Holder names ----
+    {
+        NamePool& pool = bank.namePool;
+        std::lock_guard<std::mutex> guard(pool.mutex);
+        usage.holderNames.objects = pool.names.size();
+        usage.holderNames.bytes   = pool.bytes
+                                  + pool.chunks.capacity() * sizeof(pool.chunks[0])
+                                  + pool.names.size() * hashNodeBytes<std::string_view>()
+                                  + pool.names.bucket_count() * sizeof(void*);
+    }
+
+    // ---- Secondary indexes ----
+    for (const BalanceIndexStripe& stripe : bank.balanceIndex.stripes) {
+        std::shared_lock<std::shared_mutex> guard(stripe.mutex);
+        usage.balanceIndex.objects += stripe.entries.size();
+        usage.balanceIndex.bytes   += stripe.entries.size() * setNodeBytes<BalanceIndexEntry>();
+    }
+    {
+        const NameIndex& index = bank.nameIndex;
+        std::shared_lock<std::shared_mutex> guard(index.mutex);
+        // The folded names are in the name pool.
+        const std::size_t sets = index.delta.size() + index.frozen.size();
+        usage.nameIndex.objects = index.table.size() + sets;
+        usage.nameIndex.bytes   = index.table.capacity() * sizeof(NameEntry)
+                                + sets * setNodeBytes<NameEntry>();
+    }
+
+    // ---- Pending queue ----
+    {
+        std::lock_guard<std::mutex> guard(bank.queueMutex);
+        usage.pendingQueue.objects = BankT::Queue::size(bank.pendingQueue);
+        usage.pendingQueue.bytes   = BankT::Queue::bytes(bank.pendingQueue);
+    }
+
+    // ---- Interest postings ----
+    {
+        std::shared_lock<std::shared_mutex> guard(bank.interestMutex);
+        usage.interestEpochs.objects = bank.interestEpochs.size();
+        usage.interestEpochs.bytes   = bank.interestEpochs.capacity() * sizeof(InterestEpoch);
+        for (const InterestEpoch& epoch : bank.interestEpochs) {
+            usage.interestEpochs.bytes += stringHeapBytes(epoch.datetime);
+        }
+    }
+
+    // ---- Idempotency keys ----
+    measureIdempotency(bank.idempotency,
+                       usage.idempotencyKeys.objects,
+                       usage.idempotencyKeys.bytes);
+
+    // ---- Reclamation and the segment file ----
+    for (RetireShard& shard : bank.epochs.retired) {
+        std::lock_guard<std::mutex> guard(shard.mutex);
+        usage.retiredObjects += shard.objects.size();
+    }
+    {
+        std::lock_guard<std::mutex> guard(bank.historyStore.ioMutex);
+        usage.segmentBytes = bank.historyStore.segmentEnd;
+    }
+
+    return usage;
+}
+
+void writeMemoryJson(std::ostream& out, const MemoryUsage& usage) {
+    out << '{';
+    for (const FootprintField& field : kFields) {
+        const MemoryFootprint& footprint = usage.*field.member;
+        out << '"' << field.key << "\":{\"objects\":" << footprint.objects
+            << ",\"bytes\":" << footprint.bytes << "},";
+    }
+    out << "\"retired_objects\":" << usage.retiredObjects
+        << ",\"cold_entries\":" << usage.coldEntries
+        << ",\"segment_bytes\":" << usage.segmentBytes
+        << ",\"total_bytes\":" << usage.totalBytes() << '}';
+}
+
+void printMemoryUsage(const MemoryUsage& usage) {
+    for (const FootprintField& field : kFields) {
+        const MemoryFootprint& footprint = usage.*field.member;
+        std::cout << field.label
+                  << " | Objects: " << footprint.objects
+                  << " | Bytes: "   << footprint.bytes << '\n';
+    }
+    std::cout << "Total: " << usage.totalBytes() << " bytes in memory\n";
+    std::cout << "Waiting for reclamation: " << usage.retiredObjects << " objects\n";
+    std::cout << "On disk: " << usage.coldEntries << " history entries, "
+              << usage.segmentBytes << " bytes of segment file\n";
+}
+
+// Built for every bank type (see BANK_FOR_EACH_BANK_TYPE).
+#define INSTANTIATE_MEMORY_USAGE(B) \
+    template MemoryUsage measureMemory<B>(B&);
+BANK_FOR_EACH_BANK_TYPE(INSTANTIATE_MEMORY_USAGE)
+#undef INSTANTIATE_MEMORY_USAGE
+
+} // namespace bank
@@ -0,0 +1,238 @@
+#include "name_index.h"
+
+#include <algorithm>
+#include <cctype>
+#include <mutex>
+
+namespace bank {
+
+namespace {
+
+/// The delta is merged once it holds this many entries...
+constexpr std::size_t kMinDeltaSize = 4096;
+
+/// ...or 1/kDeltaFraction of the table, whichever is larger, so merging
+/// (linear in the table) costs O(kDeltaFraction) per insert amortized.
+constexpr std::size_t kDeltaFraction = 8;
+
+/// Has the delta (or the tombstone count) grown enough to merge?
+bool mergeDue(const NameIndex& index) {
+    const std::size_t limit = std::max(kMinDeltaSize, index.table.size() / kDeltaFraction);
+    return index.delta.size() >= limit || index.removed >= limit;
+}
+
+/// Sets the delta aside for a merge if one is due (or `force`) and none
+/// is running. Caller holds the lock exclusively.
+/// @return true if the caller is to run the merge (see finishMerge).
+bool startMerge(NameIndex& index, bool force) {
+    if (index.merging || (!force && !mergeDue(index))) {
+        return false;
+    }
+    index.merging = true;
+    index.frozen.swap(index.delta);   // the delta is empty now
+    return true;
+}
+
+/// Makes the entry of `entry.node` in `table` a tombstone.
+/// @return false if it is not there.
+bool tombstone(std::vector<NameEntry>& table, const NameEntry& entry) {
+    // Equal keys may include tombstones of earlier accounts with this number.
+    auto t = std::lower_bound(table.begin(), table.end(), entry, NameEntryLess());
+    for (; t != table.end() && !NameEntryLess()(entry, *t); ++t) {
+        if (t->node == entry.node) {
+            t->node = nullptr;
+            return true;
+        }
+    }
+    return false;
+}
+
+/// Builds the next table from the table and the frozen delta, dropping
+/// the tombstones, then swaps it in. Called without the lock, after
+/// startMerge: while merging, nothing changes either source.
+void finishMerge(NameIndex& index) {
+    std::vector<NameEntry> merged;
+    merged.reserve(index.table.size() - index.removed + index.frozen.size());
+
+    NameEntryLess less;
+    auto f = index.frozen.begin();
+    for (const NameEntry& entry : index.table) {
+        if (entry.node == nullptr) {
+            continue;
+        }
+        while (f != index.frozen.end() && less(*f, entry)) {
+            merged.push_back(*f++);
+        }
+        merged.push_back(entry);
+    }
+    merged.insert(merged.end(), f, index.frozen.end());
+
+    std::unique_lock<std::shared_mutex> guard(index.mutex);
+    index.table.swap(merged);   // the old table is freed after the unlock
+    index.frozen.clear();
+    index.removed = 0;
+    for (const NameEntry& entry : index.lateErase) {
+        if (tombstone(index.table, entry)) {
+            ++index.removed;
+        }
+    }
+    index.lateErase.clear();
+    index.lateErasedNodes.clear();
+    index.merging = false;
+}
+
+/// Does a folded name fall in the range a query covers?
+bool inRange(std::string_view folded, const std::string& key, NameMatch how) {
+    if (how == NameMatch::Prefix) {
+        return folded.compare(0, key.size(), key) == 0;
+    }
+    return folded == key;
+}
+
+} // namespace
+
+std::string foldName(std::string_view name) {
+    std::string folded(name);
+    for (char& c : folded) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return folded;
+}
+
+void nameIndexInsert(NameIndex& index, NamePool& pool, const AccountNode* node) {
+    const NameEntry entry{internName(pool, foldName(node->data.holderName.view())),
+                          node->data.accountNumber, node};
+
+    bool merge = false;
+    {
+        std::unique_lock<std::shared_mutex> guard(index.mutex);
+        index.delta.insert(entry);
+        merge = startMerge(index, false);
+    }
+    if (merge) {
+        finishMerge(index);
+    }
+}
+
+void nameIndexErase(NameIndex& index, const AccountNode* node) {
+    const std::string folded = foldName(node->data.holderName.view());
+    const NameEntry entry{PooledName{folded.c_str()}, node->data.accountNumber, node};
+
+    bool merge = false;
+    {
+        std::unique_lock<std::shared_mutex> guard(index.mutex);
+        auto d = index.delta.find(entry);
+        if (d != index.delta.end() && d->node == node) {
+            index.delta.erase(d);
+            return;
+        }
+
+        if (index.merging) {
+            // The merge is reading the table and the frozen delta: note the
+            // entry (its own copy, whose key is pooled) for the new table.
+            auto f = index.frozen.find(entry);
+            if (f != index.frozen.end() && f->node == node) {
+                index.lateErase.push_back(*f);
+            } else {
+                auto t = std::lower_bound(index.table.begin(), index.table.end(), entry,
+                                          NameEntryLess());
+                for (; t != index.table.end() && !NameEntryLess()(entry, *t); ++t) {
+                    if (t->node == node) {
+                        index.lateErase.push_back(*t);
+                        break;
+                    }
+                }
+            }
+            index.lateErasedNodes.insert(node);
+            return;
+        }
+
+        // In the table: leave a tombstone rather than shifting the array.
+        if (tombstone(index.table, entry)) {
+            ++index.removed;
+        }
+        merge = startMerge(index, false);
+    }
+    if (merge) {
+        finishMerge(index);
+    }
+}
+
+void compactNameIndex(NameIndex& index) {
+    bool merge = false;
+    {
+        std::unique_lock<std::shared_mutex> guard(index.mutex);
+        merge = startMerge(index, true);
+    }
+    if (merge) {
+        finishMerge(index);
+    }
+}
+
+void nameIndexHandles(NameIndex& index, std::vector<PooledName*>& handles) {
+    std::unique_lock<std::shared_mutex> guard(index.mutex);
+    for (NameEntry& entry : index.table) {
+        handles.push_back(&entry.folded);
+    }
+}
+
+std::vector<int> nameIndexFind(const NameIndex& index,
+                               const std::string& query,
+                               NameMatch how,
+                               std::size_t limit) {
+    std::vector<int> result;
+    const std::string key = foldName(query);
+    // Sorts before every entry with this folded name (or prefix).
+    const NameEntry first{PooledName{key.c_str()}, std::numeric_limits<int>::min(), nullptr};
+    NameEntryLess less;
+
+    std::shared_lock<std::shared_mutex> guard(index.mutex);
+
+    // All sources are sorted: binary search each, then walk them together.
+    auto t    = std::lower_bound(index.table.begin(), index.table.end(), first, less);
+    auto tEnd = index.table.end();
+    auto f    = index.frozen.lower_bound(first);
+    auto fEnd = index.frozen.end();
+    auto d    = index.delta.lower_bound(first);
+    auto dEnd = index.delta.end();
+
+    while (result.size() < limit) {
+        bool tOk = t != tEnd && inRange(t->folded.view(), key, how);
+        bool fOk = f != fEnd && inRange(f->folded.view(), key, how);
+        bool dOk = d != dEnd && inRange(d->folded.view(), key, how);
+        if (!tOk && !fOk && !dOk) {
+            break;
+        }
+
+        const NameEntry* entry = nullptr;
+        if (dOk && (!tOk || less(*d, *t)) && (!fOk || less(*d, *f))) {
+            entry = &*d++;
+        } else {
+            entry = (tOk && (!fOk || less(*t, *f))) ? &*t++ : &*f++;
+            if (!index.lateErasedNodes.empty() && index.lateErasedNodes.count(entry->node) != 0) {
+                continue;   // closed during a merge
+            }
+        }
+        if (entry->node == nullptr) {
+            continue;   // closed account
+        }
+        if (how == NameMatch::Exact && entry->node->data.holderName != query) {
+            continue;   // same name in another case
+        }
+        result.push_back(entry->accountNumber);
+    }
+    return result;
+}
+
+void clearNameIndex(NameIndex& index) {
+    std::unique_lock<std::shared_mutex> guard(index.mutex);
+    index.table.clear();
+    index.delta.clear();
+    index.removed = 0;
+    index.frozen.clear();
+    index.lateErase.clear();
+    index.lateErasedNodes.clear();
+    index.merging = false;
+}
+
+} // namespace bank
@@ -0,0 +1,69 @@
+#include "name_pool.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace bank {
+
+PooledName internName(NamePool& pool, std::string_view name) {
+    if (name.empty()) {
+        return PooledName{};
+    }
+
+    std::lock_guard<std::mutex> guard(pool.mutex);
+    auto found = pool.names.find(name);
+    if (found != pool.names.end()) {
+        return PooledName{found->data()};
+    }
+
+    // Copy into the last chunk, or start a new one if it does not fit.
+    const std::size_t needed = name.size() + 1;   // + '\0'
+    if (pool.chunks.empty() || pool.chunkUsed + needed > kNamePoolChunkSize) {
+        const std::size_t size = std::max(kNamePoolChunkSize, needed);
+        pool.chunks.push_back(std::make_unique<char[]>(size));
+        pool.chunkUsed = 0;
+        pool.bytes += size;
+    }
+    char* chars = pool.chunks.back().get() + pool.chunkUsed;
+    std::memcpy(chars, name.data(), name.size());
+    chars[name.size()] = '\0';
+    pool.chunkUsed += needed;
+
+    pool.names.insert(std::string_view(chars, name.size()));
+    return PooledName{chars};
+}
+
+std::size_t namePoolSize(NamePool& pool) {
+    std::lock_guard<std::mutex> guard(pool.mutex);
+    return pool.names.size();
+}
+
+std::size_t namePoolBytes(NamePool& pool) {
+    std::lock_guard<std::mutex> guard(pool.mutex);
+    return pool.bytes;
+}
+
+std::size_t compactNamePool(NamePool& pool, const std::vector<PooledName*>& handles) {
+    NamePool fresh;
+    for (PooledName* handle : handles) {
+        *handle = internName(fresh, handle->view());
+    }
+
+    std::lock_guard<std::mutex> guard(pool.mutex);
+    const std::size_t released = pool.bytes > fresh.bytes ? pool.bytes - fresh.bytes : 0;
+    pool.chunks.swap(fresh.chunks);
+    pool.names.swap(fresh.names);
+    pool.chunkUsed = fresh.chunkUsed;
+    pool.bytes     = fresh.bytes;
+    return released;
+}
+
+void freeNamePool(NamePool& pool) {
+    std::lock_guard<std::mutex> guard(pool.mutex);
+    pool.names.clear();
+    pool.chunks.clear();
+    pool.chunkUsed = 0;
+    pool.bytes = 0;
+}
+
+} // namespace bank
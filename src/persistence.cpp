@@ -1,21 +1,29 @@
 #include "persistence.h"
 
 #include "account_bst.h"
+#include "snapshot.h"
+#include "stats.h"
+#include "trace.h"
 #include "transaction_list.h"
 
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
+#include <vector>
 
 namespace bank {
 
 /// Convert enum TransactionType to string for CSV.
 static const char* transactionTypeToString(TransactionType type) {
     switch (type) {
-        case TransactionType::Deposit:  return "Deposit";
-        case TransactionType::Withdraw: return "Withdraw";
-        case TransactionType::Interest: return "Interest";
-        default:                        return "Unknown";
+        case TransactionType::Deposit:     return "Deposit";
+        case TransactionType::Withdraw:    return "Withdraw";
+        case TransactionType::Interest:    return "Interest";
+        case TransactionType::TransferOut: return "TransferOut";
+        case TransactionType::TransferIn:  return "TransferIn";
+        default:                           return "Unknown";
     }
 }
 
@@ -35,65 +43,308 @@ static bool stringToTransactionType(const std::string& s,
         out = TransactionType::Interest;
         return true;
     }
+    if (s == "TransferOut") {
+        out = TransactionType::TransferOut;
+        return true;
+    }
+    if (s == "TransferIn") {
+        out = TransactionType::TransferIn;
+        return true;
+    }
     return false;
 }
 
-/// Helper: recursively save accounts + their transactions (in-order traversal).
-static void saveAccountsInorder(const AccountNode* node,
-                                std::ofstream& accountsOut,
-                                std::ofstream& txOut) {
-    if (!node) {
-        return;
+/// Column name -> position, built from a CSV header line.
+using ColumnMap = std::unordered_map<std::string, std::size_t>;
+
+/// Splits one CSV line on ','.
+static std::vector<std::string> splitCsvLine(const std::string& line) {
+    std::vector<std::string> fields;
+    std::stringstream ss(line);
+    std::string field;
+    while (std::getline(ss, field, ',')) {
+        fields.push_back(field);
+    }
+    return fields;
+}
+
+/// Reads the header line so columns can be found by name.
+static ColumnMap readHeader(const std::string& line) {
+    ColumnMap cols;
+    std::vector<std::string> names = splitCsvLine(line);
+    for (std::size_t i = 0; i < names.size(); ++i) {
+        cols[names[i]] = i;
     }
+    return cols;
+}
+
+/// Position of a named column, or `fallback` if the header lacks it.
+static std::size_t columnOr(const ColumnMap& cols,
+                            const std::string& name,
+                            std::size_t fallback) {
+    auto it = cols.find(name);
+    return it != cols.end() ? it->second : fallback;
+}
 
-    // 1) Left subtree
-    saveAccountsInorder(node->left, accountsOut, txOut);
+/// Positions of the transaction columns in transactions.csv.
+struct TxColumns {
+    std::size_t account{0};
+    std::size_t type{1};
+    std::size_t amount{2};
+    std::size_t datetime{3};
+    std::size_t balanceAfter{4};
+    bool        hasBalanceAfter{false};
+    std::size_t counterparty{5};
+    std::size_t transferId{6};
+    bool        hasTransferLink{false};
+};
+
+/// One parsed line of transactions.csv.
+struct TxRow {
+    int             accountNumber{};
+    TransactionType type{};
+    double          amount{};
+    std::string     datetime;
+    double          balanceAfter{};
+    bool            hasBalanceAfter{false};
+    int             counterparty{};
+    long long       transferId{};
+};
+
+/// Parses one transactions.csv line.
+/// Returns false if it is malformed or has an unknown type.
+static bool parseTransactionRow(const std::string& line,
+                                const TxColumns& cols,
+                                TxRow& out) {
+    std::vector<std::string> fields = splitCsvLine(line);
+    if (fields.size() <= std::max({cols.account, cols.type, cols.amount, cols.datetime})) {
+        return false;
+    }
 
-    // 2) This account
-    const Account& acc = node->data;
-    accountsOut << acc.accountNumber << ','
-                << acc.holderName    << ','
-                << acc.balance       << '\n';
+    if (!stringToTransactionType(fields[cols.type], out.type)) {
+        return false;
+    }
 
-    // 3) All transactions for this account
-    const Transaction* current = acc.historyHead;
-    while (current != nullptr) {
-        txOut << acc.accountNumber << ','
-              << transactionTypeToString(current->type) << ','
-              << current->amount << ','
-              << current->datetime << '\n';
-        current = current->next;
+    try {
+        out.accountNumber = std::stoi(fields[cols.account]);
+        out.amount        = std::stod(fields[cols.amount]);
+        out.datetime      = fields[cols.datetime];
+        out.hasBalanceAfter = cols.hasBalanceAfter && cols.balanceAfter < fields.size();
+        if (out.hasBalanceAfter) {
+            out.balanceAfter = std::stod(fields[cols.balanceAfter]);
+        }
+        if (cols.hasTransferLink && cols.transferId < fields.size()) {
+            out.counterparty = std::stoi(fields[cols.counterparty]);
+            out.transferId   = std::stoll(fields[cols.transferId]);
+        }
+    } catch (...) {
+        return false;
     }
+    return true;
+}
 
-    // 4) Right subtree
-    saveAccountsInorder(node->right, accountsOut, txOut);
+/// Writes one transactions.csv line.
+static void writeTransactionRow(std::ostream& txOut,
+                                int accountNumber,
+                                const Transaction& tx) {
+    txOut << accountNumber << ','
+          << transactionTypeToString(tx.type) << ','
+          << tx.amount << ','
+          << tx.datetime << ','
+          << tx.balanceAfter << ','
+          << tx.counterparty << ','
+          << tx.transferId << '\n';
 }
 
-bool saveBankToFiles(const Bank& bank,
+/// Bytes formatted in memory before they are written to the file.
+static constexpr std::streamoff kSaveChunkBytes = 1 << 20;
+
+/// One output file of saveBankToFiles. Rows are formatted into `buffer`
+/// and written out in large chunks, so formatting and file output are
+/// separate phases (see the "save.write" span).
+struct CsvOutput {
+    std::ofstream&     file;
+    std::ostringstream buffer;
+
+    /// Writes the buffer out once it holds a chunk (or always if `force`).
+    void flush(bool force = false) {
+        const std::streamoff pending = buffer.tellp();
+        if (pending <= 0 || (!force && pending < kSaveChunkBytes)) {
+            return;
+        }
+        TraceSpan span("save.write");
+        file << buffer.str();
+        buffer.str(std::string());
+    }
+};
+
+/// Helper: save one account + its transactions.
+template <typename BankT>
+static void saveAccount(const BankT& bank,
+                        const AccountNode* node,
+                        const ReadSnapshot& snapshot,
+                        CsvOutput& accounts,
+                        CsvOutput& transactions) {
+    std::ostream& accountsOut = accounts.buffer;
+    std::ostream& txOut       = transactions.buffer;
+
+    // 1) This account as of the snapshot (balance and history match each
+    //    other and every other account, without locking anything).
+    //    Accounts created after the snapshot are skipped.
+    if (const AccountVersion* version = versionAt(snapshot, node)) {
+        const Account& acc = node->data;
+        auto writeTransaction = [&](const Transaction& tx) {
+            writeTransactionRow(txOut, acc.accountNumber, tx);
+        };
+
+        // 2) All transactions for this account (cold blocks are streamed from disk)
+        forEachHistoryEntry(bank.historyStore, version->history,
+                            [&](long long, const Transaction& tx) {
+                                writeTransaction(tx);
+                            });
+
+        // 3) Interest posted but not materialized yet is written as the
+        //    Interest entries it will become, so the files match eager interest.
+        double balance = balanceWithPendingInterest(
+            bank, snapshot, *version,
+            [&](const InterestEpoch& epoch, double interest, double balanceAfter) {
+                writeTransaction(Transaction(TransactionType::Interest, interest,
+                                             epoch.datetime, balanceAfter));
+            });
+
+        accountsOut << acc.accountNumber << ','
+                    << acc.holderName    << ','
+                    << balance           << ','
+                    << acc.openingBalance << '\n';
+        accounts.flush();
+        transactions.flush();
+    }
+}
+
+template <typename BankT>
+bool saveBankToFiles(const BankT& bank,
                      const std::string& accountsFile,
                      const std::string& transactionsFile) {
+    StatTimer timer(StatOp::Save);
+    TraceSpan span("saveBankToFiles");
     std::ofstream accOut(accountsFile);
     std::ofstream txOut(transactionsFile);
 
     if (!accOut.is_open() || !txOut.is_open()) {
         std::cerr << "Error: could not open output files for saving bank data.\n";
-        return false;
+        return timer.done(false);
     }
 
+    CsvOutput accounts{accOut, {}};
+    CsvOutput transactions{txOut, {}};
+
     // Write headers so Excel sees column names.
-    accOut << "accountNumber,holderName,balance\n";
-    txOut << "accountNumber,type,amount,datetime\n";
+    accounts.buffer << "accountNumber,holderName,balance,openingBalance\n";
+    transactions.buffer << "accountNumber,type,amount,datetime,balanceAfter,counterparty,transferId\n";
 
-    saveAccountsInorder(bank.accountsRoot, accOut, txOut);
+    // One snapshot for the whole save: the files describe a single moment,
+    // e.g. never only one half of a transfer.
+    {
+        TraceSpan traverse("save.traverse");   // formatting, minus the writes inside
+        ReadSnapshot snapshot(bank.epochs);
+        // In-order traversal: the files list the accounts sorted by number.
+        BankT::Index::forEach(bank.accountsRoot, [&](const AccountNode* node) {
+            saveAccount(bank, node, snapshot, accounts, transactions);
+        });
+    }
+    accounts.flush(true);
+    transactions.flush(true);
 
-    return true;
+    return timer.done(true);
+}
+
+/// True if the file does not exist yet or has no content.
+static bool isEmptyFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    return !in.is_open() || in.tellg() <= 0;
+}
+
+template <typename BankT>
+bool appendClosedAccount(const BankT& bank,
+                         const Account& account,
+                         const std::string& closedAt,
+                         const std::string& accountsArchive,
+                         const std::string& transactionsArchive) {
+    const bool newAccounts     = isEmptyFile(accountsArchive);
+    const bool newTransactions = isEmptyFile(transactionsArchive);
+
+    std::ofstream accOut(accountsArchive, std::ios::app);
+    std::ofstream txOut(transactionsArchive, std::ios::app);
+    if (!accOut.is_open() || !txOut.is_open()) {
+        std::cerr << "Error: could not open archive files for closed account #"
+                  << account.accountNumber << ".\n";
+        return false;
+    }
+
+    if (newAccounts) {
+        accOut << "accountNumber,holderName,balance,openingBalance,closedAt\n";
+    }
+    if (newTransactions) {
+        txOut << "accountNumber,type,amount,datetime,balanceAfter,counterparty,transferId\n";
+    }
+
+    // History first: if it cannot be read back, no account line claims
+    // that the archive is complete.
+    bool complete = forEachHistoryEntry(bank.historyStore, viewOf(account.history),
+                                        [&](long long, const Transaction& tx) {
+                                            writeTransactionRow(txOut, account.accountNumber, tx);
+                                        });
+    if (!complete) {
+        return false;
+    }
+
+    accOut << account.accountNumber  << ','
+           << account.holderName     << ','
+           << account.balance        << ','
+           << account.openingBalance << ','
+           << closedAt               << '\n';
+
+    txOut.flush();
+    accOut.flush();
+    return txOut.good() && accOut.good();
 }
 
-bool loadBankFromFiles(Bank& bank,
+/// Lines handled at a time while loading: each chunk is read, then
+/// parsed, then applied, so those phases can be timed (traced) apart.
+static constexpr std::size_t kLoadChunkLines = 4096;
+
+/// Reads up to kLoadChunkLines lines into `lines` (reusing its strings).
+/// @return the number of lines read; 0 at the end of the file.
+static std::size_t readChunk(std::istream& in, std::vector<std::string>& lines) {
+    lines.resize(kLoadChunkLines);
+    std::size_t count = 0;
+    while (count < kLoadChunkLines && std::getline(in, lines[count])) {
+        ++count;
+    }
+    return count;
+}
+
+/// One parsed line of accounts.csv.
+struct AccountRow {
+    int         accountNumber{};
+    std::string holderName;
+    double      balance{};
+    double      openingBalance{};
+    bool        hasOpeningBalance{false};
+};
+
+template <typename BankT>
+bool loadBankFromFiles(BankT& bank,
                        const std::string& accountsFile,
                        const std::string& transactionsFile) {
+    StatTimer timer(StatOp::Load);
+    TraceSpan span("loadBankFromFiles");
     bool anyLoaded = false;
 
+    // Older files have no openingBalance / balanceAfter columns; for those
+    // the running balances are reconstructed from the final balances.
+    bool haveOpeningBalances = false;
+
     // ---- Load accounts ----
     {
         std::ifstream accIn(accountsFile);
@@ -103,31 +354,68 @@ bool loadBankFromFiles(Bank& bank,
         } else {
             std::string line;
 
-            // Skip header line (if present)
+            // Header line tells us which columns are present.
             std::getline(accIn, line);
-
-            while (std::getline(accIn, line)) {
-                if (line.empty()) {
-                    continue;
+            ColumnMap cols = readHeader(line);
+            const std::size_t numberCol  = columnOr(cols, "accountNumber", 0);
+            const std::size_t nameCol    = columnOr(cols, "holderName", 1);
+            const std::size_t balanceCol = columnOr(cols, "balance", 2);
+            const bool hasOpening        = cols.count("openingBalance") > 0;
+            const std::size_t openingCol = columnOr(cols, "openingBalance", 3);
+            haveOpeningBalances          = hasOpening;
+
+            std::vector<std::string> lines;
+            std::vector<AccountRow> rows;
+            while (true) {
+                std::size_t count = 0;
+                {
+                    TraceSpan read("load.accounts.read");
+                    count = readChunk(accIn, lines);
+                }
+                if (count == 0) {
+                    break;
                 }
 
-                std::stringstream ss(line);
-                std::string accNumStr, name, balanceStr;
-
-                if (!std::getline(ss, accNumStr, ',')) continue;
-                if (!std::getline(ss, name, ','))       continue;
-                if (!std::getline(ss, balanceStr, ',')) continue;
-
-                try {
-                    int accNum     = std::stoi(accNumStr);
-                    double balance = std::stod(balanceStr);
+                {
+                    TraceSpan parse("load.accounts.parse");
+                    rows.clear();
+                    for (std::size_t i = 0; i < count; ++i) {
+                        if (lines[i].empty()) {
+                            continue;
+                        }
+                        std::vector<std::string> fields = splitCsvLine(lines[i]);
+                        if (fields.size() <= std::max({numberCol, nameCol, balanceCol})) {
+                            continue;
+                        }
+
+                        try {
+                            AccountRow row;
+                            row.accountNumber = std::stoi(fields[numberCol]);
+                            row.holderName    = fields[nameCol];
+                            row.balance       = std::stod(fields[balanceCol]);
+                            row.hasOpeningBalance = hasOpening && openingCol < fields.size();
+                            if (row.hasOpeningBalance) {
+                                row.openingBalance = std::stod(fields[openingCol]);
+                            }
+                            rows.push_back(std::move(row));
+                        } catch (...) {
+                            std::cerr << "Warning: invalid line in accounts file: "
+                                      << lines[i] << '\n';
+                        }
+                    }
+                }
 
+                TraceSpan insert("load.accounts.insert");
+                for (const AccountRow& row : rows) {
                     // We trust the CSV not to contain duplicates.
-                    createAccount(bank, accNum, name, balance);
+                    if (!createAccount(bank, row.accountNumber, row.holderName, row.balance)) {
+                        continue;
+                    }
+                    if (row.hasOpeningBalance) {
+                        AccountNode* node = BankT::Index::find(bank.accountsRoot, row.accountNumber);
+                        node->data.openingBalance = row.openingBalance;
+                    }
                     anyLoaded = true;
-                } catch (...) {
-                    std::cerr << "Warning: invalid line in accounts file: "
-                              << line << '\n';
                 }
             }
         }
@@ -142,58 +430,147 @@ bool loadBankFromFiles(Bank& bank,
         } else {
             std::string line;
 
-            // Skip header
+            // Header
             std::getline(txIn, line);
-
-            while (std::getline(txIn, line)) {
-                if (line.empty()) {
-                    continue;
+            ColumnMap cols = readHeader(line);
+            TxColumns txCols;
+            txCols.account  = columnOr(cols, "accountNumber", 0);
+            txCols.type     = columnOr(cols, "type", 1);
+            txCols.amount   = columnOr(cols, "amount", 2);
+            txCols.datetime = columnOr(cols, "datetime", 3);
+            txCols.hasBalanceAfter = cols.count("balanceAfter") > 0;
+            txCols.balanceAfter    = columnOr(cols, "balanceAfter", 4);
+            txCols.hasTransferLink = cols.count("counterparty") > 0 &&
+                                     cols.count("transferId") > 0;
+            txCols.counterparty    = columnOr(cols, "counterparty", 5);
+            txCols.transferId      = columnOr(cols, "transferId", 6);
+
+            const std::streampos dataStart = txIn.tellg();
+
+            // Pass 1 (old files only): opening balance = final balance
+            // minus the net effect of the whole history.
+            if (!haveOpeningBalances) {
+                TraceSpan opening("load.transactions.opening");
+                std::unordered_map<int, double> netEffect;
+                TxRow row;
+                while (std::getline(txIn, line)) {
+                    if (parseTransactionRow(line, txCols, row)) {
+                        netEffect[row.accountNumber] +=
+                            balanceEffect(row.type, row.amount);
+                    }
                 }
+                for (const auto& entry : netEffect) {
+                    AccountNode* node = BankT::Index::find(bank.accountsRoot, entry.first);
+                    if (node) {
+                        node->data.openingBalance = node->data.balance - entry.second;
+                    }
+                }
+                txIn.clear();
+                txIn.seekg(dataStart);
+            }
 
-                std::stringstream ss(line);
-                std::string accNumStr, typeStr, amountStr, datetime;
-
-                if (!std::getline(ss, accNumStr, ',')) continue;
-                if (!std::getline(ss, typeStr, ','))   continue;
-                if (!std::getline(ss, amountStr, ',')) continue;
-                if (!std::getline(ss, datetime))       continue; // remainder
-
-                try {
-                    int accNum    = std::stoi(accNumStr);
-                    double amount = std::stod(amountStr);
+            // Pass 2: append every transaction to its account's history.
+            std::vector<std::string> lines;
+            std::vector<TxRow> rows;
+            std::vector<const std::string*> rowLines;   // source line of each row
+            std::vector<AccountNode*> touched;          // accounts appended to in a chunk
+            while (true) {
+                std::size_t count = 0;
+                {
+                    TraceSpan read("load.transactions.read");
+                    count = readChunk(txIn, lines);
+                }
+                if (count == 0) {
+                    break;
+                }
 
-                    TransactionType type;
-                    if (!stringToTransactionType(typeStr, type)) {
-                        std::cerr << "Warning: unknown transaction type '"
-                                  << typeStr << "' in line: " << line << '\n';
-                        continue;
+                {
+                    TraceSpan parse("load.transactions.parse");
+                    rows.clear();
+                    rowLines.clear();
+                    for (std::size_t i = 0; i < count; ++i) {
+                        if (lines[i].empty()) {
+                            continue;
+                        }
+                        TxRow row;
+                        if (!parseTransactionRow(lines[i], txCols, row)) {
+                            std::cerr << "Warning: invalid line in transactions file: "
+                                      << lines[i] << '\n';
+                            continue;
+                        }
+                        rows.push_back(std::move(row));
+                        rowLines.push_back(&lines[i]);
                     }
+                }
 
-                    AccountNode* node = searchAccount(bank.accountsRoot, accNum);
+                TraceSpan append("load.transactions.append");
+                touched.clear();
+                for (std::size_t i = 0; i < rows.size(); ++i) {
+                    TxRow& row = rows[i];
+                    AccountNode* node = BankT::Index::find(bank.accountsRoot, row.accountNumber);
                     if (!node) {
                         std::cerr << "Warning: transaction for non-existing account #"
-                                  << accNum << " in line: " << line << '\n';
+                                  << row.accountNumber << " in line: " << *rowLines[i] << '\n';
                         continue;
                     }
 
+                    // Running balance: from the file if present, otherwise
+                    // replayed from the previous entry (or the opening balance).
+                    Account& acc = node->data;
+                    if (!row.hasBalanceAfter) {
+                        double previous = acc.history.tail ? acc.history.tail->balanceAfter
+                                                           : acc.openingBalance;
+                        row.balanceAfter = previous + balanceEffect(row.type, row.amount);
+                    }
+
                     // Append transaction to this account's history.
-                    addTransaction(node->data.historyHead, type, amount, datetime);
+                    BankT::History::append(bank.historyStore, acc.history,
+                                          row.type, row.amount, row.balanceAfter, row.datetime,
+                                          row.counterparty, row.transferId);
+                    if (touched.empty() || touched.back() != node) {
+                        touched.push_back(node);   // rows of an account mostly come together
+                    }
                     anyLoaded = true;
-                } catch (...) {
-                    std::cerr << "Warning: invalid line in transactions file: "
-                              << line << '\n';
+
+                    // New transfers must not reuse a loaded transfer id.
+                    if (row.transferId >= bank.nextTransferId.load()) {
+                        bank.nextTransferId.store(row.transferId + 1);
+                    }
+                }
+
+                // One commit for every account the chunk touched (it also
+                // releases their spilled nodes), not one per row.
+                std::sort(touched.begin(), touched.end());
+                touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+                if (!touched.empty()) {
+                    commitAccounts(bank.epochs, touched.data(), touched.size());
                 }
             }
         }
     }
 
+    // Creating the accounts kept the totals, but today's deposits are
+    // only known from the loaded histories.
+    {
+        TraceSpan aggregates("load.aggregates");
+        resetAggregates(bank);
+    }
+
     if (anyLoaded) {
         std::cout << "Loaded existing bank data from files.\n";
     } else {
         std::cout << "No existing bank data loaded.\n";
     }
 
-    return anyLoaded;
+    return timer.done(anyLoaded);
 }
 
+// Built for every bank type (see BANK_FOR_EACH_BANK_TYPE).
+#define INSTANTIATE_PERSISTENCE(B) \
+    template bool saveBankToFiles<B>(const B&, const std::string&, const std::string&); \
+    template bool loadBankFromFiles<B>(B&, const std::string&, const std::string&); \
+    template bool appendClosedAccount<B>(const B&, const Account&, const std::string&, const std::string&, const std::string&);
+BANK_FOR_EACH_BANK_TYPE(INSTANTIATE_PERSISTENCE)
+#undef INSTANTIATE_PERSISTENCE
+
 } // namespace bank
@@ -0,0 +1,317 @@
+#include "reporting.h"
+
+#include "snapshot.h"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <thread>
+#include <unordered_map>
+
+namespace bank {
+
+namespace {
+
+/// Below this many rows per thread, extra threads cost more than they save.
+constexpr std::size_t kMinRowsPerThread = 16384;
+
+/// Number of TransactionType values (dense group-by by type).
+constexpr std::size_t kTypeCount = 5;
+
+/// Type name as used in the CSV files.
+const char* typeName(TransactionType type) {
+    switch (type) {
+        case TransactionType::Deposit:     return "Deposit";
+        case TransactionType::Withdraw:    return "Withdraw";
+        case TransactionType::Interest:    return "Interest";
+        case TransactionType::TransferOut: return "TransferOut";
+        case TransactionType::TransferIn:  return "TransferIn";
+        default:                           return "Unknown";
+    }
+}
+
+/// Splits [0, rows) into one contiguous chunk per thread and runs
+/// fn(begin, end, chunkIndex) on each, in parallel (threads >= 1).
+/// Small inputs use fewer chunks.
+/// @return number of chunks used.
+unsigned runChunks(std::size_t rows,
+                   unsigned threads,
+                   const std::function<void(std::size_t, std::size_t, unsigned)>& fn) {
+    const std::size_t useful = rows / kMinRowsPerThread + 1;
+    threads = static_cast<unsigned>(std::min<std::size_t>(threads, useful));
+
+    const std::size_t chunk = (rows + threads - 1) / threads;
+    std::vector<std::thread> workers;
+    for (unsigned t = 1; t < threads; ++t) {
+        std::size_t begin = std::min(rows, t * chunk);
+        std::size_t end   = std::min(rows, begin + chunk);
+        workers.emplace_back(fn, begin, end, t);
+    }
+    fn(0, std::min(rows, chunk), 0);   // the calling thread takes chunk 0
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    return threads;
+}
+
+/// Adds one amount to a group.
+inline void addToGroup(GroupRow& row, double amount) {
+    if (row.count == 0) {
+        row.min = amount;
+        row.max = amount;
+    } else {
+        row.min = std::min(row.min, amount);
+        row.max = std::max(row.max, amount);
+    }
+    ++row.count;
+    row.sum += amount;
+}
+
+/// Merges group `from` into `into` (same key).
+void mergeGroup(GroupRow& into, const GroupRow& from) {
+    if (from.count == 0) {
+        return;
+    }
+    if (into.count == 0) {
+        into = from;
+        return;
+    }
+    into.count += from.count;
+    into.sum   += from.sum;
+    into.min    = std::min(into.min, from.min);
+    into.max    = std::max(into.max, from.max);
+}
+
+/// Top `n` accounts by `value` (descending, ties by account number).
+std::vector<AccountRank> topAccounts(const ReportView& view,
+                                     std::size_t n,
+                                     const std::function<double(std::size_t)>& value) {
+    const AccountColumns& acc = view.accounts;
+    std::vector<AccountRank> ranks(acc.number.size());
+    for (std::size_t i = 0; i < ranks.size(); ++i) {
+        ranks[i].accountNumber = acc.number[i];
+        ranks[i].value         = value(i);
+    }
+
+    n = std::min(n, ranks.size());
+    std::partial_sort(ranks.begin(), ranks.begin() + static_cast<std::ptrdiff_t>(n), ranks.end(),
+                      [](const AccountRank& a, const AccountRank& b) {
+                          if (a.value != b.value) return a.value > b.value;
+                          return a.accountNumber < b.accountNumber;
+                      });
+    ranks.resize(n);
+    return ranks;
+}
+
+} // namespace
+
+template <typename BankT>
+void buildReportView(const BankT& bank, ReportView& out) {
+    out = ReportView();
+    ReadSnapshot snapshot(bank.epochs);
+
+    auto addRow = [&](int account, TransactionType type, double amount,
+                      const std::string& datetime) {
+        out.transactions.account.push_back(account);
+        out.transactions.type.push_back(static_cast<std::uint8_t>(type));
+        out.transactions.amount.push_back(amount);
+        out.transactions.timeKey.push_back(toTimeKey(datetime));
+    };
+
+    // In-order traversal so the account columns come out sorted.
+    BankT::Index::forEach(bank.accountsRoot, [&](const AccountNode* node) {
+        if (const AccountVersion* version = versionAt(snapshot, node)) {
+            const int number = node->data.accountNumber;
+            long long activity = version->history.size;
+
+            forEachHistoryEntry(bank.historyStore, version->history,
+                                [&](long long, const Transaction& tx) {
+                                    addRow(number, tx.type, tx.amount, tx.datetime);
+                                });
+            // Pending interest becomes the Interest rows it will turn into.
+            double balance = balanceWithPendingInterest(
+                bank, snapshot, *version,
+                [&](const InterestEpoch& epoch, double interest, double) {
+                    addRow(number, TransactionType::Interest, interest, epoch.datetime);
+                    ++activity;
+                });
+
+            out.accounts.number.push_back(number);
+            out.accounts.balance.push_back(balance);
+            out.accounts.activity.push_back(activity);
+        }
+    });
+}
+
+std::vector<GroupRow> groupTransactions(const ReportView& view,
+                                        GroupBy by,
+                                        int rangeSize,
+                                        long long fromKey,
+                                        long long toKey,
+                                        unsigned threads) {
+    const TransactionColumns& tx = view.transactions;
+    const std::size_t rows = tx.amount.size();
+    rangeSize = std::max(rangeSize, 1);
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Per-chunk partial results: a dense array for types, a hash map for
+    // the open-ended keys. Each chunk is a tight loop over its columns.
+    std::vector<std::array<GroupRow, kTypeCount>> denseParts(threads);
+    std::vector<std::unordered_map<long long, GroupRow>> sparseParts(threads);
+
+    auto scan = [&](std::size_t begin, std::size_t end, unsigned part) {
+        if (by == GroupBy::Type) {
+            std::array<GroupRow, kTypeCount>& groups = denseParts[part];
+            for (std::size_t i = begin; i < end; ++i) {
+                if (tx.timeKey[i] >= fromKey && tx.timeKey[i] <= toKey) {
+                    addToGroup(groups[tx.type[i]], tx.amount[i]);
+                }
+            }
+            return;
+        }
+
+        std::unordered_map<long long, GroupRow>& groups = sparseParts[part];
+        for (std::size_t i = begin; i < end; ++i) {
+            if (tx.timeKey[i] < fromKey || tx.timeKey[i] > toKey) {
+                continue;
+            }
+            long long key = by == GroupBy::Day
+                ? tx.timeKey[i] / 1000000
+                : static_cast<long long>((tx.account[i] - 1) / rangeSize) * rangeSize + 1;
+            addToGroup(groups[key], tx.amount[i]);
+        }
+    };
+    const unsigned used = runChunks(rows, threads, scan);
+
+    // Merge the partials in key order.
+    std::map<long long, GroupRow> merged;
+    for (unsigned part = 0; part < used; ++part) {
+        if (by == GroupBy::Type) {
+            for (std::size_t type = 0; type < kTypeCount; ++type) {
+                if (denseParts[part][type].count > 0) {
+                    GroupRow& row = merged[static_cast<long long>(type)];
+                    row.key = static_cast<long long>(type);
+                    mergeGroup(row, denseParts[part][type]);
+                }
+            }
+        } else {
+            for (const auto& entry : sparseParts[part]) {
+                GroupRow& row = merged[entry.first];
+                row.key = entry.first;
+                mergeGroup(row, entry.second);
+            }
+        }
+    }
+
+    std::vector<GroupRow> result;
+    result.reserve(merged.size());
+    for (auto& entry : merged) {
+        entry.second.key = entry.first;
+        result.push_back(entry.second);
+    }
+    return result;
+}
+
+std::vector<AccountRank> topAccountsByBalance(const ReportView& view, std::size_t n) {
+    return topAccounts(view, n, [&](std::size_t i) {
+        return view.accounts.balance[i];
+    });
+}
+
+std::vector<AccountRank> topAccountsByActivity(const ReportView& view, std::size_t n) {
+    return topAccounts(view, n, [&](std::size_t i) {
+        return static_cast<double>(view.accounts.activity[i]);
+    });
+}
+
+std::string groupKeyLabel(GroupBy by, long long key, int rangeSize) {
+    switch (by) {
+        case GroupBy::Type:
+            return typeName(static_cast<TransactionType>(key));
+        case GroupBy::Day: {
+            std::string digits = std::to_string(key);   // YYYYMMDD
+            if (digits.size() != 8) {
+                return digits;
+            }
+            return digits.substr(0, 4) + '-' + digits.substr(4, 2) + '-' + digits.substr(6, 2);
+        }
+        default:
+            return std::to_string(key) + '-' + std::to_string(key + std::max(rangeSize, 1) - 1);
+    }
+}
+
+bool exportGroupsCsv(const std::vector<GroupRow>& rows,
+                     GroupBy by,
+                     int rangeSize,
+                     const std::string& path) {
+    std::ofstream out(path);
+    if (!out.is_open()) {
+        std::cout << "Failed to open report file '" << path << "'.\n";
+        return false;
+    }
+
+    out << "group,count,sum,avg,min,max\n";
+    for (const GroupRow& row : rows) {
+        out << groupKeyLabel(by, row.key, rangeSize) << ','
+            << row.count     << ','
+            << row.sum       << ','
+            << row.average() << ','
+            << row.min       << ','
+            << row.max       << '\n';
+    }
+    return static_cast<bool>(out);
+}
+
+bool exportRankingCsv(const std::vector<AccountRank>& ranks,
+                      const std::string& path) {
+    std::ofstream out(path);
+    if (!out.is_open()) {
+        std::cout << "Failed to open report file '" << path << "'.\n";
+        return false;
+    }
+
+    out << "rank,accountNumber,value\n";
+    for (std::size_t i = 0; i < ranks.size(); ++i) {
+        out << (i + 1) << ',' << ranks[i].accountNumber << ',' << ranks[i].value << '\n';
+    }
+    return static_cast<bool>(out);
+}
+
+void printGroups(const std::vector<GroupRow>& rows, GroupBy by, int rangeSize) {
+    if (rows.empty()) {
+        std::cout << "(no transactions)\n";
+        return;
+    }
+    for (const GroupRow& row : rows) {
+        std::cout << groupKeyLabel(by, row.key, rangeSize)
+                  << " | Count: " << row.count
+                  << " | Sum: "   << row.sum
+                  << " | Avg: "   << row.average()
+                  << " | Min: "   << row.min
+                  << " | Max: "   << row.max << '\n';
+    }
+}
+
+void printRanking(const std::vector<AccountRank>& ranks, const std::string& valueName) {
+    if (ranks.empty()) {
+        std::cout << "(no accounts)\n";
+        return;
+    }
+    for (std::size_t i = 0; i < ranks.size(); ++i) {
+        std::cout << (i + 1) << ". Account #" << ranks[i].accountNumber
+                  << " | " << valueName << ": " << ranks[i].value << '\n';
+    }
+}
+
+// Built for every bank type (see BANK_FOR_EACH_BANK_TYPE).
+#define INSTANTIATE_REPORTING(B) \
+    template void buildReportView<B>(const B&, ReportView&);
+BANK_FOR_EACH_BANK_TYPE(INSTANTIATE_REPORTING)
+#undef INSTANTIATE_REPORTING
+
+} // namespace bank
@@ -0,0 +1,713 @@
+#include "server.h"
+
+#include "persistence.h"
+#include "wire_protocol.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace bank {
+
+namespace {
+
+/// Bytes asked for per read() call.
+constexpr std::size_t kReadChunk = 64 * 1024;
+
+/// Stop reading from a client while this much output is still unsent,
+/// so a client that pipelines without reading cannot grow it forever.
+constexpr std::size_t kMaxPendingOutput = 4 * 1024 * 1024;
+
+/// Events handled per epoll_wait call.
+constexpr int kMaxEvents = 256;
+
+/// eventfd every loop watches; written once to stop all of them.
+std::atomic<int> g_stopFd{-1};
+
+void onStopSignal(int) {
+    requestServerStop();
+}
+
+/// One client connection, owned by the loop that accepted it.
+///
+/// Fields:
+///  - fd       : the socket
+///  - in       : bytes received, [inStart, in.size()) not decoded yet
+///  - out      : responses, [outSent, out.size()) not written yet
+///  - paused   : reading stopped until `out` drains (see kMaxPendingOutput)
+///  - busy     : a slow request is with the worker; nothing more is served
+///               until its response is in `out`
+///  - closed   : the socket was closed while busy; the object is freed
+///               when the worker's response comes back
+struct Connection {
+    int               fd{-1};
+    std::vector<char> in;
+    std::size_t       inStart{0};
+    std::vector<char> out;
+    std::size_t       outSent{0};
+    bool              paused{false};
+    bool              busy{false};
+    bool              closed{false};
+};
+
+/// Where the worker leaves the responses of one loop's slow requests;
+/// the loop watches `fd` (an eventfd written once per response).
+struct Mailbox {
+    int                                               fd{-1};
+    std::mutex                                        mutex;
+    std::vector<std::pair<Connection*, WireResponse>> done;
+};
+
+/// A slow request (see isSlowOp), handed to the worker by the loop that
+/// owns `conn`.
+struct SlowJob {
+    Connection* conn{nullptr};
+    Mailbox*    replyTo{nullptr};
+    WireRequest request;
+};
+
+/// Lets the worker stop every event loop for a moment: compactBank needs
+/// the bank to itself. A loop is "in" while it handles the events of one
+/// epoll_wait; a loop waiting in epoll_wait holds nothing.
+///
+/// Fields:
+///  - mutex   : guards active and pausing
+///  - changed : signalled when active drops to 0 or pausing ends
+///  - active  : loops handling events right now
+///  - pausing : set by the worker; loops wait before going in
+struct LoopGate {
+    std::mutex              mutex;
+    std::condition_variable changed;
+    int                     active{0};
+    bool                    pausing{false};
+};
+
+void enterGate(LoopGate& gate) {
+    std::unique_lock<std::mutex> lock(gate.mutex);
+    gate.changed.wait(lock, [&] { return !gate.pausing; });
+    ++gate.active;
+}
+
+void leaveGate(LoopGate& gate) {
+    std::lock_guard<std::mutex> guard(gate.mutex);
+    if (--gate.active == 0 && gate.pausing) {
+        gate.changed.notify_all();
+    }
+}
+
+/// Runs `fn` once no loop is handling events; they wait meanwhile.
+template <typename Fn>
+void withLoopsPaused(LoopGate& gate, Fn fn) {
+    {
+        std::unique_lock<std::mutex> lock(gate.mutex);
+        gate.pausing = true;
+        gate.changed.wait(lock, [&] { return gate.active == 0; });
+    }
+    fn();
+    {
+        std::lock_guard<std::mutex> guard(gate.mutex);
+        gate.pausing = false;
+    }
+    gate.changed.notify_all();
+}
+
+/// The thread that runs the slow requests of every loop, in arrival order.
+struct Worker {
+    std::mutex              mutex;
+    std::condition_variable wake;
+    std::deque<SlowJob>     jobs;
+    bool                    stopping{false};
+    LoopGate                gate;   // see workerLoop
+};
+
+/// Counters of one event loop, summed up when the server stops.
+struct LoopStats {
+    long long connections{0};
+    long long requests{0};
+};
+
+/// Tags for the two fds that are not connections (epoll_event.data.ptr).
+char g_listenTag;
+char g_stopTag;
+
+WireResponse respond(const WireRequest& request, std::uint8_t status) {
+    WireResponse response;
+    response.id     = request.id;
+    response.op     = request.op;
+    response.status = status;
+    return response;
+}
+
+std::uint8_t statusByte(OperationStatus status) {
+    return static_cast<std::uint8_t>(status);
+}
+
+/// Runs one request (other than a deposit / withdrawal run, see serve).
+WireResponse execute(Bank& bank, const ServerOptions& options, const WireRequest& request) {
+    switch (request.op) {
+        case WireOp::Create:
+            return respond(request, statusByte(addAccount(bank, request.account,
+                                                          request.name, request.amount)));
+        case WireOp::Deposit:
+        case WireOp::Withdraw: {
+            BatchOperation op{request.account,
+                              request.op == WireOp::Deposit ? TransactionType::Deposit
+                                                            : TransactionType::Withdraw,
+                              request.amount};
+            const std::uint64_t fingerprint =
+                requestFingerprint(request.op == WireOp::Deposit ? "deposit" : "withdraw",
+                                   request.account, 0, request.amount);
+            return respond(request, statusByte(runIdempotent(bank, request.key, fingerprint, [&] {
+                return applyBatch(bank, &op, 1).front();
+            })));
+        }
+        case WireOp::Transfer: {
+            const std::uint64_t fingerprint = requestFingerprint("transfer", request.account,
+                                                                 request.toAccount, request.amount);
+            return respond(request, statusByte(runIdempotent(bank, request.key, fingerprint, [&] {
+                return transferFunds(bank, request.account, request.toAccount, request.amount);
+            })));
+        }
+        case WireOp::Enqueue:
+            return respond(request, statusByte(queuePendingTransaction(bank, request.account,
+                                                                       request.type,
+                                                                       request.amount,
+                                                                       request.key)));
+        case WireOp::ProcessQueue: {
+            QueueRunSummary run = applyPendingQueue(bank);
+            WireResponse response = respond(request, statusByte(OperationStatus::Ok));
+            response.applied = static_cast<std::uint32_t>(run.applied);
+            response.skipped = static_cast<std::uint32_t>(run.skipped);
+            return response;
+        }
+        case WireOp::Interest:
+            return respond(request, statusByte(postInterest(bank, request.amount)
+                                                   ? OperationStatus::Ok
+                                                   : OperationStatus::InvalidAmount));
+        case WireOp::Balance: {
+            double balance = 0.0;
+            // As of the far future == now, pending interest included.
+            if (!getBalanceAsOf(bank, request.account, "9999", balance)) {
+                return respond(request, statusByte(OperationStatus::AccountNotFound));
+            }
+            WireResponse response = respond(request, statusByte(OperationStatus::Ok));
+            response.balance = balance;
+            return response;
+        }
+        case WireOp::Close:
+            return respond(request, statusByte(closeAccount(bank, request.account,
+                                                            options.accountsArchive,
+                                                            options.transactionsArchive)));
+        case WireOp::Save:
+            return respond(request, saveBankToFiles(bank, options.accountsFile,
+                                                    options.transactionsFile)
+                                        ? statusByte(OperationStatus::Ok)
+                                        : kWireFailed);
+        case WireOp::Batch: {
+            WireResponse response = respond(request, statusByte(OperationStatus::Ok));
+            for (OperationStatus status : applyBatch(bank, request.batch)) {
+                response.statuses.push_back(statusByte(status));
+            }
+            return response;
+        }
+    }
+    return respond(request, kWireBadRequest);
+}
+
+/// Deposits / withdrawals that may join an applyBatch run. Keyed ones
+/// run alone, through runIdempotent (see execute).
+bool isBalanceOp(const WireRequest& request) {
+    return (request.op == WireOp::Deposit || request.op == WireOp::Withdraw) &&
+           request.key.empty();
+}
+
+/// Requests that write files or walk the whole queue: run by the worker
+/// so they never hold up the other connections of a loop.
+bool isSlowOp(const WireRequest& request) {
+    return request.op == WireOp::Save || request.op == WireOp::ProcessQueue ||
+           request.op == WireOp::Close;
+}
+
+/// Runs slow requests until stopped; the queue is finished first. After
+/// a Close, once compactionDue, compacts the bank with every loop paused.
+void workerLoop(Bank& bank, const ServerOptions& options, Worker& worker) {
+    std::unique_lock<std::mutex> lock(worker.mutex);
+    while (true) {
+        worker.wake.wait(lock, [&] { return worker.stopping || !worker.jobs.empty(); });
+        if (worker.jobs.empty()) {
+            return;
+        }
+        SlowJob job = std::move(worker.jobs.front());
+        worker.jobs.pop_front();
+        lock.unlock();
+
+        WireResponse response = execute(bank, options, job.request);
+        const bool closed = job.request.op == WireOp::Close &&
+                            response.status == statusByte(OperationStatus::Ok);
+        {
+            std::lock_guard<std::mutex> guard(job.replyTo->mutex);
+            job.replyTo->done.emplace_back(job.conn, std::move(response));
+        }
+        std::uint64_t one = 1;
+        ssize_t ignored = ::write(job.replyTo->fd, &one, sizeof(one));
+        (void)ignored;
+
+        // The slow requests are all on this thread, so with the loops
+        // paused nothing else touches the bank.
+        if (closed && compactionDue(bank)) {
+            withLoopsPaused(worker.gate, [&] { compactBank(bank); });
+        }
+
+        lock.lock();
+    }
+}
+
+/// Decodes the complete requests in `conn.in`, runs them in order and
+/// appends the responses to `conn.out`. Decoding stops after a slow
+/// request, which goes to the worker and leaves the connection busy; the
+/// requests behind it wait in `conn.in`, so responses stay in order.
+/// @return false if the stream is broken and the connection must close.
+bool serve(Bank& bank, const ServerOptions& options, Worker& worker, Mailbox& mailbox,
+           Connection& conn, LoopStats& stats) {
+    std::vector<WireRequest> requests;
+    std::vector<bool>        malformed;
+    bool broken = false;
+
+    while (!conn.busy && conn.inStart < conn.in.size()) {
+        WireRequest request;
+        std::size_t consumed = 0;
+        WireDecode result = decodeRequest(conn.in.data() + conn.inStart,
+                                          conn.in.size() - conn.inStart,
+                                          request, consumed);
+        if (result == WireDecode::NeedMore) {
+            break;
+        }
+        if (consumed == 0) {
+            broken = true;   // bad length: no way to find the next frame
+            break;
+        }
+        conn.inStart += consumed;
+        const bool slow = result != WireDecode::Malformed && isSlowOp(request);
+        requests.push_back(std::move(request));
+        malformed.push_back(result == WireDecode::Malformed);
+        if (slow) {
+            break;
+        }
+    }
+
+    // Keep the undecoded tail at the front of the buffer.
+    if (conn.inStart > 0) {
+        conn.in.erase(conn.in.begin(), conn.in.begin() + static_cast<std::ptrdiff_t>(conn.inStart));
+        conn.inStart = 0;
+    }
+
+    // Run them in order; a run of deposits / withdrawals is one batch.
+    std::vector<BatchOperation> run;
+    std::size_t i = 0;
+    while (i < requests.size()) {
+        if (malformed[i]) {
+            encodeResponse(respond(requests[i], kWireBadRequest), conn.out);
+            ++i;
+            continue;
+        }
+        if (isSlowOp(requests[i])) {
+            conn.busy = true;   // always the last one decoded
+            {
+                std::lock_guard<std::mutex> guard(worker.mutex);
+                worker.jobs.push_back(SlowJob{&conn, &mailbox, std::move(requests[i])});
+            }
+            worker.wake.notify_one();
+            ++i;
+            continue;
+        }
+        if (!isBalanceOp(requests[i])) {
+            encodeResponse(execute(bank, options, requests[i]), conn.out);
+            ++i;
+            continue;
+        }
+
+        std::size_t end = i;
+        run.clear();
+        for (; end < requests.size() && !malformed[end] && isBalanceOp(requests[end]); ++end) {
+            run.push_back(BatchOperation{requests[end].account,
+                                         requests[end].op == WireOp::Deposit
+                                             ? TransactionType::Deposit
+                                             : TransactionType::Withdraw,
+                                         requests[end].amount});
+        }
+        std::vector<OperationStatus> results = applyBatch(bank, run);
+        for (std::size_t k = 0; k < results.size(); ++k) {
+            encodeResponse(respond(requests[i + k], statusByte(results[k])), conn.out);
+        }
+        i = end;
+    }
+    stats.requests += static_cast<long long>(requests.size());
+    return !broken;
+}
+
+/// Writes as much pending output as the socket takes.
+/// @return false if the connection failed.
+bool flushOutput(Connection& conn) {
+    while (conn.outSent < conn.out.size()) {
+        ssize_t n = ::send(conn.fd, conn.out.data() + conn.outSent,
+                           conn.out.size() - conn.outSent, MSG_NOSIGNAL);
+        if (n > 0) {
+            conn.outSent += static_cast<std::size_t>(n);
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;   // EPOLLOUT tells us when to go on
+        } else {
+            return false;
+        }
+    }
+    conn.out.clear();
+    conn.outSent = 0;
+    return true;
+}
+
+/// Reads until the socket is drained (edge-triggered), serving what
+/// arrived, unless too much output is pending or the connection is busy
+/// (it goes on when the worker's response comes back).
+/// @return false if the connection is closed or failed.
+bool readAndServe(Bank& bank, const ServerOptions& options, Worker& worker, Mailbox& mailbox,
+                  Connection& conn, LoopStats& stats) {
+    while (true) {
+        if (conn.busy) {
+            return true;
+        }
+        if (conn.out.size() - conn.outSent >= kMaxPendingOutput) {
+            conn.paused = true;   // resumed from the EPOLLOUT handler
+            return true;
+        }
+
+        char chunk[kReadChunk];
+        ssize_t n = ::read(conn.fd, chunk, sizeof(chunk));
+
+        if (n > 0) {
+            conn.in.insert(conn.in.end(), chunk, chunk + n);
+            if (!serve(bank, options, worker, mailbox, conn, stats) || !flushOutput(conn)) {
+                return false;
+            }
+        } else if (n == 0) {
+            return false;   // client closed
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return true;
+        } else {
+            return false;
+        }
+    }
+}
+
+/// Accepts every pending client and registers it with this loop.
+void acceptClients(int listenFd, int epfd, std::unordered_set<Connection*>& open,
+                   LoopStats& stats) {
+    while (true) {
+        int fd = ::accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                std::cerr << "Warning: accept failed: " << std::strerror(errno) << '\n';
+            }
+            return;
+        }
+
+        Connection* conn = new Connection();
+        conn->fd = fd;
+        epoll_event ev{};
+        ev.events   = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.ptr = conn;
+        if (::epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            ::close(fd);
+            delete conn;
+            continue;
+        }
+        open.insert(conn);
+        ++stats.connections;
+    }
+}
+
+/// Closes the socket; a busy connection is freed later, by whoever gets
+/// the worker's response (see finishSlowRequests, runServer).
+void closeConnection(int epfd, Connection* conn) {
+    ::epoll_ctl(epfd, EPOLL_CTL_DEL, conn->fd, nullptr);
+    ::close(conn->fd);
+    if (conn->busy) {
+        conn->closed = true;
+    } else {
+        delete conn;
+    }
+}
+
+/// Sends the responses the worker left in `mailbox` and serves what
+/// their connections received meanwhile.
+void finishSlowRequests(Bank& bank, const ServerOptions& options, Worker& worker,
+                        Mailbox& mailbox, int epfd, std::unordered_set<Connection*>& open,
+                        LoopStats& stats) {
+    std::uint64_t count = 0;
+    ssize_t ignored = ::read(mailbox.fd, &count, sizeof(count));   // re-arms it
+    (void)ignored;
+
+    std::vector<std::pair<Connection*, WireResponse>> done;
+    {
+        std::lock_guard<std::mutex> guard(mailbox.mutex);
+        done.swap(mailbox.done);
+    }
+    for (auto& [conn, response] : done) {
+        conn->busy = false;
+        if (conn->closed) {
+            delete conn;
+            continue;
+        }
+        encodeResponse(response, conn->out);
+        bool alive = serve(bank, options, worker, mailbox, *conn, stats) && flushOutput(*conn);
+        if (alive && conn->paused && conn->out.empty()) {
+            conn->paused = false;   // drained while busy: no EPOLLOUT is coming
+        }
+        if (alive && !conn->paused) {
+            alive = readAndServe(bank, options, worker, mailbox, *conn, stats);
+        }
+        if (!alive) {
+            open.erase(conn);
+            closeConnection(epfd, conn);
+        }
+    }
+}
+
+/// One event loop; returns once the stop eventfd fires.
+void eventLoop(Bank& bank, const ServerOptions& options, Worker& worker, Mailbox& mailbox,
+               int listenFd, int stopFd, LoopStats& stats) {
+    int epfd = ::epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0) {
+        std::cerr << "Error: epoll_create1 failed: " << std::strerror(errno) << '\n';
+        return;
+    }
+
+    epoll_event ev{};
+    ev.events   = EPOLLIN | EPOLLEXCLUSIVE;
+    ev.data.ptr = &g_listenTag;
+    ::epoll_ctl(epfd, EPOLL_CTL_ADD, listenFd, &ev);
+    ev.events   = EPOLLIN;   // level-triggered: every loop sees it
+    ev.data.ptr = &g_stopTag;
+    ::epoll_ctl(epfd, EPOLL_CTL_ADD, stopFd, &ev);
+    ev.events   = EPOLLIN;
+    ev.data.ptr = &mailbox;
+    ::epoll_ctl(epfd, EPOLL_CTL_ADD, mailbox.fd, &ev);
+
+    std::unordered_set<Connection*> open;   // to close them all on the way out
+    epoll_event events[kMaxEvents];
+    bool running = true;
+    while (running) {
+        int n = ::epoll_wait(epfd, events, kMaxEvents, -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "Error: epoll_wait failed: " << std::strerror(errno) << '\n';
+            break;
+        }
+
+        enterGate(worker.gate);
+        bool replies = false;
+        for (int e = 0; e < n; ++e) {
+            void* tag = events[e].data.ptr;
+            if (tag == &g_stopTag) {
+                running = false;
+                continue;
+            }
+            if (tag == &g_listenTag) {
+                acceptClients(listenFd, epfd, open, stats);
+                continue;
+            }
+            if (tag == &mailbox) {
+                replies = true;   // after the batch: it may free connections
+                continue;
+            }
+
+            Connection* conn = static_cast<Connection*>(tag);
+            const std::uint32_t what = events[e].events;
+            bool alive = (what & EPOLLERR) == 0;
+            if (alive && (what & EPOLLOUT)) {
+                alive = flushOutput(*conn);
+                if (alive && conn->paused && conn->out.empty()) {
+                    conn->paused = false;
+                    alive = readAndServe(bank, options, worker, mailbox, *conn, stats);
+                }
+            }
+            if (alive && (what & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) && !conn->paused) {
+                alive = readAndServe(bank, options, worker, mailbox, *conn, stats);
+            }
+            if (!alive) {
+                open.erase(conn);
+                closeConnection(epfd, conn);
+            }
+        }
+        if (replies) {
+            finishSlowRequests(bank, options, worker, mailbox, epfd, open, stats);
+        }
+        leaveGate(worker.gate);
+    }
+
+    for (Connection* conn : open) {
+        closeConnection(epfd, conn);
+    }
+    ::close(epfd);
+}
+
+/// Creates the listening socket at `path`.
+/// @return the fd, or -1 (after printing why).
+int listenOn(const std::string& path) {
+    sockaddr_un addr{};
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Error: invalid socket path '" << path << "'.\n";
+        return -1;
+    }
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        std::cerr << "Error: could not create socket: " << std::strerror(errno) << '\n';
+        return -1;
+    }
+    ::unlink(path.c_str());   // stale socket of an earlier run
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::listen(fd, SOMAXCONN) != 0) {
+        std::cerr << "Error: could not listen on '" << path << "': "
+                  << std::strerror(errno) << '\n';
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/// Thousands of clients need thousands of fds: lift the soft limit.
+void raiseFdLimit() {
+    rlimit limit{};
+    if (::getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        ::setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+} // namespace
+
+void requestServerStop() {
+    int fd = g_stopFd.load();
+    if (fd >= 0) {
+        std::uint64_t one = 1;
+        ssize_t ignored = ::write(fd, &one, sizeof(one));   // async-signal-safe
+        (void)ignored;
+    }
+}
+
+bool runServer(Bank& bank, const ServerOptions& options) {
+    raiseFdLimit();
+    int listenFd = listenOn(options.socketPath);
+    if (listenFd < 0) {
+        return false;
+    }
+    unsigned threads = options.threads != 0 ? options.threads
+                                            : std::max(1u, std::thread::hardware_concurrency());
+    int stopFd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    std::vector<Mailbox> mailboxes(threads);
+    bool eventfdsOk = stopFd >= 0;
+    for (Mailbox& mailbox : mailboxes) {
+        mailbox.fd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        eventfdsOk = eventfdsOk && mailbox.fd >= 0;
+    }
+    if (!eventfdsOk) {
+        std::cerr << "Error: eventfd failed: " << std::strerror(errno) << '\n';
+        for (Mailbox& mailbox : mailboxes) {
+            if (mailbox.fd >= 0) {
+                ::close(mailbox.fd);
+            }
+        }
+        if (stopFd >= 0) {
+            ::close(stopFd);
+        }
+        ::close(listenFd);
+        return false;
+    }
+    g_stopFd.store(stopFd);
+
+    struct sigaction action{};
+    struct sigaction oldInt{};
+    struct sigaction oldTerm{};
+    action.sa_handler = onStopSignal;
+    sigemptyset(&action.sa_mask);
+    ::sigaction(SIGINT, &action, &oldInt);
+    ::sigaction(SIGTERM, &action, &oldTerm);
+
+    std::cout << "Serving on " << options.socketPath << " with " << threads
+              << " event loops (Ctrl+C to stop).\n";
+
+    std::vector<LoopStats> stats(threads);
+    Worker worker;
+    std::thread workerThread([&] { workerLoop(bank, options, worker); });
+
+    std::vector<std::thread> loops;
+    for (unsigned t = 0; t < threads; ++t) {
+        loops.emplace_back([&, t] {
+            eventLoop(bank, options, worker, mailboxes[t], listenFd, stopFd, stats[t]);
+        });
+    }
+    for (std::thread& loop : loops) {
+        loop.join();
+    }
+
+    // Let the worker finish what was handed to it (a Save asked for is
+    // still made), then free the connections that were waiting for it.
+    {
+        std::lock_guard<std::mutex> guard(worker.mutex);
+        worker.stopping = true;
+    }
+    worker.wake.notify_one();
+    workerThread.join();
+    for (Mailbox& mailbox : mailboxes) {
+        for (auto& reply : mailbox.done) {
+            delete reply.first;   // closed when its loop stopped
+        }
+        ::close(mailbox.fd);
+    }
+
+    ::sigaction(SIGINT, &oldInt, nullptr);
+    ::sigaction(SIGTERM, &oldTerm, nullptr);
+    g_stopFd.store(-1);
+    ::close(stopFd);
+    ::close(listenFd);
+    ::unlink(options.socketPath.c_str());
+
+    LoopStats total;
+    for (const LoopStats& s : stats) {
+        total.connections += s.connections;
+        total.requests    += s.requests;
+    }
+    std::cout << "Server stopped: " << total.connections << " connections, "
+              << total.requests << " requests.\n";
+    return true;
+}
+
+} // namespace bank
@@ -0,0 +1,407 @@
+#include "sharded_bank.h"
+
+#include "persistence.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <future>
+
+namespace bank {
+
+namespace {
+
+/// Worker thread of one shard: runs the inbox until stopped and drained.
+void shardLoop(Shard& shard) {
+    while (true) {
+        ShardTask task;
+        {
+            std::unique_lock<std::mutex> guard(shard.mutex);
+            shard.ready.wait(guard, [&] { return shard.stopping || !shard.inbox.empty(); });
+            if (shard.inbox.empty()) {
+                return; // stopping and nothing left to do
+            }
+            task = std::move(shard.inbox.front());
+            shard.inbox.pop_front();
+        }
+        task(shard.bank);
+    }
+}
+
+/// Runs `fn` on a shard's thread; the future holds its result.
+template <typename Result>
+std::future<Result> askShard(Shard& shard, std::function<Result(Bank&)> fn) {
+    auto promise = std::make_shared<std::promise<Result>>();
+    std::future<Result> result = promise->get_future();
+    postToShard(shard, [promise, fn](Bank& bank) {
+        try {
+            promise->set_value(fn(bank));
+        } catch (...) {
+            promise->set_exception(std::current_exception());
+        }
+    });
+    return result;
+}
+
+} // namespace
+
+void initShardedBank(ShardedBank& sharded, int shardCount) {
+    shardCount = std::max(shardCount, 1);
+    sharded.shards.clear();
+    for (int i = 0; i < shardCount; ++i) {
+        sharded.shards.push_back(std::make_unique<Shard>());
+        initBank(sharded.shards.back()->bank);
+    }
+    // Start the threads only once the shard list is final.
+    for (auto& shard : sharded.shards) {
+        Shard* s = shard.get();
+        s->worker = std::thread([s] { shardLoop(*s); });
+    }
+}
+
+void destroyShardedBank(ShardedBank& sharded) {
+    for (auto& shard : sharded.shards) {
+        {
+            std::lock_guard<std::mutex> guard(shard->mutex);
+            shard->stopping = true;
+        }
+        shard->ready.notify_one();
+    }
+    for (auto& shard : sharded.shards) {
+        shard->worker.join();
+        destroyBank(shard->bank);
+    }
+    sharded.shards.clear();
+}
+
+std::size_t shardIndexOf(const ShardedBank& sharded, int accountNumber) {
+    // Account numbers are positive (createAccount rejects the rest).
+    return static_cast<std::size_t>(accountNumber) % sharded.shards.size();
+}
+
+void postToShard(Shard& shard, ShardTask task) {
+    {
+        std::lock_guard<std::mutex> guard(shard.mutex);
+        shard.inbox.push_back(std::move(task));
+    }
+    shard.ready.notify_one();
+}
+
+OperationStatus shardedCreateAccount(ShardedBank& sharded,
+                                     int accountNumber,
+                                     const std::string& holderName,
+                                     double initialBalance) {
+    if (accountNumber <= 0) {
+        return OperationStatus::InvalidAccountNumber;   // has no shard
+    }
+    Shard& shard = *sharded.shards[shardIndexOf(sharded, accountNumber)];
+    return askShard<OperationStatus>(shard, [=](Bank& bank) {
+        return addAccount(bank, accountNumber, holderName, initialBalance);
+    }).get();
+}
+
+std::vector<OperationStatus> shardedApplyBatch(ShardedBank& sharded,
+                                               const BatchOperation* ops,
+                                               std::size_t count) {
+    std::vector<OperationStatus> results(count, OperationStatus::Ok);
+
+    // 1) Split by shard, remembering where each operation came from.
+    std::vector<std::vector<BatchOperation>> parts(sharded.shards.size());
+    std::vector<std::vector<std::size_t>> origins(sharded.shards.size());
+    for (std::size_t i = 0; i < count; ++i) {
+        std::size_t s = shardIndexOf(sharded, ops[i].accountNumber);
+        parts[s].push_back(ops[i]);
+        origins[s].push_back(i);
+    }
+
+    // 2) One message per shard involved; the shards run in parallel.
+    std::vector<std::future<std::vector<OperationStatus>>> pending(parts.size());
+    for (std::size_t s = 0; s < parts.size(); ++s) {
+        if (parts[s].empty()) {
+            continue;
+        }
+        auto part = std::make_shared<std::vector<BatchOperation>>(std::move(parts[s]));
+        pending[s] = askShard<std::vector<OperationStatus>>(*sharded.shards[s],
+                                                            [part](Bank& bank) {
+                                                                return applyBatch(bank, *part);
+                                                            });
+    }
+
+    // 3) Put the statuses back in the caller's order.
+    for (std::size_t s = 0; s < pending.size(); ++s) {
+        if (!pending[s].valid()) {
+            continue;
+        }
+        std::vector<OperationStatus> partResults = pending[s].get();
+        for (std::size_t k = 0; k < partResults.size(); ++k) {
+            results[origins[s][k]] = partResults[k];
+        }
+    }
+    return results;
+}
+
+OperationStatus shardedTransfer(ShardedBank& sharded,
+                                int fromAccount,
+                                int toAccount,
+                                double amount) {
+    if (amount <= 0.0) {
+        return OperationStatus::InvalidAmount;
+    }
+    if (fromAccount == toAccount) {
+        return OperationStatus::SameAccount;
+    }
+
+    Shard& source = *sharded.shards[shardIndexOf(sharded, fromAccount)];
+    Shard& target = *sharded.shards[shardIndexOf(sharded, toAccount)];
+    const long long transferId = sharded.nextTransferId.fetch_add(1);
+
+    // Same shard: the ordinary single-bank transfer.
+    if (&source == &target) {
+        return askShard<OperationStatus>(source, [=](Bank& bank) {
+            return transferFunds(bank, fromAccount, toAccount, amount, transferId);
+        }).get();
+    }
+
+    // 1) Prepare: the receiving account must exist.
+    bool exists = askShard<bool>(target, [=](Bank& bank) {
+        return Bank::Index::find(bank.accountsRoot, toAccount) != nullptr;
+    }).get();
+    if (!exists) {
+        return OperationStatus::AccountNotFound;
+    }
+
+    // 2) Send, then 3) hand the credit over to the receiving shard.
+    const std::string datetime = getCurrentDateTime();
+    auto done = std::make_shared<std::promise<OperationStatus>>();
+    std::future<OperationStatus> result = done->get_future();
+    Shard* sourceShard = &source;
+    Shard* targetShard = &target;
+    ShardedBank* bankSet = &sharded;
+    postToShard(source, [=](Bank& bank) {
+        OperationStatus status = sendTransfer(bank, fromAccount, toAccount, amount,
+                                              transferId, datetime);
+        if (status != OperationStatus::Ok) {
+            done->set_value(status);
+            return;
+        }
+        postToShard(*targetShard, [=](Bank& receiver) {
+            OperationStatus received = receiveTransfer(receiver, toAccount, fromAccount,
+                                                       amount, transferId, datetime);
+            if (received == OperationStatus::Ok) {
+                done->set_value(received);
+                return;
+            }
+            // Closed since the prepare: give the amount back to the sender.
+            postToShard(*sourceShard, [=](Bank& sender) {
+                OperationStatus refunded = receiveTransfer(sender, fromAccount, toAccount,
+                                                           amount, transferId, datetime);
+                if (refunded == OperationStatus::Ok) {
+                    done->set_value(received);
+                    return;
+                }
+                // The sender is gone too: keep the amount on record.
+                {
+                    std::lock_guard<std::mutex> guard(bankSet->suspenseMutex);
+                    bankSet->suspense.push_back(
+                        SuspendedTransfer{transferId, fromAccount, toAccount, amount, datetime});
+                }
+                done->set_value(OperationStatus::TransferSuspended);
+            });
+        });
+    });
+    return result.get();
+}
+
+std::vector<SuspendedTransfer> shardedSuspense(ShardedBank& sharded) {
+    std::lock_guard<std::mutex> guard(sharded.suspenseMutex);
+    return sharded.suspense;
+}
+
+OperationStatus shardedEnqueue(ShardedBank& sharded,
+                               int accountNumber,
+                               TransactionType type,
+                               double amount) {
+    if (accountNumber <= 0) {
+        return OperationStatus::AccountNotFound;   // has no shard
+    }
+    Shard& shard = *sharded.shards[shardIndexOf(sharded, accountNumber)];
+    return askShard<OperationStatus>(shard, [=](Bank& bank) {
+        return queuePendingTransaction(bank, accountNumber, type, amount);
+    }).get();
+}
+
+QueueRunSummary shardedProcessQueue(ShardedBank& sharded) {
+    std::vector<std::future<QueueRunSummary>> pending;
+    for (auto& shard : sharded.shards) {
+        pending.push_back(askShard<QueueRunSummary>(*shard, [](Bank& bank) {
+            return applyPendingQueue(bank);
+        }));
+    }
+    QueueRunSummary total;
+    for (auto& result : pending) {
+        QueueRunSummary run = result.get();
+        total.applied += run.applied;
+        total.skipped += run.skipped;
+    }
+    return total;
+}
+
+OperationStatus shardedCloseAccount(ShardedBank& sharded,
+                                    int accountNumber,
+                                    const std::string& accountsArchive,
+                                    const std::string& transactionsArchive) {
+    Shard& shard = *sharded.shards[shardIndexOf(sharded, accountNumber)];
+    std::mutex* archiveMutex = &sharded.archiveMutex;
+    return askShard<OperationStatus>(shard, [=](Bank& bank) {
+        OperationStatus status;
+        {
+            std::lock_guard<std::mutex> guard(*archiveMutex);
+            status = closeAccount(bank, accountNumber, accountsArchive, transactionsArchive);
+        }
+        // Only this shard's thread touches its bank: compacting is safe.
+        if (status == OperationStatus::Ok && compactionDue(bank)) {
+            compactBank(bank);
+        }
+        return status;
+    }).get();
+}
+
+bool shardedPostInterest(ShardedBank& sharded, double rate) {
+    if (rate <= 0.0) {
+        return false;
+    }
+    std::vector<std::future<bool>> pending;
+    for (auto& shard : sharded.shards) {
+        pending.push_back(askShard<bool>(*shard, [rate](Bank& bank) {
+            return postInterest(bank, rate);
+        }));
+    }
+    for (auto& result : pending) {
+        result.get();
+    }
+    return true;
+}
+
+std::vector<AccountBalance> shardedBalances(ShardedBank& sharded) {
+    std::vector<std::future<std::vector<AccountBalance>>> pending;
+    for (auto& shard : sharded.shards) {
+        pending.push_back(askShard<std::vector<AccountBalance>>(*shard, [](Bank& bank) {
+            // As of the far future == now, pending interest included.
+            return balancesAsOf(bank, "9999");
+        }));
+    }
+
+    std::vector<AccountBalance> all;
+    for (auto& result : pending) {
+        std::vector<AccountBalance> part = result.get();
+        all.insert(all.end(), part.begin(), part.end());
+    }
+    std::sort(all.begin(), all.end(),
+              [](const AccountBalance& a, const AccountBalance& b) {
+                  return a.accountNumber < b.accountNumber;
+              });
+    return all;
+}
+
+bool shardedBalance(ShardedBank& sharded, int accountNumber, double& balance) {
+    if (accountNumber <= 0) {
+        return false;
+    }
+    Shard& shard = *sharded.shards[shardIndexOf(sharded, accountNumber)];
+    auto found = askShard<std::pair<bool, double>>(shard, [=](Bank& bank) {
+        double value = 0.0;
+        // As of the far future == now, pending interest included.
+        bool ok = getBalanceAsOf(bank, accountNumber, "9999", value);
+        return std::make_pair(ok, value);
+    }).get();
+    balance = found.second;
+    return found.first;
+}
+
+std::string shardFileName(const std::string& file, std::size_t shard, std::size_t shardCount) {
+    const std::string tag = ".shard" + std::to_string(shard) + "-of-" + std::to_string(shardCount);
+    const std::size_t dot = file.find_last_of('.');
+    const std::size_t slash = file.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        return file + tag;
+    }
+    return file.substr(0, dot) + tag + file.substr(dot);
+}
+
+std::size_t otherShardCountOnDisk(const std::string& file, std::size_t shardCount) {
+    namespace fs = std::filesystem;
+
+    // Split as shardFileName does: <stem>.shard<i>-of-<n><extension>.
+    const fs::path path(file);
+    const std::string name = path.filename().string();
+    const std::size_t dot = name.find_last_of('.');
+    const std::string stem = dot == std::string::npos ? name : name.substr(0, dot);
+    const std::string extension = dot == std::string::npos ? "" : name.substr(dot);
+    const std::string prefix = stem + ".shard";
+
+    const fs::path dir = path.has_parent_path() ? path.parent_path() : fs::path(".");
+    std::error_code error;
+    for (fs::directory_iterator it(dir, error), end; !error && it != end; it.increment(error)) {
+        const std::string entry = it->path().filename().string();
+        if (entry.size() <= prefix.size() + extension.size() ||
+            entry.compare(0, prefix.size(), prefix) != 0 ||
+            entry.compare(entry.size() - extension.size(), extension.size(), extension) != 0) {
+            continue;
+        }
+        const std::string tag = entry.substr(prefix.size(),
+                                             entry.size() - prefix.size() - extension.size());
+        unsigned long shard = 0, count = 0;
+        int used = 0;
+        if (std::sscanf(tag.c_str(), "%lu-of-%lu%n", &shard, &count, &used) == 2 &&
+            used == static_cast<int>(tag.size()) && shard < count && count != shardCount) {
+            return count;
+        }
+    }
+    return 0;
+}
+
+bool shardedLoad(ShardedBank& sharded,
+                 const std::string& accountsFile,
+                 const std::string& transactionsFile) {
+    const std::size_t count = sharded.shards.size();
+    bool loaded = false;
+    for (std::size_t s = 0; s < count; ++s) {
+        const std::string accounts = shardFileName(accountsFile, s, count);
+        const std::string transactions = shardFileName(transactionsFile, s, count);
+        loaded = askShard<bool>(*sharded.shards[s], [=](Bank& bank) {
+            return loadBankFromFiles(bank, accounts, transactions);
+        }).get() || loaded;
+    }
+
+    // Transfer ids stay unique across the shards.
+    for (auto& shard : sharded.shards) {
+        long long next = askShard<long long>(*shard, [](Bank& bank) {
+            return bank.nextTransferId.load();
+        }).get();
+        if (next > sharded.nextTransferId.load()) {
+            sharded.nextTransferId.store(next);
+        }
+    }
+    return loaded;
+}
+
+bool shardedSave(ShardedBank& sharded,
+                 const std::string& accountsFile,
+                 const std::string& transactionsFile) {
+    const std::size_t count = sharded.shards.size();
+    std::vector<std::future<bool>> pending;
+    for (std::size_t s = 0; s < count; ++s) {
+        const std::string accounts = shardFileName(accountsFile, s, count);
+        const std::string transactions = shardFileName(transactionsFile, s, count);
+        pending.push_back(askShard<bool>(*sharded.shards[s], [=](Bank& bank) {
+            return saveBankToFiles(bank, accounts, transactions);
+        }));
+    }
+    bool saved = true;
+    for (auto& result : pending) {
+        saved = result.get() && saved;
+    }
+    return saved;
+}
+
+} // namespace bank
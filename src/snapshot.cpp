@@ -0,0 +1,115 @@
+#include "snapshot.h"
+
+#include <vector>
+
+namespace bank {
+
+namespace {
+
+void deleteVersion(void* ptr) {
+    delete static_cast<AccountVersion*>(ptr);
+}
+
+void deleteGarbage(void* ptr) {
+    HistoryGarbage* garbage = static_cast<HistoryGarbage*>(ptr);
+    freeHistoryGarbage(*garbage);
+    delete garbage;
+}
+
+/// Cuts off the versions of `node` that no reader can select any more:
+/// everything older than the newest version with stamp <= oldest.
+void trimVersions(EpochManager& epochs, AccountNode* node, std::uint64_t oldest) {
+    AccountVersion* keep = node->version.load(std::memory_order_relaxed);
+    while (keep != nullptr && keep->stamp > oldest) {
+        keep = keep->older.load(std::memory_order_relaxed);
+    }
+    if (keep == nullptr) {
+        return;
+    }
+
+    AccountVersion* cut = keep->older.exchange(nullptr, std::memory_order_acq_rel);
+    while (cut != nullptr) {
+        AccountVersion* next = cut->older.load(std::memory_order_relaxed);
+        retire(epochs, cut, deleteVersion);
+        cut = next;
+    }
+}
+
+} // namespace
+
+void commitAccounts(EpochManager& epochs, AccountNode* const* nodes, std::size_t count) {
+    // 1) Build the new versions before taking a stamp, so the window in
+    //    which later commits wait for this one stays short.
+    std::vector<AccountVersion*> fresh(count);
+    std::vector<HistoryGarbage> garbage;
+    for (std::size_t i = 0; i < count; ++i) {
+        AccountVersion* version = new AccountVersion();
+        version->balance = nodes[i]->data.balance;
+        version->history = viewOf(nodes[i]->data.history);
+        version->interestApplied = nodes[i]->data.interestApplied;
+        version->closed = nodes[i]->closed.load(std::memory_order_relaxed);
+        fresh[i] = version;
+
+        for (HistoryGarbage& g : takeHistoryGarbage(nodes[i]->data.history)) {
+            garbage.push_back(g);
+        }
+    }
+
+    // 2) Publish all of them under one stamp.
+    const std::uint64_t stamp = beginCommit(epochs);
+    for (std::size_t i = 0; i < count; ++i) {
+        fresh[i]->stamp = stamp;
+        fresh[i]->older.store(nodes[i]->version.load(std::memory_order_relaxed),
+                              std::memory_order_relaxed);
+        nodes[i]->version.store(fresh[i], std::memory_order_release);
+    }
+    endCommit(epochs, stamp);
+
+    // 3) Old versions and spilled history are only reachable by readers
+    //    pinned before this commit; hand them to the reclaimer.
+    const std::uint64_t oldest = oldestPinnedStamp(epochs);
+    for (std::size_t i = 0; i < count; ++i) {
+        trimVersions(epochs, nodes[i], oldest);
+    }
+    for (const HistoryGarbage& g : garbage) {
+        retire(epochs, new HistoryGarbage(g), deleteGarbage);
+    }
+}
+
+void commitAccount(EpochManager& epochs, AccountNode* node) {
+    commitAccounts(epochs, &node, 1);
+}
+
+ReadSnapshot::ReadSnapshot(EpochManager& epochs)
+    : slot(pinReader(epochs)) {}
+
+ReadSnapshot::~ReadSnapshot() {
+    unpinReader(slot);
+}
+
+std::uint64_t ReadSnapshot::stamp() const {
+    return slot->pinnedStamp.load(std::memory_order_relaxed);
+}
+
+const AccountVersion* versionAt(const ReadSnapshot& snapshot, const AccountNode* node) {
+    const std::uint64_t stamp = snapshot.stamp();
+    const AccountVersion* version = node->version.load(std::memory_order_acquire);
+    while (version != nullptr && version->stamp > stamp) {
+        version = version->older.load(std::memory_order_acquire);
+    }
+    if (version != nullptr && version->closed) {
+        return nullptr;
+    }
+    return version;
+}
+
+void freeAccountVersions(AccountNode* node) {
+    AccountVersion* version = node->version.exchange(nullptr);
+    while (version != nullptr) {
+        AccountVersion* older = version->older.load();
+        delete version;
+        version = older;
+    }
+}
+
+} // namespace bank
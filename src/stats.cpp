@@ -0,0 +1,315 @@
+#include "stats.h"
+
+#include "commands.h"
+#include "memory_usage.h"
+
+#include <ostream>
+
+#ifdef BANK_ENABLE_STATS
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#endif
+
+namespace bank {
+
+#ifdef BANK_ENABLE_STATS
+
+namespace {
+
+/// Log-linear latency buckets: values below 16 get a bucket each, every
+/// higher power of two is split into 16 equal buckets.
+constexpr int         kSubBucketBits = 4;
+constexpr std::size_t kSubBuckets    = std::size_t{1} << kSubBucketBits;
+constexpr std::size_t kBuckets       = (64 - kSubBucketBits + 1) * kSubBuckets;
+
+std::size_t bucketOf(std::uint64_t nanos) {
+    if (nanos < kSubBuckets) {
+        return static_cast<std::size_t>(nanos);
+    }
+    const int msb = 63 - __builtin_clzll(nanos);
+    const int shift = msb - kSubBucketBits;
+    return static_cast<std::size_t>(msb - kSubBucketBits + 1) * kSubBuckets +
+           static_cast<std::size_t>((nanos >> shift) & (kSubBuckets - 1));
+}
+
+/// Middle of the values that fall into `bucket`.
+std::uint64_t bucketMidpoint(std::size_t bucket) {
+    if (bucket < kSubBuckets) {
+        return bucket;
+    }
+    const int shift = static_cast<int>(bucket / kSubBuckets) - 1;
+    const std::uint64_t low = (kSubBuckets + bucket % kSubBuckets) << shift;
+    return low + ((std::uint64_t{1} << shift) >> 1);
+}
+
+/// Counters of one operation in one thread. Only the owning thread
+/// writes them; dumps read them concurrently, hence the atomics.
+struct OpCounters {
+    std::atomic<std::uint64_t> calls;
+    std::atomic<std::uint64_t> nanos;
+    std::atomic<std::uint64_t> failures[kStatFailureKinds];
+    std::atomic<std::uint64_t> buckets[kBuckets];
+};
+
+/// All counters of one thread (value-initialized, i.e. zero).
+struct ThreadStats {
+    OpCounters ops[kStatOpCount];
+};
+
+/// Plain sums of OpCounters, for dumps, exited threads and the baseline.
+struct OpTotals {
+    std::uint64_t calls{0};
+    std::uint64_t nanos{0};
+    std::uint64_t failures[kStatFailureKinds]{};
+    std::uint64_t buckets[kBuckets]{};
+
+    void add(const OpCounters& c) {
+        calls += c.calls.load(std::memory_order_relaxed);
+        nanos += c.nanos.load(std::memory_order_relaxed);
+        for (std::size_t i = 0; i < kStatFailureKinds; ++i) {
+            failures[i] += c.failures[i].load(std::memory_order_relaxed);
+        }
+        for (std::size_t i = 0; i < kBuckets; ++i) {
+            buckets[i] += c.buckets[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    void add(const OpTotals& t) {
+        calls += t.calls;
+        nanos += t.nanos;
+        for (std::size_t i = 0; i < kStatFailureKinds; ++i) {
+            failures[i] += t.failures[i];
+        }
+        for (std::size_t i = 0; i < kBuckets; ++i) {
+            buckets[i] += t.buckets[i];
+        }
+    }
+
+    /// Subtracts `t`; the baseline never exceeds the totals it was taken from.
+    void subtract(const OpTotals& t) {
+        calls -= t.calls;
+        nanos -= t.nanos;
+        for (std::size_t i = 0; i < kStatFailureKinds; ++i) {
+            failures[i] -= t.failures[i];
+        }
+        for (std::size_t i = 0; i < kBuckets; ++i) {
+            buckets[i] -= t.buckets[i];
+        }
+    }
+};
+
+using AllTotals = std::vector<OpTotals>;   // one per StatOp
+
+/// Every live thread's counters plus what exited threads left behind.
+///
+/// Fields:
+///  - mutex    : guards everything below
+///  - threads  : counters of the live threads that recorded anything
+///  - retired  : sums of the threads that have exited
+///  - baseline : totals at the last resetStats
+struct Registry {
+    std::mutex                mutex;
+    std::vector<ThreadStats*> threads;
+    AllTotals                 retired{kStatOpCount};
+    AllTotals                 baseline{kStatOpCount};
+};
+
+/// Never destroyed: threads may still exit after static destructors ran.
+Registry& registry() {
+    static Registry* instance = new Registry();
+    return *instance;
+}
+
+/// Owns the calling thread's counters and hands them over on exit.
+struct LocalStats {
+    ThreadStats* stats;
+
+    LocalStats() : stats(new ThreadStats()) {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> guard(reg.mutex);
+        reg.threads.push_back(stats);
+    }
+
+    ~LocalStats() {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> guard(reg.mutex);
+        for (std::size_t op = 0; op < kStatOpCount; ++op) {
+            reg.retired[op].add(stats->ops[op]);
+        }
+        reg.threads.erase(std::find(reg.threads.begin(), reg.threads.end(), stats));
+        delete stats;
+    }
+
+    LocalStats(const LocalStats&) = delete;
+    LocalStats& operator=(const LocalStats&) = delete;
+};
+
+OpCounters& localCounters(StatOp op) {
+    thread_local LocalStats local;
+    return local.stats->ops[static_cast<std::size_t>(op)];
+}
+
+/// Single-writer increment: no read-modify-write instruction needed.
+void bump(std::atomic<std::uint64_t>& counter, std::uint64_t delta) {
+    counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+/// Sums of every thread, live and exited (baseline not subtracted).
+AllTotals collect(Registry& reg) {
+    AllTotals totals = reg.retired;
+    for (const ThreadStats* stats : reg.threads) {
+        for (std::size_t op = 0; op < kStatOpCount; ++op) {
+            totals[op].add(stats->ops[op]);
+        }
+    }
+    return totals;
+}
+
+/// Smallest bucket midpoint covering fraction `p` of the values.
+std::uint64_t percentile(const OpTotals& t, double p) {
+    std::uint64_t count = 0;
+    for (std::uint64_t n : t.buckets) {
+        count += n;
+    }
+    if (count == 0) {
+        return 0;
+    }
+    const std::uint64_t rank = std::max<std::uint64_t>(
+        1, static_cast<std::uint64_t>(p * static_cast<double>(count) + 0.5));
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < kBuckets; ++i) {
+        seen += t.buckets[i];
+        if (seen >= rank) {
+            return bucketMidpoint(i);
+        }
+    }
+    return 0;
+}
+
+const char* const kOpNames[kStatOpCount] = {
+    "create", "deposit", "withdraw", "enqueue",
+    "process_queue", "interest", "save", "load"
+};
+
+} // namespace
+
+void recordOp(StatOp op, std::uint64_t nanos) {
+    OpCounters& c = localCounters(op);
+    bump(c.calls, 1);
+    bump(c.nanos, nanos);
+    bump(c.buckets[bucketOf(nanos)], 1);
+}
+
+void recordFailure(StatOp op, OperationStatus status) {
+    if (status != OperationStatus::Ok) {
+        bump(localCounters(op).failures[static_cast<std::size_t>(status)], 1);
+    }
+}
+
+void recordOtherFailure(StatOp op) {
+    bump(localCounters(op).failures[kStatOtherFailure], 1);
+}
+
+void recordBatchStats(const BatchOperation* ops,
+                      const OperationStatus* results,
+                      std::size_t count,
+                      std::uint64_t nanos) {
+    if (count == 0) {
+        return;
+    }
+    const std::uint64_t share = nanos / count;
+    for (std::size_t i = 0; i < count; ++i) {
+        // applyBatch rejects other types; count those as withdrawals.
+        StatOp op = ops[i].type == TransactionType::Deposit ? StatOp::Deposit
+                                                            : StatOp::Withdraw;
+        recordOp(op, share);
+        recordFailure(op, results[i]);
+    }
+}
+
+bool statsEnabled() {
+    return true;
+}
+
+/// Writes the stats object without its closing brace.
+static void writeStatsMembers(std::ostream& out) {
+    AllTotals totals;
+    {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> guard(reg.mutex);
+        totals = collect(reg);
+        for (std::size_t op = 0; op < kStatOpCount; ++op) {
+            totals[op].subtract(reg.baseline[op]);
+        }
+    }
+
+    out << "{\"enabled\":true,\"operations\":{";
+    for (std::size_t op = 0; op < kStatOpCount; ++op) {
+        const OpTotals& t = totals[op];
+        out << (op ? "," : "") << '"' << kOpNames[op] << "\":{\"calls\":" << t.calls
+            << ",\"failures\":{";
+        bool first = true;
+        for (std::size_t kind = 0; kind < kStatFailureKinds; ++kind) {
+            if (t.failures[kind] == 0) {
+                continue;
+            }
+            const char* reason = kind == kStatOtherFailure
+                                     ? "other"
+                                     : operationStatusName(static_cast<OperationStatus>(kind));
+            out << (first ? "" : ",") << '"' << reason << "\":" << t.failures[kind];
+            first = false;
+        }
+        out << "},\"latency_ns\":{\"mean\":" << (t.calls ? t.nanos / t.calls : 0)
+            << ",\"p50\":" << percentile(t, 0.50)
+            << ",\"p90\":" << percentile(t, 0.90)
+            << ",\"p99\":" << percentile(t, 0.99)
+            << ",\"p999\":" << percentile(t, 0.999)
+            << ",\"max\":" << percentile(t, 1.0) << "}}";
+    }
+    out << '}';
+}
+
+void resetStats() {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> guard(reg.mutex);
+    reg.baseline = collect(reg);
+}
+
+#else
+
+bool statsEnabled() {
+    return false;
+}
+
+static void writeStatsMembers(std::ostream& out) {
+    out << "{\"enabled\":false";
+}
+
+void resetStats() {}
+
+#endif // BANK_ENABLE_STATS
+
+void writeStatsJson(std::ostream& out) {
+    writeStatsMembers(out);
+    out << '}';
+}
+
+template <typename BankT>
+void writeStatsJson(std::ostream& out, BankT& bank) {
+    MemoryUsage usage = measureMemory(bank);
+    writeStatsMembers(out);
+    out << ",\"memory\":";
+    writeMemoryJson(out, usage);
+    out << '}';
+}
+
+// Built for every bank type (see BANK_FOR_EACH_BANK_TYPE).
+#define INSTANTIATE_STATS(B) \
+    template void writeStatsJson<B>(std::ostream&, B&);
+BANK_FOR_EACH_BANK_TYPE(INSTANTIATE_STATS)
+#undef INSTANTIATE_STATS
+
+} // namespace bank
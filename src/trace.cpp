@@ -0,0 +1,229 @@
+#include "trace.h"
+
+#include <fstream>
+#include <iostream>
+
+#ifdef BANK_ENABLE_TRACING
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <mutex>
+#include <vector>
+#endif
+
+namespace bank {
+
+#ifdef BANK_ENABLE_TRACING
+
+namespace {
+
+/// One finished span.
+struct TraceEvent {
+    const char*   name{nullptr};
+    std::uint64_t start{0};      // ns on the trace clock
+    std::uint64_t duration{0};   // ns
+};
+
+/// Fixed-size ring of the newest events.
+///
+/// Fields:
+///  - mutex  : taken by the owning thread per event (uncontended) and by dumps
+///  - events : the ring storage (grows up to kTraceRingSize, then wraps)
+///  - next   : slot the next event goes to once the ring is full
+///  - tid    : thread number shown in the trace
+struct TraceRing {
+    std::mutex              mutex;
+    std::vector<TraceEvent> events;
+    std::size_t             next{0};
+    int                     tid{0};
+
+    void push(const TraceEvent& event) {
+        if (events.size() < static_cast<std::size_t>(kTraceRingSize)) {
+            events.push_back(event);
+        } else {
+            events[next] = event;
+            next = (next + 1) % events.size();
+        }
+    }
+
+    void clear() {
+        events.clear();
+        next = 0;
+    }
+};
+
+/// All rings: one per live thread plus one for exited threads.
+///
+/// Fields:
+///  - mutex       : guards everything below
+///  - rings       : rings of the live threads that recorded anything
+///  - retired     : ring of the events of exited threads (with their tid)
+///  - retiredNext : slot the next retired event goes to once it is full
+///  - nextTid     : thread number of the next ring
+struct TraceRegistry {
+    std::mutex              mutex;
+    std::vector<TraceRing*> rings;
+    std::vector<std::pair<int, TraceEvent>> retired;
+    std::size_t             retiredNext{0};
+    int                     nextTid{1};
+};
+
+/// Never destroyed: threads may still exit after static destructors ran.
+TraceRegistry& registry() {
+    static TraceRegistry* instance = new TraceRegistry();
+    return *instance;
+}
+
+std::atomic<bool> g_recording{true};
+
+/// Nanoseconds since the trace clock started (first use).
+std::uint64_t traceNow() {
+    static const std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - origin).count());
+}
+
+void pushRetired(TraceRegistry& reg, int tid, const TraceEvent& event) {
+    if (reg.retired.size() < static_cast<std::size_t>(kTraceRingSize)) {
+        reg.retired.emplace_back(tid, event);
+    } else {
+        reg.retired[reg.retiredNext] = {tid, event};
+        reg.retiredNext = (reg.retiredNext + 1) % reg.retired.size();
+    }
+}
+
+/// Owns the calling thread's ring and hands its events over on exit.
+struct LocalRing {
+    TraceRing* ring;
+
+    LocalRing() : ring(new TraceRing()) {
+        TraceRegistry& reg = registry();
+        std::lock_guard<std::mutex> guard(reg.mutex);
+        ring->tid = reg.nextTid++;
+        reg.rings.push_back(ring);
+    }
+
+    ~LocalRing() {
+        TraceRegistry& reg = registry();
+        std::lock_guard<std::mutex> guard(reg.mutex);
+        {
+            std::lock_guard<std::mutex> ringGuard(ring->mutex);
+            // Oldest first, so the shared ring keeps the newest.
+            const std::size_t n = ring->events.size();
+            for (std::size_t i = 0; i < n; ++i) {
+                pushRetired(reg, ring->tid, ring->events[(ring->next + i) % n]);
+            }
+        }
+        reg.rings.erase(std::find(reg.rings.begin(), reg.rings.end(), ring));
+        delete ring;
+    }
+
+    LocalRing(const LocalRing&) = delete;
+    LocalRing& operator=(const LocalRing&) = delete;
+};
+
+TraceRing& localRing() {
+    thread_local LocalRing local;
+    return *local.ring;
+}
+
+void writeEvent(std::ostream& out, bool& first, int tid, const TraceEvent& event) {
+    out << (first ? "\n" : ",\n")
+        << "{\"name\":\"" << event.name << "\",\"cat\":\"bank\",\"ph\":\"X\",\"ts\":"
+        << static_cast<double>(event.start) / 1000.0
+        << ",\"dur\":" << static_cast<double>(event.duration) / 1000.0
+        << ",\"pid\":1,\"tid\":" << tid << '}';
+    first = false;
+}
+
+} // namespace
+
+TraceSpan::TraceSpan(const char* name)
+    : name_(name),
+      recording_(g_recording.load(std::memory_order_relaxed)),
+      start_(recording_ ? traceNow() : 0) {}
+
+TraceSpan::~TraceSpan() {
+    if (!recording_) {
+        return;
+    }
+    TraceEvent event{name_, start_, traceNow() - start_};
+    TraceRing& ring = localRing();
+    std::lock_guard<std::mutex> guard(ring.mutex);
+    ring.push(event);
+}
+
+bool tracingEnabled() {
+    return true;
+}
+
+void setTracing(bool on) {
+    g_recording.store(on);
+}
+
+void writeChromeTrace(std::ostream& out) {
+    TraceRegistry& reg = registry();
+    std::lock_guard<std::mutex> guard(reg.mutex);
+
+    const std::ios_base::fmtflags flags = out.flags();
+    const std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(3);
+
+    out << "{\"traceEvents\":[";
+    bool first = true;
+    for (const auto& entry : reg.retired) {
+        writeEvent(out, first, entry.first, entry.second);
+    }
+    for (TraceRing* ring : reg.rings) {
+        std::lock_guard<std::mutex> ringGuard(ring->mutex);
+        for (const TraceEvent& event : ring->events) {
+            writeEvent(out, first, ring->tid, event);
+        }
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+    out.flags(flags);
+    out.precision(precision);
+}
+
+void clearTrace() {
+    TraceRegistry& reg = registry();
+    std::lock_guard<std::mutex> guard(reg.mutex);
+    reg.retired.clear();
+    reg.retiredNext = 0;
+    for (TraceRing* ring : reg.rings) {
+        std::lock_guard<std::mutex> ringGuard(ring->mutex);
+        ring->clear();
+    }
+}
+
+#else
+
+bool tracingEnabled() {
+    return false;
+}
+
+void setTracing(bool) {}
+
+void writeChromeTrace(std::ostream& out) {
+    out << "{\"traceEvents\":[]}\n";
+}
+
+void clearTrace() {}
+
+#endif // BANK_ENABLE_TRACING
+
+bool saveChromeTrace(const std::string& path) {
+    std::ofstream out(path);
+    if (!out.is_open()) {
+        std::cerr << "Error: could not open trace file '" << path << "'.\n";
+        return false;
+    }
+    writeChromeTrace(out);
+    out.flush();
+    return out.good();
+}
+
+} // namespace bank
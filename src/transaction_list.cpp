@@ -9,21 +9,34 @@ namespace bank {
 /// TransactionType enum to a human-readable string.
 static const char* toString(TransactionType type) {
     switch (type) {
-        case TransactionType::Deposit:  return "Deposit";
-        case TransactionType::Withdraw: return "Withdrawal";
-        case TransactionType::Interest: return "Interest";
-        default:                        return "Unknown";
+        case TransactionType::Deposit:     return "Deposit";
+        case TransactionType::Withdraw:    return "Withdrawal";
+        case TransactionType::Interest:    return "Interest";
+        case TransactionType::TransferOut: return "Transfer Out";
+        case TransactionType::TransferIn:  return "Transfer In";
+        default:                           return "Unknown";
+    }
+}
+
+double balanceEffect(TransactionType type, double amount) {
+    switch (type) {
+        case TransactionType::Withdraw:
+        case TransactionType::TransferOut:
+            return -amount;
+        default:
+            return amount;
     }
 }
 
 void addTransaction(Transaction*& head,
                     TransactionType type,
                     double amount,
-                    const std::string& datetime) {
+                    const std::string& datetime,
+                    double balanceAfter) {
     // 1) Dynamically allocate a new Transaction node.
     //
     //    We use the Transaction constructor to initialize all fields.
-    Transaction* newNode = new Transaction(type, amount, datetime, nullptr);
+    Transaction* newNode = new Transaction(type, amount, datetime, balanceAfter, nullptr);
 
     // 2) If the list is currently empty, newNode becomes the head.
     if (head == nullptr) {
@@ -43,19 +56,29 @@ void addTransaction(Transaction*& head,
     current->next = newNode;
 }
 
+void printTransaction(long long index, const Transaction& tx) {
+    // Convert enum to readable string using helper function.
+    const char* typeStr = toString(tx.type);
+
+    std::cout << index << ") "
+              << typeStr << ": "
+              << tx.amount << " on "
+              << tx.datetime;
+    if (tx.transferId != 0) {
+        std::cout << (tx.type == TransactionType::TransferOut ? " to #" : " from #")
+                  << tx.counterparty
+                  << " [transfer " << tx.transferId << "]";
+    }
+    std::cout << " (balance: " << tx.balanceAfter << ")\n";
+}
+
 void printTransactions(const Transaction* head) {
     const Transaction* current = head;
     int index = 1; // user-friendly index starting from 1
 
     // Traverse the list from head to end.
     while (current != nullptr) {
-        // Convert enum to readable string using helper function.
-        const char* typeStr = toString(current->type);
-
-        std::cout << index << ") "
-                  << typeStr << ": "
-                  << current->amount << " on "
-                  << current->datetime << '\n';
+        printTransaction(index, *current);
 
         current = current->next; // move to next node
         ++index;                 // increment index
@@ -3,7 +3,11 @@
 #include <iostream>
 #include <limits>
 
-#include "persistence.h" // for saveBankToFiles
+#include "memory_usage.h"  // bytes per data structure
+#include "persistence.h"   // for saveBankToFiles
+#include "reporting.h"     // grouped reports and top-N lists
+#include "stats.h"         // operation counters
+#include "trace.h"         // Chrome trace spans
 
 namespace bank {
 
@@ -59,6 +63,23 @@ void printMenu() {
     std::cout << "8. Show Account History\n";
     std::cout << "9. Apply Interest to All Accounts\n";
     std::cout << "10. Save Data\n";
+    std::cout << "11. Show Account History by Date Range\n";
+    std::cout << "12. Show Recent Transactions\n";
+    std::cout << "13. Show Account Balance as of Date\n";
+    std::cout << "14. Show All Balances as of Date\n";
+    std::cout << "15. Transfer Between Accounts\n";
+    std::cout << "16. Show Bank Totals\n";
+    std::cout << "17. Verify Bank Totals\n";
+    std::cout << "18. Transaction Report (Grouped)\n";
+    std::cout << "19. Top Accounts\n";
+    std::cout << "20. Find Accounts by Balance Range\n";
+    std::cout << "21. Find Accounts by Holder Name\n";
+    std::cout << "22. Close Account\n";
+    std::cout << "23. Compact Storage\n";
+    std::cout << "24. Show Operation Statistics\n";
+    std::cout << "25. Write Trace File\n";
+    std::cout << "26. Show Memory Usage\n";
+    std::cout << "27. Set Withdrawal Limits\n";
     std::cout << "0. Exit\n";
     std::cout << "-------------------------------------\n";
 }
@@ -144,6 +165,187 @@ void runMainMenu(Bank& bank) {
                 waitForEnter();
                 break;
             }
+            case 11: { // History by date range
+                int accNo = askInt("Enter account number: ");
+                std::string from = askLine("From (YYYY-MM-DD [HH:MM:SS]): ");
+                std::string to = askLine("To   (YYYY-MM-DD [HH:MM:SS]): ");
+                int page = askInt("Page number: ");
+                printAccountHistoryRange(bank, accNo, from, to, page);
+                waitForEnter();
+                break;
+            }
+            case 12: { // Last N transactions
+                int accNo = askInt("Enter account number: ");
+                int count = askInt("How many recent transactions: ");
+                int page = askInt("Page number: ");
+                printRecentHistory(bank, accNo, count, page);
+                waitForEnter();
+                break;
+            }
+            case 13: { // Balance as of date
+                int accNo = askInt("Enter account number: ");
+                std::string when = askLine("As of (YYYY-MM-DD [HH:MM:SS]): ");
+                printBalanceAsOf(bank, accNo, when);
+                waitForEnter();
+                break;
+            }
+            case 14: { // All balances as of date
+                std::string when = askLine("As of (YYYY-MM-DD [HH:MM:SS]): ");
+                printAllBalancesAsOf(bank, when);
+                waitForEnter();
+                break;
+            }
+            case 15: { // Transfer
+                int fromAcc = askInt("Enter source account number: ");
+                int toAcc = askInt("Enter destination account number: ");
+                double amount = askDouble("Enter transfer amount: ");
+                transferDirect(bank, fromAcc, toAcc, amount);
+                waitForEnter();
+                break;
+            }
+            case 16: { // Bank-wide totals (maintained, O(1))
+                printAggregates(bank);
+                waitForEnter();
+                break;
+            }
+            case 17: { // Check the totals against a full scan
+                if (verifyAggregates(bank)) {
+                    std::cout << "Bank totals match a full scan.\n";
+                }
+                waitForEnter();
+                break;
+            }
+            case 18: { // Grouped transaction report
+                int kind = askInt("Group by (1 = type, 2 = day, 3 = account range): ");
+                GroupBy by = kind == 2 ? GroupBy::Day
+                           : kind == 3 ? GroupBy::AccountRange
+                                       : GroupBy::Type;
+                int rangeSize = by == GroupBy::AccountRange ? askInt("Accounts per range: ") : 100;
+
+                ReportView view;
+                buildReportView(bank, view);
+                std::vector<GroupRow> rows = groupTransactions(view, by, rangeSize);
+                printGroups(rows, by, rangeSize);
+
+                std::string file = askLine("Export to CSV file (empty to skip): ");
+                if (!file.empty() && exportGroupsCsv(rows, by, rangeSize, file)) {
+                    std::cout << "Report saved to " << file << ".\n";
+                }
+                waitForEnter();
+                break;
+            }
+            case 19: { // Top-N accounts
+                int kind = askInt("Rank by (1 = balance, 2 = activity): ");
+                int count = askInt("How many accounts: ");
+
+                std::size_t n = count > 0 ? static_cast<std::size_t>(count) : 0;
+                std::vector<AccountRank> ranks;
+                if (kind == 2) {
+                    ReportView view;
+                    buildReportView(bank, view);
+                    ranks = topAccountsByActivity(view, n);
+                } else {
+                    // Served by the balance index, no full scan.
+                    for (const AccountBalance& entry : topBalances(bank, n)) {
+                        ranks.push_back(AccountRank{entry.accountNumber, entry.balance});
+                    }
+                }
+                printRanking(ranks, kind == 2 ? "Transactions" : "Balance");
+
+                std::string file = askLine("Export to CSV file (empty to skip): ");
+                if (!file.empty() && exportRankingCsv(ranks, file)) {
+                    std::cout << "Report saved to " << file << ".\n";
+                }
+                waitForEnter();
+                break;
+            }
+            case 20: { // Balance range via the balance index
+                double low = askDouble("Minimum balance: ");
+                double high = askDouble("Maximum balance: ");
+                printBalanceRange(bank, low, high);
+                waitForEnter();
+                break;
+            }
+            case 21: { // Name lookup via the name index
+                std::string name = askLine("Holder name (or beginning of it): ");
+                int kind = askInt("Match (1 = exact, 2 = ignore case, 3 = prefix): ");
+                NameMatch how = kind == 1 ? NameMatch::Exact
+                              : kind == 2 ? NameMatch::IgnoreCase
+                                          : NameMatch::Prefix;
+                printAccountsByName(bank, name, how);
+                waitForEnter();
+                break;
+            }
+            case 22: { // Archive and remove an account
+                int accNum = askInt("Enter account number to close: ");
+                closeAccountDirect(bank, accNum, "closed_accounts.csv", "closed_transactions.csv");
+                // The menu runs alone on the bank, so compacting here is safe.
+                if (compactionDue(bank)) {
+                    CompactionResult result = compactBank(bank);
+                    std::cout << "Compacted storage: removed " << result.tombstonesFreed
+                              << " closed accounts from the tree.\n";
+                }
+                waitForEnter();
+                break;
+            }
+            case 23: { // Drop what closed accounts left behind
+                CompactionResult result = compactBank(bank);
+                std::cout << "Removed " << result.tombstonesFreed
+                          << " closed accounts from the tree, released "
+                          << result.nameBytesReleased << " bytes of names.\n";
+                waitForEnter();
+                break;
+            }
+            case 24: { // Counters and latency histograms (stats.h)
+                if (!statsEnabled()) {
+                    std::cout << "Statistics are not compiled in "
+                                 "(configure with -DBANK_ENABLE_STATS=ON).\n";
+                } else {
+                    writeStatsJson(std::cout, bank);
+                    std::cout << '\n';
+                }
+                waitForEnter();
+                break;
+            }
+            case 25: { // Spans as Chrome trace JSON (trace.h)
+                if (!tracingEnabled()) {
+                    std::cout << "Tracing is not compiled in "
+                                 "(configure with -DBANK_ENABLE_TRACING=ON).\n";
+                } else {
+                    std::string file = askLine("Enter trace file name: ");
+                    if (saveChromeTrace(file)) {
+                        std::cout << "Trace written to '" << file
+                                  << "' (open it in chrome://tracing or ui.perfetto.dev).\n";
+                    }
+                }
+                waitForEnter();
+                break;
+            }
+            case 26: { // Objects and bytes per data structure
+                printMemoryUsage(measureMemory(bank));
+                waitForEnter();
+                break;
+            }
+            case 27: { // Velocity rules (velocity.h)
+                int count = askInt("Number of rules (0 removes all limits): ");
+                std::vector<VelocityRule> rules;
+                for (int i = 0; i < count; ++i) {
+                    std::cout << "Rule " << (i + 1) << ":\n";
+                    VelocityRule rule;
+                    rule.windowSeconds = askInt("  Window length in seconds: ");
+                    rule.maxAmount     = askDouble("  Most withdrawn within it (0 = no limit): ");
+                    rule.maxCount      = askInt("  Most withdrawals within it (0 = no limit): ");
+                    rules.push_back(rule);
+                }
+                if (setVelocityRules(bank, rules)) {
+                    std::cout << "Withdrawal limits set (" << rules.size() << " rules).\n";
+                } else {
+                    std::cout << "Invalid rules (at most " << kMaxVelocityRules
+                              << ", each with a positive window and at least one limit).\n";
+                }
+                waitForEnter();
+                break;
+            }
             case 0:
                 std::cout << "Exiting...\n";
                 std::cout << "GoodBye!...\n";
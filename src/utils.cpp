@@ -1,7 +1,7 @@
 #include "utils.h"
 
 #include <chrono>    // std::chrono::system_clock
-#include <ctime>     // std::time_t, std::localtime
+#include <ctime>     // std::time_t, localtime_r
 #include <iomanip>   // std::put_time
 #include <iostream>  // std::cout, std::cin
 #include <limits>    // std::numeric_limits
@@ -17,19 +17,70 @@ namespace bank {
         std::time_t now_c = std::chrono::system_clock::to_time_t(now);
 
         // 3) Converting to local calendar time (year, month, day, etc.).
-        // std::localtime returns a pointer to a static std::tm.
-        std::tm* tm_ptr = std::localtime(&now_c);
-        if (!tm_ptr) {
+        // The reentrant variants fill our own std::tm, so this is safe to
+        // call from several threads (std::localtime uses a shared buffer).
+        std::tm local{};
+#ifdef _WIN32
+        if (localtime_s(&local, &now_c) != 0) {
+#else
+        if (localtime_r(&now_c, &local) == nullptr) {
+#endif
             // If conversion fails, return a fallback string.
             return "0000-00-00 00:00:00";
         }
 
         // 4) Formatting the time into a string using std::put_time.
         std::ostringstream oss;
-        oss << std::put_time(tm_ptr, "%Y-%m-%d %H:%M:%S");
+        oss << std::put_time(&local, "%Y-%m-%d %H:%M:%S");
         return oss.str();
     }
 
+    long long toTimeKey(const std::string& datetime, bool roundUp) {
+        // Collect at most 14 digits: YYYY MM DD HH MM SS.
+        std::string digits;
+        for (char c : datetime) {
+            if (c >= '0' && c <= '9') {
+                digits.push_back(c);
+                if (digits.size() == 14) {
+                    break;
+                }
+            }
+        }
+
+        // Pad missing fields so partial inputs still compare correctly.
+        digits.resize(14, roundUp ? '9' : '0');
+        return std::stoll(digits);
+    }
+
+    long long toEpochSeconds(const std::string& datetime) {
+        std::tm local{};
+        std::istringstream in(datetime);
+        in >> std::get_time(&local, "%Y-%m-%d %H:%M:%S");
+        if (in.fail()) {
+            return 0;
+        }
+        local.tm_isdst = -1;   // let mktime work out daylight saving time
+        return static_cast<long long>(std::mktime(&local));
+    }
+
+    long long epochToTimeKey(long long seconds) {
+        std::time_t time = static_cast<std::time_t>(seconds);
+        std::tm local{};
+#ifdef _WIN32
+        if (localtime_s(&local, &time) != 0) {
+#else
+        if (localtime_r(&time, &local) == nullptr) {
+#endif
+            return 0;
+        }
+        return (local.tm_year + 1900LL) * 10000000000LL
+             + (local.tm_mon + 1LL)     * 100000000LL
+             + local.tm_mday            * 1000000LL
+             + local.tm_hour            * 10000LL
+             + local.tm_min             * 100LL
+             + local.tm_sec;
+    }
+
     void clearInput() {
         // Resetting error flags on the stream, in case a previous read failed.
         std::cin.clear();
@@ -0,0 +1,132 @@
+#include "velocity.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace bank {
+
+namespace {
+
+/// Seconds covered by one bucket of `rule`.
+long long bucketWidth(const VelocityRule& rule) {
+    return std::max(1LL, (rule.windowSeconds + kVelocityBuckets - 1) / kVelocityBuckets);
+}
+
+/// Moves the ring forward to bucket `slot`, dropping what left the window.
+void advance(VelocityWindow& window, long long slot) {
+    if (slot <= window.headSlot) {
+        return;   // same bucket (or the clock went back: keep the newest)
+    }
+    if (slot - window.headSlot >= kVelocityBuckets) {
+        std::fill(std::begin(window.bucketAmount), std::end(window.bucketAmount), 0.0);
+        std::fill(std::begin(window.bucketCount), std::end(window.bucketCount), 0u);
+        window.amount = 0.0;
+        window.count  = 0;
+    } else {
+        for (long long s = window.headSlot + 1; s <= slot; ++s) {
+            const std::size_t i = static_cast<std::size_t>(s % kVelocityBuckets);
+            window.amount -= window.bucketAmount[i];
+            window.count  -= window.bucketCount[i];
+            window.bucketAmount[i] = 0.0;
+            window.bucketCount[i]  = 0;
+        }
+        window.amount = std::max(0.0, window.amount);   // rounding of the subtractions
+    }
+    window.headSlot = slot;
+}
+
+} // namespace
+
+bool velocityStateCurrent(const VelocityRuleSet& rules, const VelocityState* state) {
+    return state && state->generation == rules.generation &&
+           state->windows.size() == rules.count;
+}
+
+void resetVelocityState(const VelocityRuleSet& rules, VelocityState*& state, long long now) {
+    if (!state) {
+        state = new VelocityState();
+    }
+    state->generation = rules.generation;
+    state->windows.assign(rules.count, VelocityWindow{});
+    for (std::size_t r = 0; r < rules.count; ++r) {
+        state->windows[r].headSlot = now / bucketWidth(rules.rules[r]);
+    }
+}
+
+long long velocityLookback(const VelocityRuleSet& rules) {
+    long long longest = 0;
+    for (std::size_t r = 0; r < rules.count; ++r) {
+        longest = std::max(longest, bucketWidth(rules.rules[r]) * kVelocityBuckets);
+    }
+    return longest;
+}
+
+void recordPastWithdrawal(const VelocityRuleSet& rules, VelocityState& state,
+                          double amount, long long when) {
+    for (std::size_t r = 0; r < rules.count && r < state.windows.size(); ++r) {
+        VelocityWindow& window = state.windows[r];
+        // Later than the head only if the clock went back: count it there.
+        const long long slot = std::min(when / bucketWidth(rules.rules[r]), window.headSlot);
+        if (slot <= window.headSlot - kVelocityBuckets) {
+            continue;   // already out of this window
+        }
+        const std::size_t i = static_cast<std::size_t>(slot % kVelocityBuckets);
+        window.bucketAmount[i] += amount;
+        window.bucketCount[i]  += 1;
+        window.amount += amount;
+        window.count  += 1;
+    }
+}
+
+bool admitVelocity(const VelocityRuleSet& rules, VelocityState*& state,
+                   double amount, long long now) {
+    if (rules.count == 0) {
+        return true;
+    }
+
+    if (!velocityStateCurrent(rules, state)) {
+        resetVelocityState(rules, state, now);
+    }
+
+    // Every rule must allow it before it is counted in any window.
+    for (std::size_t r = 0; r < rules.count; ++r) {
+        const VelocityRule& rule = rules.rules[r];
+        VelocityWindow& window = state->windows[r];
+        advance(window, now / bucketWidth(rule));
+
+        if (rule.maxCount > 0 && window.count + 1 > rule.maxCount) {
+            return false;
+        }
+        if (rule.maxAmount > 0.0 && window.amount + amount > rule.maxAmount) {
+            return false;
+        }
+    }
+
+    for (VelocityWindow& window : state->windows) {
+        const std::size_t i = static_cast<std::size_t>(window.headSlot % kVelocityBuckets);
+        window.bucketAmount[i] += amount;
+        window.bucketCount[i]  += 1;
+        window.amount += amount;
+        window.count  += 1;
+    }
+    return true;
+}
+
+long long velocityNow() {
+    return static_cast<long long>(std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+std::size_t velocityStateBytes(const VelocityState* state) {
+    if (!state) {
+        return 0;
+    }
+    return sizeof(VelocityState) + state->windows.capacity() * sizeof(VelocityWindow);
+}
+
+void freeVelocityState(VelocityState*& state) {
+    delete state;
+    state = nullptr;
+}
+
+} // namespace bank
@@ -0,0 +1,291 @@
+#include "wire_protocol.h"
+
+#include <cstring>
+
+namespace bank {
+
+namespace {
+
+/// Appends fixed-size values to a frame body.
+struct Writer {
+    std::vector<char>& out;
+
+    template <typename T>
+    void put(T value) {
+        const char* bytes = reinterpret_cast<const char*>(&value);
+        out.insert(out.end(), bytes, bytes + sizeof(T));
+    }
+};
+
+/// Reads fixed-size values from a frame body; `ok` turns false as soon
+/// as a read would run past the end.
+struct Reader {
+    const char* data;
+    std::size_t size;
+    std::size_t pos{0};
+    bool        ok{true};
+
+    template <typename T>
+    T get() {
+        T value{};
+        if (!ok || size - pos < sizeof(T)) {
+            ok = false;
+            return value;
+        }
+        std::memcpy(&value, data + pos, sizeof(T));
+        pos += sizeof(T);
+        return value;
+    }
+
+    bool done() const { return ok && pos == size; }
+};
+
+/// Starts a frame: reserves the length field and returns its position.
+std::size_t beginFrame(std::vector<char>& out) {
+    std::size_t start = out.size();
+    out.resize(start + sizeof(std::uint32_t));
+    return start;
+}
+
+/// Fills in the length field of the frame started at `start`.
+void endFrame(std::vector<char>& out, std::size_t start) {
+    std::uint32_t length = static_cast<std::uint32_t>(out.size() - start - sizeof(std::uint32_t));
+    std::memcpy(out.data() + start, &length, sizeof(length));
+}
+
+/// Locates the body of the frame at the start of [data, data + size).
+WireDecode frameBody(const char* data, std::size_t size,
+                     std::uint32_t& length, std::size_t& consumed) {
+    consumed = 0;
+    if (size < sizeof(std::uint32_t)) {
+        return WireDecode::NeedMore;
+    }
+    std::memcpy(&length, data, sizeof(length));
+    if (length > kWireMaxFrame) {
+        return WireDecode::Malformed;   // consumed stays 0: cannot resync
+    }
+    if (size - sizeof(std::uint32_t) < length) {
+        return WireDecode::NeedMore;
+    }
+    consumed = sizeof(std::uint32_t) + length;
+    return WireDecode::Complete;
+}
+
+bool validOp(std::uint8_t op) {
+    return op >= static_cast<std::uint8_t>(WireOp::Create) &&
+           op <= static_cast<std::uint8_t>(WireOp::Batch);
+}
+
+/// Ops that may carry an idempotency key.
+bool keyedOp(WireOp op) {
+    return op == WireOp::Deposit || op == WireOp::Withdraw ||
+           op == WireOp::Transfer || op == WireOp::Enqueue;
+}
+
+bool validType(std::uint8_t type) {
+    return type == static_cast<std::uint8_t>(TransactionType::Deposit) ||
+           type == static_cast<std::uint8_t>(TransactionType::Withdraw);
+}
+
+} // namespace
+
+void encodeRequest(const WireRequest& request, std::vector<char>& out) {
+    std::size_t start = beginFrame(out);
+    Writer w{out};
+    w.put<std::uint32_t>(request.id);
+    w.put<std::uint8_t>(static_cast<std::uint8_t>(request.op));
+
+    switch (request.op) {
+        case WireOp::Create:
+            w.put<std::int32_t>(request.account);
+            w.put<double>(request.amount);
+            w.put<std::uint16_t>(static_cast<std::uint16_t>(request.name.size()));
+            out.insert(out.end(), request.name.begin(), request.name.end());
+            break;
+        case WireOp::Deposit:
+        case WireOp::Withdraw:
+            w.put<std::int32_t>(request.account);
+            w.put<double>(request.amount);
+            break;
+        case WireOp::Transfer:
+            w.put<std::int32_t>(request.account);
+            w.put<std::int32_t>(request.toAccount);
+            w.put<double>(request.amount);
+            break;
+        case WireOp::Enqueue:
+            w.put<std::int32_t>(request.account);
+            w.put<std::uint8_t>(static_cast<std::uint8_t>(request.type));
+            w.put<double>(request.amount);
+            break;
+        case WireOp::Interest:
+            w.put<double>(request.amount);
+            break;
+        case WireOp::Balance:
+        case WireOp::Close:
+            w.put<std::int32_t>(request.account);
+            break;
+        case WireOp::Batch:
+            w.put<std::uint32_t>(static_cast<std::uint32_t>(request.batch.size()));
+            for (const BatchOperation& op : request.batch) {
+                w.put<std::int32_t>(op.accountNumber);
+                w.put<std::uint8_t>(static_cast<std::uint8_t>(op.type));
+                w.put<double>(op.amount);
+            }
+            break;
+        case WireOp::ProcessQueue:
+        case WireOp::Save:
+            break;
+    }
+    if (keyedOp(request.op) && !request.key.empty()) {
+        w.put<std::uint16_t>(static_cast<std::uint16_t>(request.key.size()));
+        out.insert(out.end(), request.key.begin(), request.key.end());
+    }
+    endFrame(out, start);
+}
+
+void encodeResponse(const WireResponse& response, std::vector<char>& out) {
+    std::size_t start = beginFrame(out);
+    Writer w{out};
+    w.put<std::uint32_t>(response.id);
+    w.put<std::uint8_t>(static_cast<std::uint8_t>(response.op));
+    w.put<std::uint8_t>(response.status);
+
+    const bool ok = response.status == static_cast<std::uint8_t>(OperationStatus::Ok);
+    if (response.op == WireOp::Balance && ok) {
+        w.put<double>(response.balance);
+    } else if (response.op == WireOp::ProcessQueue && ok) {
+        w.put<std::uint32_t>(response.applied);
+        w.put<std::uint32_t>(response.skipped);
+    } else if (response.op == WireOp::Batch) {
+        w.put<std::uint32_t>(static_cast<std::uint32_t>(response.statuses.size()));
+        out.insert(out.end(), response.statuses.begin(), response.statuses.end());
+    }
+    endFrame(out, start);
+}
+
+WireDecode decodeRequest(const char* data, std::size_t size,
+                         WireRequest& out, std::size_t& consumed) {
+    std::uint32_t length = 0;
+    WireDecode frame = frameBody(data, size, length, consumed);
+    if (frame != WireDecode::Complete) {
+        return frame;
+    }
+
+    Reader r{data + sizeof(std::uint32_t), length};
+    out.id = r.get<std::uint32_t>();
+    std::uint8_t op = r.get<std::uint8_t>();
+    if (!r.ok || !validOp(op)) {
+        return WireDecode::Malformed;
+    }
+    out.op = static_cast<WireOp>(op);
+
+    switch (out.op) {
+        case WireOp::Create: {
+            out.account = r.get<std::int32_t>();
+            out.amount  = r.get<double>();
+            std::uint16_t nameLength = r.get<std::uint16_t>();
+            if (!r.ok || r.size - r.pos != nameLength) {
+                return WireDecode::Malformed;
+            }
+            out.name.assign(r.data + r.pos, nameLength);
+            r.pos += nameLength;
+            break;
+        }
+        case WireOp::Deposit:
+        case WireOp::Withdraw:
+            out.account = r.get<std::int32_t>();
+            out.amount  = r.get<double>();
+            break;
+        case WireOp::Transfer:
+            out.account   = r.get<std::int32_t>();
+            out.toAccount = r.get<std::int32_t>();
+            out.amount    = r.get<double>();
+            break;
+        case WireOp::Enqueue: {
+            out.account = r.get<std::int32_t>();
+            std::uint8_t type = r.get<std::uint8_t>();
+            out.amount  = r.get<double>();
+            if (!validType(type)) {
+                return WireDecode::Malformed;
+            }
+            out.type = static_cast<TransactionType>(type);
+            break;
+        }
+        case WireOp::Interest:
+            out.amount = r.get<double>();
+            break;
+        case WireOp::Balance:
+        case WireOp::Close:
+            out.account = r.get<std::int32_t>();
+            break;
+        case WireOp::Batch: {
+            std::uint32_t count = r.get<std::uint32_t>();
+            // Each operation takes 13 bytes; reject counts the body cannot hold.
+            if (!r.ok || (r.size - r.pos) / 13 < count) {
+                return WireDecode::Malformed;
+            }
+            out.batch.resize(count);
+            for (BatchOperation& batchOp : out.batch) {
+                batchOp.accountNumber = r.get<std::int32_t>();
+                std::uint8_t type = r.get<std::uint8_t>();
+                batchOp.amount = r.get<double>();
+                if (!validType(type)) {
+                    return WireDecode::Malformed;
+                }
+                batchOp.type = static_cast<TransactionType>(type);
+            }
+            break;
+        }
+        case WireOp::ProcessQueue:
+        case WireOp::Save:
+            break;
+    }
+
+    // Optional trailing idempotency key.
+    out.key.clear();
+    if (r.ok && r.pos < r.size && keyedOp(out.op)) {
+        std::uint16_t keyLength = r.get<std::uint16_t>();
+        if (!r.ok || keyLength == 0 || r.size - r.pos != keyLength) {
+            return WireDecode::Malformed;
+        }
+        out.key.assign(r.data + r.pos, keyLength);
+        r.pos += keyLength;
+    }
+    return r.done() ? WireDecode::Complete : WireDecode::Malformed;
+}
+
+WireDecode decodeResponse(const char* data, std::size_t size,
+                          WireResponse& out, std::size_t& consumed) {
+    std::uint32_t length = 0;
+    WireDecode frame = frameBody(data, size, length, consumed);
+    if (frame != WireDecode::Complete) {
+        return frame;
+    }
+
+    Reader r{data + sizeof(std::uint32_t), length};
+    out.id = r.get<std::uint32_t>();
+    std::uint8_t op = r.get<std::uint8_t>();
+    out.status = r.get<std::uint8_t>();
+    if (!r.ok || !validOp(op)) {
+        return WireDecode::Malformed;
+    }
+    out.op = static_cast<WireOp>(op);
+
+    const bool ok = out.status == static_cast<std::uint8_t>(OperationStatus::Ok);
+    if (out.op == WireOp::Balance && ok) {
+        out.balance = r.get<double>();
+    } else if (out.op == WireOp::ProcessQueue && ok) {
+        out.applied = r.get<std::uint32_t>();
+        out.skipped = r.get<std::uint32_t>();
+    } else if (out.op == WireOp::Batch) {
+        std::uint32_t count = r.get<std::uint32_t>();
+        if (!r.ok || r.size - r.pos != count) {
+            return WireDecode::Malformed;
+        }
+        out.statuses.assign(r.data + r.pos, r.data + r.pos + count);
+        r.pos += count;
+    }
+    return r.done() ? WireDecode::Complete : WireDecode::Malformed;
+}
+
+} // namespace bank